@@ -0,0 +1,83 @@
+/*
+    Copyright 2019-2026 Hydr8gon
+
+    This file is part of NooDS.
+
+    NooDS is free software: you can redistribute it and/or modify it
+    under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    NooDS is distributed in the hope that it will be useful, but
+    WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+    General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with NooDS. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <chrono>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "../core/core.h"
+
+// Helpers shared by the benchmarks, checks, and headless runner, which all drive cores without a frontend
+class Bench {
+public:
+    static void loadSettings(const std::string &configDir) {
+        // Load settings if a folder is given, or use HLE BIOS and direct boot so no system files are needed
+        if (!configDir.empty()) {
+            Settings::load(configDir);
+        }
+        else {
+            Settings::ndsBios9Path = Settings::ndsBios7Path = Settings::ndsFirmPath = "";
+            Settings::gbaBiosPath = "";
+            Settings::directBoot = 1;
+            Settings::dsiMode = 0;
+        }
+
+        // Run uncapped without skipping frames, since nothing plays the output
+        Settings::fpsLimiter = 0;
+        Settings::frameskip = 0;
+    }
+
+    static int runFrame(Core *core, const std::function<void()> &onRun = nullptr) {
+        // Run the core until its frame count moves, since it also breaks whenever a CPU halts or wakes
+        // The callback runs after each break, for things like draining audio as it's produced
+        uint64_t frame = core->getMetrics().frame;
+        do {
+            core->runCore();
+            if (onRun) onRun();
+        }
+        while (core->getMetrics().frame == frame);
+        return takeFrames(core);
+    }
+
+    static int takeFrames(Core *core) {
+        // Take all output frames so the queue doesn't fill, leaving the newest in the framebuffer
+        // Frames can end without being output when they're skipped, so this can return 0
+        int count = 0;
+        while (core->gpu.getFrame(getFramebuffer(), core->gbaMode))
+            count++;
+        return count;
+    }
+
+    static uint32_t *getFramebuffer() {
+        // Get a buffer big enough for any frame layout, with one per thread for cores run on a pool
+        static thread_local std::vector<uint32_t> framebuffer(256 * 192 * 8);
+        return framebuffer.data();
+    }
+
+    static double elapsed(std::chrono::steady_clock::time_point start) {
+        // Get the seconds passed since a starting time
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+private:
+    Bench() {} // Private to prevent instantiation
+};
@@ -0,0 +1,286 @@
+/*
+    Copyright 2019-2026 Hydr8gon
+
+    This file is part of NooDS.
+
+    NooDS is free software: you can redistribute it and/or modify it
+    under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    NooDS is distributed in the hope that it will be useful, but
+    WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+    General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with NooDS. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "bench_common.h"
+
+// Measures interpreter throughput with generated programs, so no commercial ROMs or BIOS dumps are needed
+// Each program loops over one workload and stores its iteration count, which gives the number of opcodes run
+// Usage: noods-cpu-bench [frames] [config dir, to also run in DSi mode]
+
+enum Reg { R0, R1, R2, R3, R4, R5, R6, R7, R8, R9, R10, R11, R12, SP, LR, PC };
+enum AluOp { AND, EOR, SUB, RSB, ADD, ADC, SBC, RSC, TST, TEQ, CMP, CMN, ORR, MOV, BIC, MVN };
+enum ThumbOp { T_AND, T_EOR, T_LSL, T_LSR, T_ASR, T_ADC, T_SBC, T_ROR, T_TST, T_NEG, T_CMP, T_CMN, T_ORR, T_MUL };
+enum Cond { EQ = 0x0, NE = 0x1, AL = 0xE };
+enum Shift { LSL, LSR, ASR, ROR };
+
+static const uint32_t codeAddrs[] = { 0x2000000, 0x37F8000 }; // ARM9 main RAM, ARM7 WRAM
+static const uint32_t counterAddr = 0x2300000;
+
+// Encodes ARM and THUMB opcodes for a program loaded at a fixed address
+struct Assembler {
+    std::vector<uint8_t> code;
+    uint32_t base;
+
+    Assembler(uint32_t base): base(base) {}
+    uint32_t here() { return base + code.size(); }
+
+    void arm(uint32_t op) { for (int i = 0; i < 4; i++) code.push_back(op >> (i * 8)); }
+    void thumb(uint16_t op) { for (int i = 0; i < 2; i++) code.push_back(op >> (i * 8)); }
+
+    void aluImm(AluOp op, bool s, Reg rd, Reg rn, uint8_t imm, int rot = 0) {
+        arm((AL << 28) | BIT(25) | (op << 21) | (s << 20) | (rn << 16) | (rd << 12) | (rot << 8) | imm);
+    }
+    void aluReg(AluOp op, bool s, Reg rd, Reg rn, Reg rm, Shift type = LSL, int shift = 0) {
+        arm((AL << 28) | (op << 21) | (s << 20) | (rn << 16) | (rd << 12) | (shift << 7) | (type << 5) | rm);
+    }
+    void mul(Reg rd, Reg rm, Reg rs) { arm((AL << 28) | (rd << 16) | (rs << 8) | 0x90 | rm); }
+    void ldr(Reg rd, Reg rn, int imm) { arm((AL << 28) | 0x05900000 | (rn << 16) | (rd << 12) | imm); }
+    void str(Reg rd, Reg rn, int imm) { arm((AL << 28) | 0x05800000 | (rn << 16) | (rd << 12) | imm); }
+    void strb(Reg rd, Reg rn, int imm) { arm((AL << 28) | 0x05C00000 | (rn << 16) | (rd << 12) | imm); }
+    void ldm(Reg rn, uint16_t list) { arm((AL << 28) | 0x08900000 | (rn << 16) | list); }
+    void stm(Reg rn, uint16_t list) { arm((AL << 28) | 0x08800000 | (rn << 16) | list); }
+    void bx(Reg rm) { arm((AL << 28) | 0x012FFF10 | rm); }
+    void b(uint32_t target, Cond cond = AL, bool link = false) {
+        arm((cond << 28) | 0x0A000000 | (link << 24) | (((target - here() - 8) >> 2) & 0xFFFFFF));
+    }
+
+    void thumbAlu(ThumbOp op, Reg rd, Reg rs) { thumb(0x4000 | (op << 6) | (rs << 3) | rd); }
+    void thumbAdd(Reg rd, Reg rn, Reg rm) { thumb(0x1800 | (rm << 6) | (rn << 3) | rd); }
+    void thumbAddImm(Reg rd, uint8_t imm) { thumb(0x3000 | (rd << 8) | imm); }
+    void thumbStr(Reg rd, Reg rb, int imm) { thumb(0x6000 | ((imm >> 2) << 6) | (rb << 3) | rd); }
+    void thumbB(uint32_t target) { thumb(0xE000 | (((target - here() - 4) >> 1) & 0x7FF)); }
+};
+
+static void emitCount(Assembler &as, uint32_t loop) {
+    // Count an iteration and go back to the start of the loop
+    as.aluImm(ADD, false, R12, R12, 1);
+    as.str(R12, R11, 0);
+    as.b(loop);
+}
+
+static int emitAlu(Assembler &as) {
+    // Data processing with shifted operands, flag updates, and a multiply
+    uint32_t loop = as.here();
+    as.aluReg(ADD, false, R0, R0, R1);
+    as.aluReg(EOR, false, R2, R2, R0, LSL, 3);
+    as.aluReg(SUB, false, R3, R3, R2, LSR, 1);
+    as.aluReg(ORR, false, R4, R4, R3, ROR, 7);
+    as.aluReg(AND, true, R5, R4, R0);
+    as.aluReg(ADC, false, R6, R6, R5, ASR, 2);
+    as.aluReg(BIC, false, R7, R6, R1);
+    as.aluReg(CMP, true, R0, R7, R3);
+    as.mul(R1, R2, R3);
+    as.aluImm(ADD, false, R1, R1, 1);
+    emitCount(as, loop);
+    return 10 + 3;
+}
+
+static int emitBlock(Assembler &as) {
+    // Block transfers back and forth between two buffers
+    uint32_t loop = as.here();
+    as.ldm(R8, 0x00FF);
+    as.stm(R9, 0x00FF);
+    as.ldm(R9, 0x00FF);
+    as.stm(R8, 0x00FF);
+    as.ldr(R0, R8, 0x20);
+    as.str(R0, R9, 0x20);
+    emitCount(as, loop);
+    return 6 + 3;
+}
+
+static int emitBranch(Assembler &as) {
+    // A call and return, and taken and untaken conditional branches, all run once per iteration
+    uint32_t loop = as.here();
+    as.b(loop + 0x28, AL, true); // Call the function after the loop
+    as.aluReg(CMP, true, R0, R12, R12);
+    as.b(loop + 0x10, EQ); // Taken
+    as.aluImm(ADD, false, R0, R0, 1); // Skipped
+    as.b(loop + 0x0C, NE); // Not taken
+    as.b(loop + 0x1C); // Taken
+    as.aluImm(ADD, false, R0, R0, 1); // Skipped
+    emitCount(as, loop);
+    as.aluImm(ADD, false, R1, R1, 1);
+    as.bx(LR);
+    return 7 + 3;
+}
+
+static int emitThumb(Assembler &as) {
+    // Switch to THUMB and loop there, with the counter in R4 and its address in R3
+    as.aluReg(MOV, false, R3, R0, R11);
+    as.aluImm(MOV, false, R4, R0, 0);
+    as.aluImm(ADD, false, R10, PC, 1);
+    as.bx(R10);
+    uint32_t loop = as.here();
+    as.thumbAdd(R0, R0, R1);
+    as.thumbAlu(T_EOR, R2, R0);
+    as.thumbAlu(T_LSL, R5, R1);
+    as.thumbAlu(T_ADC, R6, R2);
+    as.thumbAlu(T_ORR, R7, R6);
+    as.thumbAlu(T_MUL, R7, R0);
+    as.thumbAlu(T_CMP, R7, R2);
+    as.thumbAddImm(R4, 1);
+    as.thumbStr(R4, R3, 0);
+    as.thumbB(loop);
+    return 10;
+}
+
+struct Workload {
+    const char *name;
+    int (*emit)(Assembler &as);
+};
+
+static const Workload workloads[] = {
+    { "alu", emitAlu },
+    { "block", emitBlock },
+    { "branch", emitBranch },
+    { "thumb", emitThumb }
+};
+
+struct Mode {
+    const char *name;
+    bool active[2];
+    bool dsi;
+};
+
+static const Mode modes[] = {
+    { "nds", { true, true }, false }, // Interpreter::runCoreNds
+    { "arm9", { true, false }, false }, // Interpreter::runCoreSingle<false, 0>
+    { "arm7", { false, true }, false }, // Interpreter::runCoreSingle<true, 1>
+    { "dsi", { true, true }, true } // Interpreter::runCoreDsi
+};
+
+static int buildProgram(Assembler &as, bool arm7, bool active, const Workload &work) {
+    // Set up registers; each CPU gets its own counter and buffers
+    as.aluImm(MOV, false, R11, R0, 0x23, 6); // 0x2300000
+    as.aluImm(MOV, false, R8, R0, 0x22, 6); // 0x2200000
+    if (arm7) {
+        as.aluImm(ADD, false, R11, R11, 4);
+        as.aluImm(ADD, false, R8, R8, 1, 10); // 0x1000
+    }
+    as.aluImm(ADD, false, R9, R8, 1, 12); // 0x100
+    as.aluImm(MOV, false, R12, R0, 0);
+    for (int i = 0; i < 8; i++)
+        as.aluImm(MOV, false, Reg(i), R0, i * 3 + 1);
+
+    // Run the workload, or halt for good if the CPU should be inactive
+    if (active)
+        return work.emit(as);
+    uint32_t loop = as.here();
+    if (arm7) {
+        as.aluImm(MOV, false, R0, R0, 0x01, 3); // 0x4000000
+        as.aluImm(ADD, false, R0, R0, 0x03, 12); // 0x300
+        as.aluImm(MOV, false, R1, R0, 0x80);
+        as.strb(R1, R0, 1); // HALTCNT
+    }
+    else {
+        as.arm(0xEE070F90); // MCR p15,0,r0,c7,c0,4 (wait for interrupt)
+    }
+    as.b(loop);
+    return 0;
+}
+
+static FILE *buildRom(const Mode &mode, const Workload &work, int *opsPerLoop) {
+    // Assemble a program for each CPU
+    Assembler programs[2] = { Assembler(codeAddrs[0]), Assembler(codeAddrs[1]) };
+    for (int i = 0; i < 2; i++)
+        opsPerLoop[i] = buildProgram(programs[i], i, mode.active[i], work);
+
+    // Lay out a ROM with just the header fields direct boot needs, and the programs after it
+    std::vector<uint8_t> rom(0x8000);
+    for (int i = 0; i < 2; i++) {
+        uint32_t offset = 0x1000 + i * 0x1000;
+        U32TO8(rom, 0x20 + i * 0x10, offset); // ROM offset
+        U32TO8(rom, 0x24 + i * 0x10, codeAddrs[i]); // Entry address
+        U32TO8(rom, 0x28 + i * 0x10, codeAddrs[i]); // RAM address
+        U32TO8(rom, 0x2C + i * 0x10, (programs[i].code.size() + 3) & ~3); // Size
+        std::copy(programs[i].code.begin(), programs[i].code.end(), rom.begin() + offset);
+    }
+
+    // Write the ROM to an anonymous file for the core to load
+    FILE *file = tmpfile();
+    if (file) {
+        fwrite(rom.data(), sizeof(uint8_t), rom.size(), file);
+        fflush(file);
+    }
+    return file;
+}
+
+static bool runBenchmark(const Mode &mode, const Workload &work, int frames) {
+    // Build the ROM and boot it directly
+    int opsPerLoop[2];
+    FILE *file = buildRom(mode, work, opsPerLoop);
+    if (!file) return false;
+    Settings::dsiMode = mode.dsi;
+    Core *core;
+    try {
+        core = new Core("./cpu-bench.nds", "", 0, fileno(file));
+    }
+    catch (CoreError e) {
+        printf("%-6s %-8s skipped (error %d)\n", mode.name, work.name, e);
+        fclose(file);
+        return false;
+    }
+
+    // Run for the given number of frames
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < frames; i++)
+        Bench::runFrame(core);
+    double seconds = Bench::elapsed(start);
+
+    // Report millions of opcodes run per second for each CPU
+    double mips[2];
+    for (int i = 0; i < 2; i++)
+        mips[i] = double(core->memory.read<uint32_t>(0, counterAddr + i * 4)) * opsPerLoop[i] / seconds / 1e6;
+    printf("%-6s %-8s %10.2f %10.2f %10.2f %10.1f\n", mode.name, work.name,
+        mips[0], mips[1], mips[0] + mips[1], frames / seconds);
+    delete core;
+    fclose(file);
+    return true;
+}
+
+int main(int argc, char **argv) {
+    // Parse the command line
+    int frames = (argc > 1) ? atoi(argv[1]) : 600;
+    std::string configDir = (argc > 2) ? argv[2] : "";
+    if (frames <= 0) {
+        printf("Usage: %s [frames] [config dir, to also run in DSi mode]\n", argv[0]);
+        return 1;
+    }
+
+    // Use HLE BIOS and direct boot; DSi mode always needs system files, so it only runs with settings
+    Bench::loadSettings(configDir);
+    Settings::directBoot = 1;
+    Settings::threaded2D = Settings::threaded3D = 0;
+    Settings::arm7Hle = 0;
+
+    // Run every workload in every mode
+    printf("%-6s %-8s %10s %10s %10s %10s\n", "mode", "workload", "ARM9 MIPS", "ARM7 MIPS", "total", "FPS");
+    for (size_t i = 0; i < sizeof(modes) / sizeof(modes[0]); i++) {
+        if (modes[i].dsi && configDir.empty()) continue;
+        for (size_t j = 0; j < sizeof(workloads) / sizeof(workloads[0]); j++)
+            runBenchmark(modes[i], workloads[j], frames);
+    }
+    return 0;
+}
@@ -0,0 +1,150 @@
+/*
+    Copyright 2019-2026 Hydr8gon
+
+    This file is part of NooDS.
+
+    NooDS is free software: you can redistribute it and/or modify it
+    under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    NooDS is distributed in the hope that it will be useful, but
+    WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+    General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with NooDS. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "bench_common.h"
+
+// Runs a set of ROMs or states uncapped and reports FPS and where the host time went, as JSON
+// Usage: noods-perf-bench [--frames N] [--warmup N] [--threaded] [--config DIR] [--state FILE] <rom> ...
+// A --state option applies to the ROM that follows it; without --config, HLE BIOS and direct boot are used
+
+struct Job {
+    std::string romPath, statePath;
+};
+
+static std::string escape(const std::string &str) {
+    // Escape a string for use in JSON
+    std::string out;
+    for (size_t i = 0; i < str.size(); i++) {
+        if (str[i] == '"' || str[i] == '\\') out += '\\';
+        out += str[i];
+    }
+    return out;
+}
+
+static bool runJob(Job &job, int frames, int warmup, bool first) {
+    // Boot the ROM, and load the state if one was given
+    bool gba = (job.romPath.size() >= 4 && job.romPath.compare(job.romPath.size() - 4, 4, ".gba") == 0);
+    Core *core;
+    try {
+        core = gba ? new Core("", job.romPath) : new Core(job.romPath);
+    }
+    catch (CoreError e) {
+        fprintf(stderr, "Error: failed to boot %s (error %d)\n", job.romPath.c_str(), e);
+        return false;
+    }
+    if (!job.statePath.empty()) {
+        core->saveStates.setPath(job.statePath, gba);
+        if (!core->saveStates.loadState()) {
+            fprintf(stderr, "Error: failed to load state %s\n", job.statePath.c_str());
+            delete core;
+            return false;
+        }
+    }
+
+    // Run some frames untimed so caches and lazily allocated buffers settle
+    fprintf(stderr, "Running %s...\n", job.romPath.c_str());
+    for (int i = 0; i < warmup; i++)
+        Bench::runFrame(core);
+
+    // Run the timed frames with the subsystem timers active
+    core->perfTimers.setEnabled(true);
+    core->perfTimers.reset();
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < frames; i++)
+        Bench::runFrame(core);
+    double seconds = Bench::elapsed(start);
+    core->perfTimers.setEnabled(false);
+
+    // Report the results, with time outside the core counted as frontend overhead
+    double counted = 0;
+    printf("%s    {\n", first ? "" : ",\n");
+    printf("      \"rom\": \"%s\",\n", escape(job.romPath).c_str());
+    printf("      \"state\": \"%s\",\n", escape(job.statePath).c_str());
+    printf("      \"seconds\": %.6f,\n", seconds);
+    printf("      \"fps\": %.3f,\n", frames / seconds);
+    printf("      \"timings\": {\n");
+    for (int i = 0; i < PERF_MAX; i++) {
+        double time = core->perfTimers.getNanos(PerfZone(i)) / 1e9;
+        printf("        \"%s\": %.6f,\n", PerfTimers::getName(PerfZone(i)), time);
+        counted += time;
+    }
+    printf("        \"other\": %.6f\n", std::max(0.0, seconds - counted));
+    printf("      }\n");
+    printf("    }");
+    fflush(stdout);
+    delete core;
+    return true;
+}
+
+int main(int argc, char **argv) {
+    // Parse the command line
+    std::vector<Job> jobs;
+    std::string configDir, statePath;
+    int frames = 1200, warmup = 120;
+    bool threaded = false;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--threaded") {
+            threaded = true;
+        }
+        else if (arg[0] == '-' && i + 1 < argc) {
+            std::string value = argv[++i];
+            if (arg == "--frames") frames = atoi(value.c_str());
+            else if (arg == "--warmup") warmup = atoi(value.c_str());
+            else if (arg == "--config") configDir = value;
+            else if (arg == "--state") statePath = value;
+        }
+        else {
+            Job job;
+            job.romPath = arg;
+            job.statePath = statePath;
+            jobs.push_back(job);
+            statePath = "";
+        }
+    }
+    if (jobs.empty() || frames <= 0) {
+        printf("Usage: %s [--frames N] [--warmup N] [--threaded] [--config DIR] [--state FILE] <rom> ...\n", argv[0]);
+        return 1;
+    }
+
+    // Use HLE BIOS and direct boot unless settings are given, so no system files are needed
+    // Keep rendering on the emulation thread by default so its time can be split up
+    Bench::loadSettings(configDir);
+    if (!threaded)
+        Settings::threaded2D = Settings::threaded3D = 0;
+
+    // Run each job and emit the results as JSON
+    printf("{\n  \"frames\": %d,\n  \"warmup\": %d,\n  \"threaded\": %s,\n  \"results\": [\n",
+        frames, warmup, threaded ? "true" : "false");
+    bool first = true, failed = false;
+    for (size_t i = 0; i < jobs.size(); i++) {
+        if (runJob(jobs[i], frames, warmup, first))
+            first = false;
+        else
+            failed = true;
+    }
+    printf("\n  ]\n}\n");
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,135 @@
+/*
+    Copyright 2019-2026 Hydr8gon
+
+    This file is part of NooDS.
+
+    NooDS is free software: you can redistribute it and/or modify it
+    under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    NooDS is distributed in the hope that it will be useful, but
+    WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+    General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with NooDS. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bench_common.h"
+#include "../core/core_runtime.h"
+
+// Runs many copies of a ROM at once and reports the combined FPS, as JSON
+// Usage: noods-server-bench [--instances N] [--threads N] [--seconds S] [--separate] [--config DIR] <rom>
+// By default the cores share a work pool; --separate gives each its own thread like a normal frontend would
+
+static const int maxInstances = 1024;
+static std::atomic<uint32_t> frameCounts[maxInstances];
+
+static bool onFrame(Core *core) {
+    // Take the finished frame so the queue doesn't fill, and count it
+    frameCounts[core->id] += Bench::takeFrames(core);
+    return true;
+}
+
+int main(int argc, char **argv) {
+    // Parse the command line
+    std::string romPath, configDir;
+    int instances = 8, threads = 0;
+    double seconds = 10;
+    bool separate = false;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--separate") {
+            separate = true;
+        }
+        else if (arg[0] == '-' && i + 1 < argc) {
+            std::string value = argv[++i];
+            if (arg == "--instances") instances = atoi(value.c_str());
+            else if (arg == "--threads") threads = atoi(value.c_str());
+            else if (arg == "--seconds") seconds = atof(value.c_str());
+            else if (arg == "--config") configDir = value;
+        }
+        else {
+            romPath = arg;
+        }
+    }
+    if (romPath.empty() || instances <= 0 || instances > maxInstances || seconds <= 0) {
+        printf("Usage: %s [--instances N] [--threads N] [--seconds S] [--separate] [--config DIR] <rom>\n", argv[0]);
+        return 1;
+    }
+
+    // Use HLE BIOS and direct boot unless settings are given, and run uncapped
+    Bench::loadSettings(configDir);
+
+    // Boot all of the cores up front
+    bool gba = (romPath.size() >= 4 && romPath.compare(romPath.size() - 4, 4, ".gba") == 0);
+    std::vector<Core*> cores;
+    for (int i = 0; i < instances; i++) {
+        try {
+            cores.push_back(gba ? new Core("", romPath, i) : new Core(romPath, "", i));
+        }
+        catch (CoreError e) {
+            fprintf(stderr, "Error: failed to boot %s (error %d)\n", romPath.c_str(), e);
+            return 1;
+        }
+        frameCounts[i].store(0);
+    }
+
+    // Run the cores on a shared pool, or on a thread each
+    auto start = std::chrono::steady_clock::now();
+    int threadCount;
+    if (!separate) {
+        CoreRuntime runtime(threads);
+        threadCount = runtime.getThreadCount();
+        for (int i = 0; i < instances; i++)
+            runtime.addCore(cores[i], onFrame);
+        std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+        for (int i = 0; i < instances; i++)
+            runtime.removeCore(cores[i]);
+    }
+    else {
+        std::atomic<bool> running(true);
+        std::vector<std::thread*> workers;
+        for (int i = 0; i < instances; i++) {
+            workers.push_back(new std::thread([&running](Core *core) {
+                while (running.load())
+                    frameCounts[core->id] += Bench::runFrame(core);
+            }, cores[i]));
+        }
+        threadCount = instances;
+        std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+        running.store(false);
+        for (int i = 0; i < instances; i++) {
+            workers[i]->join();
+            delete workers[i];
+        }
+    }
+    double elapsed = Bench::elapsed(start);
+
+    // Report the combined and per-core frame rates
+    uint64_t total = 0;
+    double minFps = 1e9, maxFps = 0;
+    for (int i = 0; i < instances; i++) {
+        double fps = frameCounts[i].load() / elapsed;
+        total += frameCounts[i].load();
+        minFps = std::min(minFps, fps);
+        maxFps = std::max(maxFps, fps);
+        delete cores[i];
+    }
+    printf("{\n  \"instances\": %d,\n  \"threads\": %d,\n  \"mode\": \"%s\",\n", instances, threadCount,
+        separate ? "separate" : "pool");
+    printf("  \"seconds\": %.3f,\n  \"frames\": %llu,\n  \"fps\": %.1f,\n", elapsed, (unsigned long long)total,
+        total / elapsed);
+    printf("  \"minFps\": %.1f,\n  \"maxFps\": %.1f\n}\n", minFps, maxFps);
+    return 0;
+}
@@ -0,0 +1,157 @@
+/*
+    Copyright 2019-2026 Hydr8gon
+
+    This file is part of NooDS.
+
+    NooDS is free software: you can redistribute it and/or modify it
+    under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    NooDS is distributed in the hope that it will be useful, but
+    WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+    General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with NooDS. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include "bench_common.h"
+
+// Measures the latency of in-memory save state snapshots and restores, and of rewinding
+// Usage: noods-state-bench <rom> [frames] [iterations] [rewind frames]
+
+struct Timing {
+    double min = 1e9, max = 0, total = 0;
+    int count = 0;
+
+    void add(double us) {
+        // Track the range and sum of sample times
+        min = std::min(min, us);
+        max = std::max(max, us);
+        total += us;
+        count++;
+    }
+
+    void print(const char *name) {
+        // Report the timings in microseconds
+        printf("%-16s min %9.1f us   avg %9.1f us   max %9.1f us\n", name, min, total / count, max);
+    }
+};
+
+static double elapsedMicros(std::chrono::steady_clock::time_point start) {
+    // Get the microseconds passed since a starting time
+    return Bench::elapsed(start) * 1e6;
+}
+
+int main(int argc, char **argv) {
+    // Parse the command line
+    if (argc < 2) {
+        printf("Usage: %s <rom> [frames] [iterations] [rewind frames]\n", argv[0]);
+        return 1;
+    }
+    std::string path = argv[1];
+    int frames = (argc > 2) ? atoi(argv[2]) : 60;
+    int iterations = (argc > 3) ? atoi(argv[3]) : 100;
+    int rewindFrames = (argc > 4) ? atoi(argv[4]) : 30;
+    bool gba = (path.size() >= 4 && path.compare(path.size() - 4, 4, ".gba") == 0);
+
+    // Boot the ROM directly and run it for a bit so the state is representative
+    Core *core;
+    try {
+        core = gba ? new Core("", path) : new Core(path);
+    }
+    catch (CoreError e) {
+        printf("Error: failed to boot the ROM (error %d)\n", e);
+        return 1;
+    }
+    for (int i = 0; i < frames; i++)
+        Bench::runFrame(core);
+
+    // Allocate a growable arena and a fixed span sized from the first snapshot
+    // The span gets some slack since FIFOs can make the state size vary
+    StateBuffer arena;
+    core->saveStates.snapshot(arena);
+
+    // Check that a round trip leaves the state unchanged before timing anything
+    StateBuffer check;
+    if (core->saveStates.restore(arena) != STATE_SUCCESS || !core->saveStates.snapshot(check) ||
+            check.getSize() != arena.getSize() || memcmp(check.getData(), arena.getData(), arena.getSize())) {
+        printf("Error: state changed after a snapshot round trip\n");
+        return 1;
+    }
+    std::vector<uint8_t> spanData(arena.getSize() + 0x10000);
+    StateBuffer span(spanData.data(), spanData.size());
+    Timing arenaSave, arenaLoad, spanSave, spanLoad;
+
+    for (int i = 0; i < iterations; i++) {
+        // Advance a frame so each snapshot captures different data
+        Bench::runFrame(core);
+
+        // Time snapshots and restores with both buffer types
+        auto start = std::chrono::steady_clock::now();
+        core->saveStates.snapshot(arena);
+        arenaSave.add(elapsedMicros(start));
+        start = std::chrono::steady_clock::now();
+        if (core->saveStates.restore(arena) != STATE_SUCCESS) {
+            printf("Error: failed to restore from the arena\n");
+            return 1;
+        }
+        arenaLoad.add(elapsedMicros(start));
+        start = std::chrono::steady_clock::now();
+        bool spanFit = core->saveStates.snapshot(span);
+        spanSave.add(elapsedMicros(start));
+        start = std::chrono::steady_clock::now();
+        if (!spanFit || core->saveStates.restore(span) != STATE_SUCCESS) {
+            printf("Error: failed to restore from the span\n");
+            return 1;
+        }
+        spanLoad.add(elapsedMicros(start));
+    }
+
+    // Report the results
+    printf("State size: %zu bytes, %d iterations after %d frames\n", arena.getSize(), iterations, frames);
+    arenaSave.print("Arena snapshot:");
+    arenaLoad.print("Arena restore:");
+    spanSave.print("Span snapshot:");
+    spanLoad.print("Span restore:");
+
+    // Build up rewind history with a snapshot every frame, timing frames with the captures included
+    // The core stops following the global settings so they can't change the interval back
+    core->config.followGlobals = false;
+    core->config.rewindInterval = 1;
+    Timing frameTime, rewindTime;
+    for (int i = 0; i < iterations; i++) {
+        auto start = std::chrono::steady_clock::now();
+        Bench::runFrame(core);
+        frameTime.add(elapsedMicros(start));
+    }
+
+    // Report how compact the history is
+    RewindStats stats = core->rewind.getStats();
+    printf("Rewind history: %u snapshots, %zu byte head, %zu delta bytes (%.1f per snapshot), %u frames\n",
+        stats.snapshots, stats.stateBytes, stats.deltaBytes, double(stats.deltaBytes) /
+        std::max(1U, stats.snapshots - 1), stats.framesAvailable);
+    frameTime.print("Frame + capture:");
+
+    // Rewind through the history in steps until it runs out
+    while (rewindFrames > 0 && core->rewind.getStats().framesAvailable >= uint32_t(rewindFrames)) {
+        auto start = std::chrono::steady_clock::now();
+        core->rewind.rewind(rewindFrames);
+        rewindTime.add(elapsedMicros(start));
+    }
+    if (rewindTime.count) {
+        std::string name = "Rewind " + std::to_string(rewindFrames) + ":";
+        rewindTime.print(name.c_str());
+    }
+    delete core;
+    return 0;
+}
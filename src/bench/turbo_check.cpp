@@ -0,0 +1,132 @@
+/*
+    Copyright 2019-2026 Hydr8gon
+
+    This file is part of NooDS.
+
+    NooDS is free software: you can redistribute it and/or modify it
+    under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    NooDS is distributed in the hope that it will be useful, but
+    WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+    General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with NooDS. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "bench_common.h"
+
+// Checks that turbo mode leaves display captures the same as normal rendering does
+// A generated ROM idles while the checker changes the backdrop color every frame and requests captures during V-blank,
+// which is after turbo has picked the frames it skips; VRAM is then compared with a core that never skips
+// Usage: noods-turbo-check [frames]
+
+static const uint32_t codeAddrs[] = { 0x2000000, 0x37F8000 }; // ARM9 main RAM, ARM7 WRAM
+
+static FILE *buildRom() {
+    // Lay out a ROM with just the header fields direct boot needs, and a branch to self for each CPU
+    std::vector<uint8_t> rom(0x8000);
+    for (int i = 0; i < 2; i++) {
+        uint32_t offset = 0x1000 + i * 0x1000;
+        U32TO8(rom, 0x20 + i * 0x10, offset); // ROM offset
+        U32TO8(rom, 0x24 + i * 0x10, codeAddrs[i]); // Entry address
+        U32TO8(rom, 0x28 + i * 0x10, codeAddrs[i]); // RAM address
+        U32TO8(rom, 0x2C + i * 0x10, 4); // Size
+        U32TO8(rom, offset, 0xEAFFFFFE); // B .
+    }
+
+    // Write the ROM to an anonymous file for the core to load
+    FILE *file = tmpfile();
+    if (file) {
+        fwrite(rom.data(), sizeof(uint8_t), rom.size(), file);
+        fflush(file);
+    }
+    return file;
+}
+
+static void runTestFrame(Core *core, int frame) {
+    // Change the backdrop color, and request a full-screen capture of engine A every third frame
+    core->memory.write<uint16_t>(false, 0x5000000, frame * 0x421);
+    if (frame % 3 == 0)
+        core->memory.write<uint32_t>(false, 0x4000064, BIT(31) | (3 << 20)); // DISPCAPCNT
+
+    // Run the core until the frame ends
+    Bench::runFrame(core);
+}
+
+static bool vramMatches(Core *a, Core *b) {
+    // Compare the capture destination in VRAM bank A
+    for (uint32_t i = 0; i < 256 * 192 * 2; i += 4) {
+        if (a->memory.read<uint32_t>(false, 0x6800000 + i) != b->memory.read<uint32_t>(false, 0x6800000 + i))
+            return false;
+    }
+    return true;
+}
+
+int main(int argc, char **argv) {
+    // Parse the command line
+    int frames = (argc > 1) ? atoi(argv[1]) : 600;
+    if (frames <= 0) {
+        printf("Usage: %s [frames]\n", argv[0]);
+        return 1;
+    }
+
+    // Use HLE BIOS and direct boot, with turbo at a speed it can't reach so it skips as much as it can
+    Bench::loadSettings("");
+    Settings::threaded2D = Settings::threaded3D = 0;
+    Settings::turboSpeed = 1000000;
+
+    // Boot a turbo core and a reference core without turbo from the same ROM
+    FILE *file = buildRom();
+    if (!file) return 1;
+    Core *cores[2];
+    try {
+        for (int i = 0; i < 2; i++)
+            cores[i] = new Core("./turbo-check.nds", "", i, fileno(file));
+    }
+    catch (CoreError e) {
+        printf("Error: failed to boot the ROM (error %d)\n", e);
+        return 1;
+    }
+    cores[1]->config.followGlobals = false;
+    cores[1]->config.turboSpeed = 0;
+
+    for (int i = 0; i < 2; i++) {
+        // Power on both 2D engines, show engine A's graphics, and map VRAM bank A to the LCDC for captures
+        cores[i]->memory.write<uint16_t>(false, 0x4000304, 0x820F); // POWCNT1
+        cores[i]->memory.write<uint32_t>(false, 0x4000000, 0x10000); // DISPCNT
+        cores[i]->memory.write<uint8_t>(false, 0x4000240, 0x80); // VRAMCNT_A
+    }
+
+    // Run both cores in lockstep, checking VRAM after every frame
+    int maxInterval = 1;
+    for (int i = 1; i <= frames; i++) {
+        for (int j = 0; j < 2; j++)
+            runTestFrame(cores[j], i);
+        maxInterval = std::max(maxInterval, cores[0]->turbo.getInterval());
+        if (!vramMatches(cores[0], cores[1])) {
+            printf("Error: captured VRAM differs from the reference after %d frames (turbo interval %d)\n",
+                i, cores[0]->turbo.getInterval());
+            return 1;
+        }
+    }
+
+    // Fail if turbo never skipped, since then nothing was checked
+    if (maxInterval < 2) {
+        printf("Error: turbo didn't skip any frames in %d frames\n", frames);
+        return 1;
+    }
+    printf("Captured VRAM matched for %d frames, with turbo rendering 1 in up to %d frames\n", frames, maxInterval);
+    for (int i = 0; i < 2; i++)
+        delete cores[i];
+    fclose(file);
+    return 0;
+}
@@ -19,26 +19,26 @@
 
 #include "../core.h"
 
-void Cp15::saveState(FILE *file) {
-    // Write state data to the file
-    fwrite(&ctrlReg, sizeof(ctrlReg), 1, file);
-    fwrite(&dtcmReg, sizeof(dtcmReg), 1, file);
-    fwrite(&itcmReg, sizeof(itcmReg), 1, file);
-    fwrite(&procId, sizeof(procId), 1, file);
+void Cp15::saveState(StateBuffer *buffer) {
+    // Write state data to the buffer
+    buffer->write(&ctrlReg, sizeof(ctrlReg), 1);
+    buffer->write(&dtcmReg, sizeof(dtcmReg), 1);
+    buffer->write(&itcmReg, sizeof(itcmReg), 1);
+    buffer->write(&procId, sizeof(procId), 1);
 }
 
-void Cp15::loadState(FILE *file) {
-    // Read state data from the file
+void Cp15::loadState(StateBuffer *buffer) {
+    // Read state data from the buffer
     uint32_t ctrl, dtcm, itcm;
-    fread(&ctrl, sizeof(ctrl), 1, file);
-    fread(&dtcm, sizeof(dtcm), 1, file);
-    fread(&itcm, sizeof(itcm), 1, file);
-    fread(&procId, sizeof(procId), 1, file);
-
-    // Set registers along with values based on them
-    write(1, 0, 0, ctrl);
-    write(9, 1, 0, dtcm);
-    write(9, 1, 1, itcm);
+    buffer->read(&ctrl, sizeof(ctrl), 1);
+    buffer->read(&dtcm, sizeof(dtcm), 1);
+    buffer->read(&itcm, sizeof(itcm), 1);
+    buffer->read(&procId, sizeof(procId), 1);
+
+    // Set registers along with values based on them, skipping TCM remaps if nothing changed
+    if (ctrl != ctrlReg) write(1, 0, 0, ctrl);
+    if (dtcm != dtcmReg) write(9, 1, 0, dtcm);
+    if (itcm != itcmReg) write(9, 1, 1, itcm);
 }
 
 uint32_t Cp15::read(uint8_t cn, uint8_t cm, uint8_t cp) {
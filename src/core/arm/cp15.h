@@ -23,6 +23,7 @@
 #include <cstdio>
 
 class Core;
+class StateBuffer;
 
 class Cp15 {
 public:
@@ -33,8 +34,8 @@ public:
     uint32_t itcmSize = 0;
 
     Cp15(Core *core): core(core) {}
-    void saveState(FILE *file);
-    void loadState(FILE *file);
+    void saveState(StateBuffer *buffer);
+    void loadState(StateBuffer *buffer);
 
     uint32_t read(uint8_t cn, uint8_t cm, uint8_t cp);
     void write(uint8_t cn, uint8_t cm, uint8_t cp, uint32_t value);
@@ -25,52 +25,52 @@ Interpreter::Interpreter(Core *core, bool arm7): core(core), arm7(arm7) {
         registers[i] = &registersUsr[i & 0xF];
 }
 
-void Interpreter::saveState(FILE *file) {
-    // Write state data to the file
-    fwrite(pipeline, 4, sizeof(pipeline) / 4, file);
-    fwrite(registersUsr, 4, sizeof(registersUsr) / 4, file);
-    fwrite(registersFiq, 4, sizeof(registersFiq) / 4, file);
-    fwrite(registersSvc, 4, sizeof(registersSvc) / 4, file);
-    fwrite(registersAbt, 4, sizeof(registersAbt) / 4, file);
-    fwrite(registersIrq, 4, sizeof(registersIrq) / 4, file);
-    fwrite(registersUnd, 4, sizeof(registersUnd) / 4, file);
-    fwrite(&cpsr, sizeof(cpsr), 1, file);
-    fwrite(&spsrFiq, sizeof(spsrFiq), 1, file);
-    fwrite(&spsrSvc, sizeof(spsrSvc), 1, file);
-    fwrite(&spsrAbt, sizeof(spsrAbt), 1, file);
-    fwrite(&spsrIrq, sizeof(spsrIrq), 1, file);
-    fwrite(&spsrUnd, sizeof(spsrUnd), 1, file);
-    fwrite(&cycles, sizeof(cycles), 1, file);
-    fwrite(&halted, sizeof(halted), 1, file);
-    fwrite(&dsiCycle, sizeof(dsiCycle), 1, file);
-    fwrite(&ime, sizeof(ime), 1, file);
-    fwrite(&ie, sizeof(ie), 1, file);
-    fwrite(&irf, sizeof(irf), 1, file);
-    fwrite(&postFlg, sizeof(postFlg), 1, file);
+void Interpreter::saveState(StateBuffer *buffer) {
+    // Write state data to the buffer
+    buffer->write(pipeline, 4, sizeof(pipeline) / 4);
+    buffer->write(registersUsr, 4, sizeof(registersUsr) / 4);
+    buffer->write(registersFiq, 4, sizeof(registersFiq) / 4);
+    buffer->write(registersSvc, 4, sizeof(registersSvc) / 4);
+    buffer->write(registersAbt, 4, sizeof(registersAbt) / 4);
+    buffer->write(registersIrq, 4, sizeof(registersIrq) / 4);
+    buffer->write(registersUnd, 4, sizeof(registersUnd) / 4);
+    buffer->write(&cpsr, sizeof(cpsr), 1);
+    buffer->write(&spsrFiq, sizeof(spsrFiq), 1);
+    buffer->write(&spsrSvc, sizeof(spsrSvc), 1);
+    buffer->write(&spsrAbt, sizeof(spsrAbt), 1);
+    buffer->write(&spsrIrq, sizeof(spsrIrq), 1);
+    buffer->write(&spsrUnd, sizeof(spsrUnd), 1);
+    buffer->write(&cycles, sizeof(cycles), 1);
+    buffer->write(&halted, sizeof(halted), 1);
+    buffer->write(&dsiCycle, sizeof(dsiCycle), 1);
+    buffer->write(&ime, sizeof(ime), 1);
+    buffer->write(&ie, sizeof(ie), 1);
+    buffer->write(&irf, sizeof(irf), 1);
+    buffer->write(&postFlg, sizeof(postFlg), 1);
 }
 
-void Interpreter::loadState(FILE *file) {
-    // Read state data from the file
-    fread(pipeline, 4, sizeof(pipeline) / 4, file);
-    fread(registersUsr, 4, sizeof(registersUsr) / 4, file);
-    fread(registersFiq, 4, sizeof(registersFiq) / 4, file);
-    fread(registersSvc, 4, sizeof(registersSvc) / 4, file);
-    fread(registersAbt, 4, sizeof(registersAbt) / 4, file);
-    fread(registersIrq, 4, sizeof(registersIrq) / 4, file);
-    fread(registersUnd, 4, sizeof(registersUnd) / 4, file);
-    fread(&cpsr, sizeof(cpsr), 1, file);
-    fread(&spsrFiq, sizeof(spsrFiq), 1, file);
-    fread(&spsrSvc, sizeof(spsrSvc), 1, file);
-    fread(&spsrAbt, sizeof(spsrAbt), 1, file);
-    fread(&spsrIrq, sizeof(spsrIrq), 1, file);
-    fread(&spsrUnd, sizeof(spsrUnd), 1, file);
-    fread(&cycles, sizeof(cycles), 1, file);
-    fread(&halted, sizeof(halted), 1, file);
-    fread(&dsiCycle, sizeof(dsiCycle), 1, file);
-    fread(&ime, sizeof(ime), 1, file);
-    fread(&ie, sizeof(ie), 1, file);
-    fread(&irf, sizeof(irf), 1, file);
-    fread(&postFlg, sizeof(postFlg), 1, file);
+void Interpreter::loadState(StateBuffer *buffer) {
+    // Read state data from the buffer
+    buffer->read(pipeline, 4, sizeof(pipeline) / 4);
+    buffer->read(registersUsr, 4, sizeof(registersUsr) / 4);
+    buffer->read(registersFiq, 4, sizeof(registersFiq) / 4);
+    buffer->read(registersSvc, 4, sizeof(registersSvc) / 4);
+    buffer->read(registersAbt, 4, sizeof(registersAbt) / 4);
+    buffer->read(registersIrq, 4, sizeof(registersIrq) / 4);
+    buffer->read(registersUnd, 4, sizeof(registersUnd) / 4);
+    buffer->read(&cpsr, sizeof(cpsr), 1);
+    buffer->read(&spsrFiq, sizeof(spsrFiq), 1);
+    buffer->read(&spsrSvc, sizeof(spsrSvc), 1);
+    buffer->read(&spsrAbt, sizeof(spsrAbt), 1);
+    buffer->read(&spsrIrq, sizeof(spsrIrq), 1);
+    buffer->read(&spsrUnd, sizeof(spsrUnd), 1);
+    buffer->read(&cycles, sizeof(cycles), 1);
+    buffer->read(&halted, sizeof(halted), 1);
+    buffer->read(&dsiCycle, sizeof(dsiCycle), 1);
+    buffer->read(&ime, sizeof(ime), 1);
+    buffer->read(&ie, sizeof(ie), 1);
+    buffer->read(&irf, sizeof(irf), 1);
+    buffer->read(&postFlg, sizeof(postFlg), 1);
 
     // Update mapped registers
     swapRegisters(cpsr);
@@ -111,10 +111,15 @@ void Interpreter::runCoreNone(Core &core) {
     while (core.running.exchange(true)) {
         // Jump to the next task and run all that are scheduled now
         core.globalCycles = core.events[0].cycles;
+        core.perfTimers.enter(PERF_SCHED);
         while (core.events[0].cycles <= core.globalCycles) {
+            core.tracer.begin(Tracer::getTaskName(core.events[0].task));
+            core.metrics.tasks[core.events[0].task]++;
             core.tasks[core.events[0].task]();
+            core.tracer.end();
             core.events.erase(core.events.begin());
         }
+        core.perfTimers.leave();
     }
 }
 
@@ -132,10 +137,15 @@ template <bool _arm7, int shift> void Interpreter::runCoreSingle(Core &core) {
 
         // Jump to the next task and run all that are scheduled now
         core.globalCycles = core.events[0].cycles;
+        core.perfTimers.enter(PERF_SCHED);
         while (core.events[0].cycles <= core.globalCycles) {
+            core.tracer.begin(Tracer::getTaskName(core.events[0].task));
+            core.metrics.tasks[core.events[0].task]++;
             core.tasks[core.events[0].task]();
+            core.tracer.end();
             core.events.erase(core.events.begin());
         }
+        core.perfTimers.leave();
     }
 }
 
@@ -155,10 +165,15 @@ void Interpreter::runCoreNds(Core &core) {
 
         // Jump to the next task and run all that are scheduled now
         core.globalCycles = core.events[0].cycles;
+        core.perfTimers.enter(PERF_SCHED);
         while (core.events[0].cycles <= core.globalCycles) {
+            core.tracer.begin(Tracer::getTaskName(core.events[0].task));
+            core.metrics.tasks[core.events[0].task]++;
             core.tasks[core.events[0].task]();
+            core.tracer.end();
             core.events.erase(core.events.begin());
         }
+        core.perfTimers.leave();
     }
 }
 
@@ -184,10 +199,15 @@ void Interpreter::runCoreDsi(Core &core) {
 
         // Jump to the next task and run all that are scheduled now
         core.globalCycles = core.events[0].cycles;
+        core.perfTimers.enter(PERF_SCHED);
         while (core.events[0].cycles <= core.globalCycles) {
+            core.tracer.begin(Tracer::getTaskName(core.events[0].task));
+            core.metrics.tasks[core.events[0].task]++;
             core.tasks[core.events[0].task]();
+            core.tracer.end();
             core.events.erase(core.events.begin());
         }
+        core.perfTimers.leave();
     }
 }
 
@@ -195,11 +215,15 @@ FORCE_INLINE int Interpreter::runOpcode() {
     // Push the next opcode through the pipeline
     uint32_t opcode = pipeline[0];
     pipeline[0] = pipeline[1];
+    core->metrics.opcodes[arm7]++;
 
     // Execute an instruction
     if (cpsr & BIT(5)) { // THUMB mode
         // Increment the program counter and fill the pipeline from pointer or fallback
         pipeline[1] = (((*registers[15] += 2) & 0xFFE) && pcData) ? U8TO16(pcData += 2, 0) : getOpcode16();
+#ifdef PROFILER
+        core->profiler.countOpcode(arm7, true, (opcode >> 6) & 0x3FF, *registers[15] - 4, core->globalCycles);
+#endif
 
         // Execute a THUMB instruction
         return (this->*thumbInstrs[(opcode >> 6) & 0x3FF])(opcode);
@@ -207,6 +231,10 @@ FORCE_INLINE int Interpreter::runOpcode() {
     else { // ARM mode
         // Increment the program counter and fill the pipeline from pointer or fallback
         pipeline[1] = (((*registers[15] += 4) & 0xFFC) && pcData) ? U8TO32(pcData += 4, 0) : getOpcode32();
+#ifdef PROFILER
+        core->profiler.countOpcode(arm7, false, ((opcode >> 16) & 0xFF0) | ((opcode >> 4) & 0xF),
+            *registers[15] - 8, core->globalCycles);
+#endif
 
         // Execute an ARM instruction based on its condition
         switch (condition[((opcode >> 24) & 0xF0) | (cpsr >> 28)]) {
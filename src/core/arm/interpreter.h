@@ -23,6 +23,7 @@
 #include "../defines.h"
 
 class Core;
+class StateBuffer;
 class HleBios;
 
 class Interpreter {
@@ -32,8 +33,8 @@ public:
     uint8_t halted = 0;
 
     Interpreter(Core *core, bool arm7);
-    void saveState(FILE *file);
-    void loadState(FILE *file);
+    void saveState(StateBuffer *buffer);
+    void loadState(StateBuffer *buffer);
 
     void init();
     void directBoot();
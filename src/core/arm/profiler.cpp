@@ -0,0 +1,169 @@
+/*
+    Copyright 2019-2026 Hydr8gon
+
+    This file is part of NooDS.
+
+    NooDS is free software: you can redistribute it and/or modify it
+    under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    NooDS is distributed in the hope that it will be useful, but
+    WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+    General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with NooDS. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#include "profiler.h"
+#include "../core.h"
+
+uint32_t Profiler::interval = 1024;
+
+const char *Profiler::regions[] = {
+    "BIOS/ITCM", "Unmapped", "Main RAM", "WRAM", "I/O", "Palette", "VRAM", "OAM",
+    "GBA ROM", "GBA ROM", "GBA SRAM", "GBA ROM", "GBA ROM", "GBA ROM", "GBA SRAM", "BIOS"
+};
+
+Profiler::~Profiler() {
+    // Write the profile when the core is destroyed, if anything was executed
+    std::string path = core->config.basePath + "/profile" + (core->id ? std::to_string(core->id + 1) : "");
+    write(path);
+}
+
+bool Profiler::write(std::string path) {
+    // Skip writing if nothing has been profiled
+    bool empty = true;
+    for (int i = 0; i < 2; i++)
+        empty &= samples[i].empty();
+    if (empty) return false;
+
+    // Write a flat profile for each CPU
+    FILE *file = fopen((path + ".txt").c_str(), "w");
+    if (!file) return false;
+    writeCpu(file, 0);
+    writeCpu(file, 1);
+    fclose(file);
+
+    // Write sampled addresses as folded stacks, which can be fed to flame graph tools
+    if (!(file = fopen((path + ".folded").c_str(), "w"))) return false;
+    for (int i = 0; i < 2; i++) {
+        for (auto &sample : samples[i]) {
+            fprintf(file, "%s;%s;%s;0x%08X %llu\n", i ? "ARM7" : "ARM9", regions[(sample.first >> 24) & 0xF],
+                (sample.first & 0x1) ? "THUMB" : "ARM", sample.first & ~0x1, (unsigned long long)sample.second);
+        }
+    }
+    fclose(file);
+    LOG_INFO("Wrote guest profile to %s.txt\n", path.c_str());
+    return true;
+}
+
+void Profiler::reset() {
+    // Clear all counts and samples
+    memset(armCounts, 0, sizeof(armCounts));
+    memset(thumbCounts, 0, sizeof(thumbCounts));
+    memset(fallbacks, 0, sizeof(fallbacks));
+    memset(lastSample, 0, sizeof(lastSample));
+    samples[0].clear();
+    samples[1].clear();
+}
+
+void Profiler::writeCpu(FILE *file, bool arm7) {
+    // Total the opcodes and samples for the CPU
+    uint64_t opcodes = 0, total = 0;
+    for (int i = 0; i < 0x1000; i++) opcodes += armCounts[arm7][i];
+    for (int i = 0; i < 0x400; i++) opcodes += thumbCounts[arm7][i];
+    for (auto &sample : samples[arm7]) total += sample.second;
+    fprintf(file, "%s: %llu opcodes, %llu samples (1 per %u cycles)\n\n", arm7 ? "ARM7" : "ARM9",
+        (unsigned long long)opcodes, (unsigned long long)total, interval);
+    if (!opcodes) return;
+
+    // List the most sampled addresses
+    std::vector<std::pair<uint64_t, uint32_t>> sorted;
+    for (auto &sample : samples[arm7])
+        sorted.push_back(std::make_pair(sample.second, sample.first));
+    std::sort(sorted.rbegin(), sorted.rend());
+    fprintf(file, "    Samples  Percent  Address\n");
+    for (size_t i = 0; i < sorted.size() && i < 50; i++) {
+        fprintf(file, "%11llu %7.2f%%  0x%08X (%s)\n", (unsigned long long)sorted[i].first, sorted[i].first * 100.0
+            / total, sorted[i].second & ~0x1, (sorted[i].second & 0x1) ? "THUMB" : "ARM");
+    }
+
+    // Total opcodes by class, and list the most executed lookup table entries
+    std::vector<std::pair<uint64_t, std::string>> classes;
+    sorted.clear();
+    for (int i = 0; i < 0x1400; i++) {
+        uint64_t count = (i < 0x1000) ? armCounts[arm7][i] : thumbCounts[arm7][i - 0x1000];
+        if (!count) continue;
+        std::string name = (i < 0x1000) ? (std::string("ARM ") + armClass(i)) : (std::string("THUMB ") + thumbClass(i - 0x1000));
+        auto it = std::find_if(classes.begin(), classes.end(),
+            [&](const std::pair<uint64_t, std::string> &c) { return c.second == name; });
+        if (it != classes.end()) it->first += count;
+        else classes.push_back(std::make_pair(count, name));
+        sorted.push_back(std::make_pair(count, i));
+    }
+    std::sort(classes.rbegin(), classes.rend());
+    std::sort(sorted.rbegin(), sorted.rend());
+    fprintf(file, "\n    Opcodes  Percent  Class\n");
+    for (size_t i = 0; i < classes.size(); i++) {
+        fprintf(file, "%11llu %7.2f%%  %s\n", (unsigned long long)classes[i].first,
+            classes[i].first * 100.0 / opcodes, classes[i].second.c_str());
+    }
+    fprintf(file, "\n    Opcodes  Percent  Table index\n");
+    for (size_t i = 0; i < sorted.size() && i < 20; i++) {
+        bool thumb = (sorted[i].second >= 0x1000);
+        uint32_t index = sorted[i].second - (thumb ? 0x1000 : 0);
+        fprintf(file, "%11llu %7.2f%%  %s 0x%03X (%s)\n", (unsigned long long)sorted[i].first, sorted[i].first * 100.0
+            / opcodes, thumb ? "THUMB" : "ARM", index, thumb ? thumbClass(index) : armClass(index));
+    }
+
+    // List fallback memory accesses by region
+    fprintf(file, "\n   Accesses  Region\n");
+    for (int w = 0; w < 2; w++) {
+        for (int i = 0; i < 0x10; i++) {
+            if (!fallbacks[arm7][w][i]) continue;
+            fprintf(file, "%11llu  %s 0x%X (%s)\n", (unsigned long long)fallbacks[arm7][w][i],
+                w ? "write" : "read ", i << 24, regions[i]);
+        }
+    }
+    fprintf(file, "\n");
+}
+
+const char *Profiler::armClass(uint32_t index) {
+    // Classify an ARM lookup index, made from opcode bits 27-20 and 7-4
+    switch ((index >> 9) & 0x7) {
+        case 0x0:
+            if ((index & 0x9) == 0x9) // Bits 7 and 4 set
+                return (index & 0x6) ? "halfword" : ((index & 0xF00) ? "swap" : "multiply");
+            if ((index & 0xF90) == 0x100) // Miscellaneous space
+                return !(index & 0xF) ? "psr" : (index & 0x8) ? "multiply" : ((index & 0xFF5) == 0x121) ? "branch" : "other";
+            return "alu";
+        case 0x1: return ((index & 0xFB0) == 0x320) ? "psr" : "alu";
+        case 0x2: case 0x3: return "load/store";
+        case 0x4: return "block";
+        case 0x5: return "branch";
+        case 0x6: return "coprocessor";
+        default: return (index & 0x100) ? "swi" : "coprocessor";
+    }
+}
+
+const char *Profiler::thumbClass(uint32_t index) {
+    // Classify a THUMB lookup index, made from opcode bits 15-6
+    switch (index >> 6) {
+        case 0x0: case 0x1: case 0x2: case 0x3: return "alu";
+        case 0x4: return ((index >> 4) == 0x11 && (index & 0xC) == 0xC) ? "branch" : (index & 0x20) ? "load/store" : "alu";
+        case 0x5: case 0x6: case 0x7: case 0x9: return "load/store";
+        case 0x8: return "halfword";
+        case 0xA: return "alu";
+        case 0xB: return (index & 0x10) ? "block" : "alu";
+        case 0xC: return "block";
+        case 0xD: return ((index >> 2) == 0xDF) ? "swi" : "branch";
+        default: return "branch";
+    }
+}
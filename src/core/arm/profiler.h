@@ -0,0 +1,70 @@
+/*
+    Copyright 2019-2026 Hydr8gon
+
+    This file is part of NooDS.
+
+    NooDS is free software: you can redistribute it and/or modify it
+    under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    NooDS is distributed in the hope that it will be useful, but
+    WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+    General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with NooDS. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <unordered_map>
+
+#include "../defines.h"
+
+class Core;
+
+// Guest code profiler, only hooked into the CPU and memory when built with PROFILER defined
+// Counts opcodes by their lookup table index, samples the PC at a cycle interval, and tracks fallback memory accesses
+class Profiler {
+public:
+    static uint32_t interval;
+
+    Profiler(Core *core): core(core) {}
+    ~Profiler();
+
+    bool write(std::string path);
+    void reset();
+
+    FORCE_INLINE void countOpcode(bool arm7, bool thumb, uint32_t index, uint32_t pc, uint32_t cycles) {
+        // Count an opcode and sample its address if the interval has passed since the last sample
+        (thumb ? thumbCounts[arm7] : armCounts[arm7])[index]++;
+        if (cycles - lastSample[arm7] < interval) return;
+        lastSample[arm7] = cycles;
+        samples[arm7][pc | thumb]++;
+    }
+
+    FORCE_INLINE void countFallback(bool arm7, bool write, uint32_t address) {
+        // Count a memory access that missed the fast-path maps, by 16MB region
+        fallbacks[arm7][write][(address >> 24) & 0xF]++;
+    }
+
+private:
+    Core *core;
+
+    uint64_t armCounts[2][0x1000] = {};
+    uint64_t thumbCounts[2][0x400] = {};
+    uint64_t fallbacks[2][2][0x10] = {};
+    std::unordered_map<uint32_t, uint64_t> samples[2];
+    uint32_t lastSample[2] = {};
+
+    static const char *regions[0x10];
+
+    static const char *armClass(uint32_t index);
+    static const char *thumbClass(uint32_t index);
+    void writeCpu(FILE *file, bool arm7);
+};
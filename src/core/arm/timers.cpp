@@ -19,22 +19,22 @@
 
 #include "../core.h"
 
-void Timers::saveState(FILE *file) {
-    // Write state data to the file
-    fwrite(timers, 2, sizeof(timers) / 2, file);
-    fwrite(shifts, 1, sizeof(shifts), file);
-    fwrite(endCycles, 4, sizeof(endCycles) / 4, file);
-    fwrite(tmCntL, 2, sizeof(tmCntL) / 2, file);
-    fwrite(tmCntH, 2, sizeof(tmCntH) / 2, file);
+void Timers::saveState(StateBuffer *buffer) {
+    // Write state data to the buffer
+    buffer->write(timers, 2, sizeof(timers) / 2);
+    buffer->write(shifts, 1, sizeof(shifts));
+    buffer->write(endCycles, 4, sizeof(endCycles) / 4);
+    buffer->write(tmCntL, 2, sizeof(tmCntL) / 2);
+    buffer->write(tmCntH, 2, sizeof(tmCntH) / 2);
 }
 
-void Timers::loadState(FILE *file) {
-    // Read state data from the file
-    fread(timers, 2, sizeof(timers) / 2, file);
-    fread(shifts, 1, sizeof(shifts), file);
-    fread(endCycles, 4, sizeof(endCycles) / 4, file);
-    fread(tmCntL, 2, sizeof(tmCntL) / 2, file);
-    fread(tmCntH, 2, sizeof(tmCntH) / 2, file);
+void Timers::loadState(StateBuffer *buffer) {
+    // Read state data from the buffer
+    buffer->read(timers, 2, sizeof(timers) / 2);
+    buffer->read(shifts, 1, sizeof(shifts));
+    buffer->read(endCycles, 4, sizeof(endCycles) / 4);
+    buffer->read(tmCntL, 2, sizeof(tmCntL) / 2);
+    buffer->read(tmCntH, 2, sizeof(tmCntH) / 2);
 }
 
 void Timers::resetCycles() {
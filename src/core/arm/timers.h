@@ -23,12 +23,13 @@
 #include <cstdio>
 
 class Core;
+class StateBuffer;
 
 class Timers {
 public:
     Timers(Core *core, bool arm7): core(core), arm7(arm7) {}
-    void saveState(FILE *file);
-    void loadState(FILE *file);
+    void saveState(StateBuffer *buffer);
+    void loadState(StateBuffer *buffer);
 
     void resetCycles();
     void overflow(int timer);
@@ -0,0 +1,118 @@
+/*
+    Copyright 2019-2026 Hydr8gon
+
+    This file is part of NooDS.
+
+    NooDS is free software: you can redistribute it and/or modify it
+    under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    NooDS is distributed in the hope that it will be useful, but
+    WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+    General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with NooDS. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <cstring>
+#include <unordered_set>
+#include <vector>
+#include <sys/stat.h>
+
+#include "asset_cache.h"
+#include "save_states.h"
+
+std::unordered_map<std::string, AssetCache::Entry> AssetCache::entries;
+AssetCacheStats AssetCache::stats;
+std::mutex AssetCache::mutex;
+
+Asset AssetCache::load(const std::string &path, size_t minSize) {
+    // Get the size and modification time of the file, so stale assets aren't reused
+    Asset asset;
+    struct stat info;
+    if (stat(path.c_str(), &info) != 0)
+        return asset;
+    size_t fileSize = info.st_size;
+
+    // Reuse the asset from an earlier load if it's still in memory and the file hasn't changed
+    mutex.lock();
+    auto it = entries.find(path);
+    if (it != entries.end() && it->second.fileSize == fileSize && it->second.modTime == info.st_mtime &&
+        it->second.size >= minSize && (asset.data = it->second.data.lock())) {
+        asset.size = it->second.size;
+        stats.hits++;
+        mutex.unlock();
+        return asset;
+    }
+    stats.misses++;
+    mutex.unlock();
+
+    // Read the file outside of the lock, padding it with zeros up to the minimum size
+    FILE *file = fopen(path.c_str(), "rb");
+    if (!file) return asset;
+    size_t size = std::max(fileSize, minSize);
+    uint8_t *data = new uint8_t[size];
+    size_t count = fread(data, sizeof(uint8_t), fileSize, file);
+    memset(&data[count], 0, size - count);
+    fclose(file);
+    asset.data.reset(data, std::default_delete<uint8_t[]>());
+    asset.size = size;
+    uint32_t hash = SaveStates::checksum(data, size);
+
+    // Find assets from other paths that could be identical, and drop entries for freed assets
+    std::vector<std::shared_ptr<uint8_t>> candidates;
+    mutex.lock();
+    for (auto i = entries.begin(); i != entries.end();) {
+        std::shared_ptr<uint8_t> other = i->second.data.lock();
+        if (!other) {
+            i = entries.erase(i);
+            continue;
+        }
+        if (i->second.hash == hash && i->second.size == size)
+            candidates.push_back(other);
+        i++;
+    }
+    mutex.unlock();
+
+    // Compare the candidates outside of the lock, since large ROMs would hold up other loads, and share a match
+    bool deduped = false;
+    for (size_t i = 0; i < candidates.size(); i++) {
+        if (!memcmp(candidates[i].get(), asset.data.get(), size)) {
+            asset.data = candidates[i];
+            deduped = true;
+            break;
+        }
+    }
+
+    // Remember the asset for this path
+    mutex.lock();
+    if (deduped) stats.deduped++;
+    Entry &entry = entries[path];
+    entry.data = asset.data;
+    entry.size = size;
+    entry.fileSize = fileSize;
+    entry.modTime = info.st_mtime;
+    entry.hash = hash;
+    mutex.unlock();
+    return asset;
+}
+
+AssetCacheStats AssetCache::getStats() {
+    // Count the assets still in memory, with each shared one counted once
+    std::unordered_set<uint8_t*> live;
+    mutex.lock();
+    AssetCacheStats result = stats;
+    for (auto i = entries.begin(); i != entries.end(); i++) {
+        std::shared_ptr<uint8_t> data = i->second.data.lock();
+        if (data && live.insert(data.get()).second) {
+            result.assets++;
+            result.bytes += i->second.size;
+        }
+    }
+    mutex.unlock();
+    return result;
+}
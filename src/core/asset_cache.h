@@ -0,0 +1,63 @@
+/*
+    Copyright 2019-2026 Hydr8gon
+
+    This file is part of NooDS.
+
+    NooDS is free software: you can redistribute it and/or modify it
+    under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    NooDS is distributed in the hope that it will be useful, but
+    WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+    General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with NooDS. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <ctime>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+struct Asset {
+    std::shared_ptr<uint8_t> data;
+    size_t size = 0;
+};
+
+struct AssetCacheStats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t deduped = 0;
+    size_t assets = 0;
+    size_t bytes = 0;
+};
+
+// Shares read-only files like BIOS, firmware, and ROMs between cores, keyed by path and by content
+// Assets are freed once no core holds them; anything that needs changes must be copied first
+class AssetCache {
+public:
+    static Asset load(const std::string &path, size_t minSize = 0);
+    static AssetCacheStats getStats();
+
+private:
+    struct Entry {
+        std::weak_ptr<uint8_t> data;
+        size_t size = 0;
+        size_t fileSize = 0;
+        time_t modTime = 0;
+        uint32_t hash = 0;
+    };
+
+    static std::unordered_map<std::string, Entry> entries;
+    static AssetCacheStats stats;
+    static std::mutex mutex;
+
+    AssetCache() {} // Private to prevent instantiation
+};
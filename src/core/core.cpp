@@ -23,25 +23,19 @@
 
 #include "core.h"
 
-Core::Core(std::string ndsRom, std::string gbaRom, int id, int ndsRomFd, int gbaRomFd,
-    int ndsSaveFd, int gbaSaveFd, int ndsStateFd, int gbaStateFd, int ndsCheatFd):
-        id(id), actionReplay(this), aes(this), cartridgeGba(this), cartridgeNds(this), cp15(this), divSqrt(this), dldi(
-        this), dma { Dma(this, 0), Dma(this, 1) }, gpu(this), gpu2D { Gpu2D(this, 0), Gpu2D(this, 1) }, gpu3D(this),
-        gpu3DRenderer(this), hleArm7(this), hleBios { HleBios(this, 0, HleBios::swiTable9), HleBios(this, 1, HleBios::
-        swiTable7), HleBios(this, 1, HleBios::swiTableGba) }, i2c(this), input(this), interpreter { Interpreter(
-        this, 0), Interpreter(this, 1) }, ipc(this), memory(this), ndma { Ndma(this, 0), Ndma(this, 1) }, rtc(this),
-        saveStates(this), sdMmc(this), spi(this), spu(this), timers { Timers(this, 0), Timers(this, 1) }, wifi(this) {
-    // Set DSi mode now and ignore changes to it later
-    dsiMode = Settings::dsiMode;
+Core::Core(int id, Core *parent, const CoreConfig &config):
+        id(id), config(config), actionReplay(this), aes(this), cartridgeGba(this), cartridgeNds(this), cp15(this),
+        divSqrt(this), dldi(this), dma { Dma(this, 0), Dma(this, 1) }, gpu(this), gpu2D { Gpu2D(this, 0), Gpu2D(this,
+        1) }, gpu3D(this), gpu3DRenderer(this), hleArm7(this), hleBios { HleBios(this, 0, HleBios::swiTable9),
+        HleBios(this, 1, HleBios::swiTable7), HleBios(this, 1, HleBios::swiTableGba) }, i2c(this), input(this),
+        interpreter { Interpreter(this, 0), Interpreter(this, 1) }, ipc(this), memory(this), movie(this), ndma {
+        Ndma(this, 0), Ndma(this, 1) }, rewind(this), rtc(this), saveStates(this), sdMmc(this), spi(this), spu(this),
+        timers { Timers(this, 0), Timers(this, 1) }, tracer(this), turbo(this), wifi(this) {
+    // Set DSi mode now and ignore changes to it later; forks always match their parent
+    dsiMode = parent ? parent->dsiMode : config.dsiMode;
+    lastFrameTime = std::chrono::steady_clock::now();
     updateRun();
 
-    // Try to load BIOS and firmware; require DS files when not direct booting
-    bool req = !Settings::directBoot || dsiMode || (ndsRom == "" && gbaRom == "" && ndsRomFd == -1 && gbaRomFd == -1);
-    if (!memory.loadBios9() && req) throw dsiMode ? ERROR_DSI_BIOS : ERROR_NDS_BIOS;
-    if (!memory.loadBios7() && req) throw dsiMode ? ERROR_DSI_BIOS : ERROR_NDS_BIOS;
-    if (!spi.loadFirmware() && req) throw dsiMode ? ERROR_DSI_FIRM : ERROR_NDS_FIRM;
-    realGbaBios = memory.loadGbaBios();
-
     // Define the tasks that can be scheduled
     tasks[UPDATE_RUN] = std::bind(&Core::updateRun, this);
     tasks[RESET_CYCLES] = std::bind(&Core::resetCycles, this);
@@ -80,12 +74,23 @@ Core::Core(std::string ndsRom, std::string gbaRom, int id, int ndsRomFd, int gba
     tasks[NDMA7_UPDATE] = std::bind(&Ndma::update, &ndma[1]);
     tasks[SDMMC_READ_BLOCK] = std::bind(&SdMmc::readBlock, &sdMmc);
     tasks[SDMMC_WRITE_BLOCK] = std::bind(&SdMmc::writeBlock, &sdMmc);
+}
+
+Core::Core(std::string ndsRom, std::string gbaRom, int id, int ndsRomFd, int gbaRomFd, int ndsSaveFd,
+        int gbaSaveFd, int ndsStateFd, int gbaStateFd, int ndsCheatFd, const CoreConfig &config):
+        Core(id, nullptr, config) {
+    // Try to load BIOS and firmware; require DS files when not direct booting
+    bool req = !config.directBoot || dsiMode || (ndsRom == "" && gbaRom == "" && ndsRomFd == -1 && gbaRomFd == -1);
+    if (!memory.loadBios9() && req) throw dsiMode ? ERROR_DSI_BIOS : ERROR_NDS_BIOS;
+    if (!memory.loadBios7() && req) throw dsiMode ? ERROR_DSI_BIOS : ERROR_NDS_BIOS;
+    if (!spi.loadFirmware() && req) throw dsiMode ? ERROR_DSI_FIRM : ERROR_NDS_FIRM;
+    realGbaBios = memory.loadGbaBios();
 
     // Schedule initial tasks for NDS mode
     schedule(RESET_CYCLES, 0x7FFFFFFF);
     schedule(NDS_SCANLINE256, 256 * 6);
     schedule(NDS_SCANLINE355, 355 * 6);
-    schedule(NDS_SPU_SAMPLE, 512 * 2);
+    spu.scheduleInit();
 
     // Initialize memory maps and anything else that needs it
     memory.updateMap9(0x00000000, 0xFFFFFFFF);
@@ -98,7 +103,7 @@ Core::Core(std::string ndsRom, std::string gbaRom, int id, int ndsRomFd, int gba
     if (dsiMode) {
         // Read the stage 2 header
         uint8_t header[0x200];
-        FILE *nand = fopen(Settings::dsiNandPath.c_str(), "rb");
+        FILE *nand = fopen(config.dsiNandPath.c_str(), "rb");
         if (!nand) throw ERROR_DSI_NAND;
         fseek(nand, 0x200, SEEK_SET);
         fread(header, sizeof(uint8_t), 0x200, nand);
@@ -249,7 +254,7 @@ Core::Core(std::string ndsRom, std::string gbaRom, int id, int ndsRomFd, int gba
             throw ERROR_ROM;
 
         // Enable GBA mode right away if direct boot is enabled
-        if (Settings::directBoot && ndsRom == "" && ndsRomFd == -1) {
+        if (config.directBoot && ndsRom == "" && ndsRomFd == -1) {
             memory.write<uint16_t>(0, 0x4000304, 0x8003); // POWCNT1
             enterGbaMode();
         }
@@ -264,7 +269,7 @@ Core::Core(std::string ndsRom, std::string gbaRom, int id, int ndsRomFd, int gba
         actionReplay.loadCheats();
 
         // Prepare to boot the NDS ROM directly if direct boot is enabled
-        if (Settings::directBoot) {
+        if (config.directBoot) {
             // Set some registers as the BIOS/firmware would
             cp15.write(1, 0, 0, 0x0005707D); // CP15 Control
             cp15.write(9, 1, 0, 0x0300000A); // Data TCM base/size
@@ -294,7 +299,7 @@ Core::Core(std::string ndsRom, std::string gbaRom, int id, int ndsRomFd, int gba
     }
 
     // Initialize HLE ARM7 if enabled in DS mode
-    if (!gbaMode && Settings::arm7Hle) {
+    if (!gbaMode && config.arm7Hle) {
         arm7Hle = true;
         hleArm7.init();
     }
@@ -303,34 +308,72 @@ Core::Core(std::string ndsRom, std::string gbaRom, int id, int ndsRomFd, int gba
     running.store(true);
 }
 
-void Core::saveState(FILE *file) {
-    // Write state data to the file
-    fwrite(&arm7Hle, sizeof(arm7Hle), 1, file);
-    fwrite(&dsiMode, sizeof(dsiMode), 1, file);
-    fwrite(&gbaMode, sizeof(gbaMode), 1, file);
-    fwrite(&globalCycles, sizeof(globalCycles), 1, file);
+Core *Core::fork() {
+    // Capture the current state; like other snapshots, this should only happen between runs
+    StateBuffer state;
+    if (!saveStates.snapshot(state))
+        return nullptr;
+
+    // Create a child that shares the ROM and copies anything else that isn't part of save states
+    Core *child = new Core(id, this, config);
+    child->realGbaBios = realGbaBios;
+    child->actionReplay.inherit(actionReplay);
+    child->cartridgeGba.inherit(cartridgeGba);
+    child->cartridgeNds.inherit(cartridgeNds);
+    child->dldi.inherit(dldi);
+    child->memory.inherit(memory);
+    child->rtc.inherit(rtc);
+    child->sdMmc.inherit(sdMmc);
+    child->spi.inherit(spi);
+
+    // Point the child's interpreters at its own HLE BIOS if the parent uses one
+    for (int i = 0; i < 2; i++)
+        if (interpreter[i].bios)
+            child->interpreter[i].bios = &child->hleBios[interpreter[i].bios - hleBios];
+
+    // Bring the child to the current state and let it run independently
+    // The child has no events scheduled until then, so it can't be returned if the restore fails
+    if (child->saveStates.restore(state) != STATE_SUCCESS) {
+        delete child;
+        return nullptr;
+    }
+    child->running.store(true);
+    return child;
+}
+
+void Core::saveState(StateBuffer *buffer) {
+    // Write state data to the buffer
+    buffer->write(&arm7Hle, sizeof(arm7Hle), 1);
+    buffer->write(&dsiMode, sizeof(dsiMode), 1);
+    buffer->write(&gbaMode, sizeof(gbaMode), 1);
+    buffer->write(&globalCycles, sizeof(globalCycles), 1);
 
     // Parse the scheduler and save its events
     uint32_t count = events.size();
-    fwrite(&count, sizeof(count), 1, file);
+    buffer->write(&count, sizeof(count), 1);
     for (uint32_t i = 0; i < count; i++)
-        fwrite(&events[i], sizeof(events[i]), 1, file);
+        buffer->write(&events[i], sizeof(events[i]), 1);
 }
 
-void Core::loadState(FILE *file) {
-    // Read state data from the file
-    fread(&arm7Hle, sizeof(arm7Hle), 1, file);
-    fread(&dsiMode, sizeof(dsiMode), 1, file);
-    fread(&gbaMode, sizeof(gbaMode), 1, file);
-    fread(&globalCycles, sizeof(globalCycles), 1, file);
+void Core::loadState(StateBuffer *buffer) {
+    // Read state data from the buffer
+    bool dsi = dsiMode, gba = gbaMode;
+    buffer->read(&arm7Hle, sizeof(arm7Hle), 1);
+    buffer->read(&dsiMode, sizeof(dsiMode), 1);
+    buffer->read(&gbaMode, sizeof(gbaMode), 1);
+    buffer->read(&globalCycles, sizeof(globalCycles), 1);
+
+    // Rebuild all memory maps when memory loads if the console mode changed
+    if (dsi != dsiMode || gba != gbaMode)
+        memory.invalidateMaps();
 
     // Reset the scheduler and refill it with loaded events
     events.clear();
     uint32_t count;
     SchedEvent event(MAX_TASKS, 0);
-    fread(&count, sizeof(count), 1, file);
+    buffer->read(&count, sizeof(count), 1);
     for (uint32_t i = 0; i < count; i++) {
-        fread(&event, sizeof(event), 1, file);
+        buffer->read(&event, sizeof(event), 1);
         events.push_back(event);
     }
 
@@ -338,6 +381,15 @@ void Core::loadState(FILE *file) {
     updateRun();
 }
 
+void Core::runCore() {
+    // Run the core until it breaks, then handle anything that has to happen between runs
+    perfTimers.enter(PERF_CPU);
+    (*runFunc)(*this);
+    perfTimers.leave();
+    if (rewind.isPending()) rewind.update();
+    if (saveStates.isPending()) saveStates.update();
+}
+
 void Core::updateRun() {
     // Set the run function based on active CPUs and core mode
     if (interpreter[0].halted && interpreter[1].halted)
@@ -361,6 +413,7 @@ void Core::resetCycles() {
         events[i].cycles -= globalCycles;
     for (int i = 0; i < 2; i++)
         interpreter[i].resetCycles(), timers[i].resetCycles();
+    spu.resetCycles();
     globalCycles -= globalCycles;
     schedule(RESET_CYCLES, 0x7FFFFFFF);
 }
@@ -368,6 +421,7 @@ void Core::resetCycles() {
 void Core::schedule(SchedTask task, uint32_t cycles) {
     // Add a task to the scheduler, sorted by least to most cycles until execution
     SchedEvent event(task, globalCycles + cycles);
+    tracer.instant("schedule", TRACK_EMU, cycles, Tracer::getTaskName(task));
     auto it = std::upper_bound(events.cbegin(), events.cend(), event);
     events.insert(it, event);
 }
@@ -383,7 +437,7 @@ void Core::enterGbaMode() {
     schedule(RESET_CYCLES, 1);
     schedule(GBA_SCANLINE240, 240 * 4);
     schedule(GBA_SCANLINE308, 308 * 4);
-    schedule(GBA_SPU_SAMPLE, 512);
+    spu.scheduleInit();
 
     // Reset the system for GBA mode
     memory.updateMap7(0x00000000, 0xFFFFFFFF);
@@ -410,12 +464,26 @@ void Core::enterGbaMode() {
 void Core::endFrame() {
     // Break execution at the end of a frame and count it
     running.store(false);
+    tracer.instant("frame");
     fpsCount++;
 
     // Run HLE ARM7 per-frame tasks if enabled
     if (arm7Hle)
         hleArm7.runFrame();
 
+    // Bring audio up to date, since it can lag behind in lazy mode
+    spu.endFrame();
+
+    // Record or check the frame if an input movie is active
+    movie.endFrame();
+
+    // Pick up changes to the global settings if following them
+    if (config.followGlobals)
+        config.update();
+
+    // Count frames towards the next rewind snapshot
+    rewind.endFrame();
+
     // Update the FPS and reset the counter every second
     std::chrono::duration<double> fpsTime = std::chrono::steady_clock::now() - lastFpsTime;
     if (fpsTime.count() >= 1.0f) {
@@ -427,4 +495,29 @@ void Core::endFrame() {
     // Schedule WiFi updates only when needed
     if (wifi.shouldSchedule())
         wifi.scheduleInit();
+
+    // Fill in the remaining frame metrics and publish them, then start counting the next frame
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    uint32_t underruns = spu.getUnderruns();
+    metrics.frame = lastMetrics.frame + 1;
+    metrics.hostNanos = std::chrono::duration_cast<std::chrono::nanoseconds>(now - lastFrameTime).count();
+    metrics.pixels3D = gpu3DRenderer.takePixels();
+    metrics.audioUnderruns = underruns - lastUnderruns;
+    lastFrameTime = now;
+    lastUnderruns = underruns;
+    metricsMutex.lock();
+    lastMetrics = metrics;
+    metricsMutex.unlock();
+    metrics = FrameMetrics();
+
+    // Retune turbo mode with the time the frame took
+    turbo.endFrame(lastMetrics.hostNanos);
+}
+
+FrameMetrics Core::getMetrics() {
+    // Get a copy of the metrics from the last completed frame
+    metricsMutex.lock();
+    FrameMetrics copy = lastMetrics;
+    metricsMutex.unlock();
+    return copy;
 }
@@ -22,14 +22,22 @@
 #include <chrono>
 #include <cstdint>
 #include <functional>
+#include <mutex>
 #include <string>
 #include <vector>
 
 #include "defines.h"
+#include "movie.h"
+#include "perf_timers.h"
+#include "rewind.h"
 #include "save_states.h"
 #include "settings.h"
+#include "tracer.h"
+#include "turbo.h"
+#include "work_pool.h"
 #include "arm/cp15.h"
 #include "arm/interpreter.h"
+#include "arm/profiler.h"
 #include "arm/timers.h"
 #include "gpu/gpu.h"
 #include "gpu/gpu_2d.h"
@@ -112,10 +120,25 @@ struct SchedEvent {
     bool operator<(const SchedEvent &event) const { return cycles < event.cycles; }
 };
 
+struct FrameMetrics {
+    uint64_t frame = 0;
+    uint64_t hostNanos = 0;
+    uint32_t opcodes[2] = {};
+    uint32_t tasks[MAX_TASKS] = {};
+    uint32_t dmaWords = 0;
+    uint32_t gxCommands = 0;
+    uint32_t polygons = 0;
+    uint32_t vertices = 0;
+    uint32_t pixels3D = 0;
+    uint32_t audioUnderruns = 0;
+    uint32_t droppedFrames = 0;
+};
+
 class Core {
 public:
     int id = 0;
     int fps = 0;
+    CoreConfig config;
     bool arm7Hle = false;
     bool dsiMode = false;
     bool gbaMode = false;
@@ -139,29 +162,42 @@ public:
     Interpreter interpreter[2];
     Ipc ipc;
     Memory memory;
+    Movie movie;
     Ndma ndma[2];
+    PerfTimers perfTimers;
+#ifdef PROFILER
+    Profiler profiler{this};
+#endif
+    Rewind rewind;
     Rtc rtc;
     SaveStates saveStates;
     SdMmc sdMmc;
     Spi spi;
     Spu spu;
     Timers timers[2];
+    Tracer tracer;
+    Turbo turbo;
     Wifi wifi;
 
     std::atomic<bool> running;
+    WorkPool *workPool = nullptr;
+    FrameMetrics metrics;
     std::vector<SchedEvent> events;
     std::function<void()> tasks[MAX_TASKS];
     uint32_t globalCycles = 0;
 
     Core(std::string ndsRom = "", std::string gbaRom = "", int id = 0, int ndsRomFd = -1, int gbaRomFd = -1,
-        int ndsSaveFd = -1, int gbaSaveFd = -1, int ndsStateFd = -1, int gbaStateFd = -1, int ndsCheatFd = -1);
-    void saveState(FILE *file);
-    void loadState(FILE *file);
+        int ndsSaveFd = -1, int gbaSaveFd = -1, int ndsStateFd = -1, int gbaStateFd = -1, int ndsCheatFd = -1,
+        const CoreConfig &config = CoreConfig());
+    Core *fork();
+    void saveState(StateBuffer *buffer);
+    void loadState(StateBuffer *buffer);
 
-    void runCore() { (*runFunc)(*this); }
+    void runCore();
     void schedule(SchedTask task, uint32_t cycles);
     void enterGbaMode();
     void endFrame();
+    FrameMetrics getMetrics();
 
 private:
     bool realGbaBios;
@@ -169,6 +205,12 @@ private:
     std::chrono::steady_clock::time_point lastFpsTime;
     int fpsCount = 0;
 
+    std::mutex metricsMutex;
+    FrameMetrics lastMetrics;
+    std::chrono::steady_clock::time_point lastFrameTime;
+    uint32_t lastUnderruns = 0;
+
+    Core(int id, Core *parent, const CoreConfig &config);
     void updateRun();
     void resetCycles();
 };
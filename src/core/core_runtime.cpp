@@ -0,0 +1,96 @@
+/*
+    Copyright 2019-2026 Hydr8gon
+
+    This file is part of NooDS.
+
+    NooDS is free software: you can redistribute it and/or modify it
+    under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    NooDS is distributed in the hope that it will be useful, but
+    WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+    General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with NooDS. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <chrono>
+#include <thread>
+
+#include "core_runtime.h"
+#include "core.h"
+
+CoreRuntime::~CoreRuntime() {
+    // Stop all cores before the pool goes away; deleting them is left to the owner
+    mutex.lock();
+    std::vector<Instance*> remaining = instances;
+    mutex.unlock();
+    for (size_t i = 0; i < remaining.size(); i++)
+        removeCore(remaining[i]->core);
+}
+
+void CoreRuntime::addCore(Core *core, std::function<bool(Core*)> onFrame) {
+    // Attach a core to the pool and queue its first frame
+    Instance *instance = new Instance();
+    instance->core = core;
+    instance->onFrame = onFrame;
+    instance->active.store(true);
+    instance->stopped.store(false);
+    core->workPool = &pool;
+    mutex.lock();
+    instances.push_back(instance);
+    mutex.unlock();
+    pool.submit(std::bind(&CoreRuntime::runFrame, this, instance));
+}
+
+void CoreRuntime::removeCore(Core *core) {
+    // Find the core's instance and take it out of the list
+    Instance *instance = nullptr;
+    mutex.lock();
+    for (size_t i = 0; i < instances.size(); i++) {
+        if (instances[i]->core != core) continue;
+        instance = instances[i];
+        instances.erase(instances.begin() + i);
+        break;
+    }
+    mutex.unlock();
+    if (!instance) return;
+
+    // Wait for its current frame and any 3D jobs to finish, then detach it from the pool
+    // This shouldn't be called from a frame callback, since the frame wouldn't be able to finish
+    instance->active.store(false);
+    while (!instance->stopped.load())
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    core->gpu3DRenderer.waitJobs();
+    core->workPool = nullptr;
+    delete instance;
+}
+
+size_t CoreRuntime::getCoreCount() {
+    // Get the number of cores currently attached
+    mutex.lock();
+    size_t count = instances.size();
+    mutex.unlock();
+    return count;
+}
+
+void CoreRuntime::runFrame(Instance *instance) {
+    // Run the core until its frame count moves, since it also breaks whenever a CPU halts or wakes
+    // Then report the frame if a callback was given
+    if (instance->active.load()) {
+        uint64_t frame = instance->core->getMetrics().frame;
+        do instance->core->runCore();
+        while (instance->active.load() && instance->core->getMetrics().frame == frame);
+        if (instance->onFrame && !instance->onFrame(instance->core))
+            instance->active.store(false);
+    }
+
+    // Queue the next frame behind other cores' jobs, or signal that the core has stopped
+    if (instance->active.load())
+        pool.submit(std::bind(&CoreRuntime::runFrame, this, instance));
+    else
+        instance->stopped.store(true);
+}
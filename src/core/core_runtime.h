@@ -0,0 +1,58 @@
+/*
+    Copyright 2019-2026 Hydr8gon
+
+    This file is part of NooDS.
+
+    NooDS is free software: you can redistribute it and/or modify it
+    under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    NooDS is distributed in the hope that it will be useful, but
+    WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+    General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with NooDS. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+#include "work_pool.h"
+
+class Core;
+
+// Runs many independent cores on one work pool sized to the machine, instead of giving each its own threads
+// Every frame of a core is a job on the pool, and the cores queue their 3D rendering jobs on it too
+// The frame callback runs on a worker once per emulated frame; returning false stops the core, but leaves it attached
+class CoreRuntime {
+public:
+    CoreRuntime(int threads = 0): pool(threads) {}
+    ~CoreRuntime();
+
+    void addCore(Core *core, std::function<bool(Core*)> onFrame = nullptr);
+    void removeCore(Core *core);
+
+    size_t getCoreCount();
+    int getThreadCount() { return pool.getCount(); }
+
+private:
+    struct Instance {
+        Core *core;
+        std::function<bool(Core*)> onFrame;
+        std::atomic<bool> active;
+        std::atomic<bool> stopped;
+    };
+
+    WorkPool pool;
+    std::mutex mutex;
+    std::vector<Instance*> instances;
+
+    void runFrame(Instance *instance);
+};
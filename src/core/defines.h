@@ -53,6 +53,11 @@
 #include <unistd.h>
 #endif
 
+// Compatibility toggle for systems that don't have mmap
+#ifndef NO_MMAP
+#include <sys/mman.h>
+#endif
+
 // Macro to handle differing mkdir arguments on Windows
 #ifdef WINDOWS
 #define MKDIR_ARGS
@@ -18,6 +18,7 @@
 */
 
 #include <cstring>
+#include "gpu_simd.h"
 #include "../core.h"
 
 Gpu::Gpu(Core *core): core(core) {
@@ -51,20 +52,20 @@ void Gpu::init() {
     dispStat[1] |= BIT(6);
 }
 
-void Gpu::saveState(FILE *file) {
-    // Write state data to the file
-    fwrite(dispStat, 2, sizeof(dispStat) / 2, file);
-    fwrite(&vCount, sizeof(vCount), 1, file);
-    fwrite(&dispCapCnt, sizeof(dispCapCnt), 1, file);
-    fwrite(&powCnt1, sizeof(powCnt1), 1, file);
+void Gpu::saveState(StateBuffer *buffer) {
+    // Write state data to the buffer
+    buffer->write(dispStat, 2, sizeof(dispStat) / 2);
+    buffer->write(&vCount, sizeof(vCount), 1);
+    buffer->write(&dispCapCnt, sizeof(dispCapCnt), 1);
+    buffer->write(&powCnt1, sizeof(powCnt1), 1);
 }
 
-void Gpu::loadState(FILE *file) {
-    // Read state data from the file
-    fread(dispStat, 2, sizeof(dispStat) / 2, file);
-    fread(&vCount, sizeof(vCount), 1, file);
-    fread(&dispCapCnt, sizeof(dispCapCnt), 1, file);
-    fread(&powCnt1, sizeof(powCnt1), 1, file);
+void Gpu::loadState(StateBuffer *buffer) {
+    // Read state data from the buffer
+    buffer->read(dispStat, 2, sizeof(dispStat) / 2);
+    buffer->read(&vCount, sizeof(vCount), 1);
+    buffer->read(&dispCapCnt, sizeof(dispCapCnt), 1);
+    buffer->read(&powCnt1, sizeof(powCnt1), 1);
 }
 
 uint32_t Gpu::rgb5ToRgb8(uint32_t color) {
@@ -75,14 +76,6 @@ uint32_t Gpu::rgb5ToRgb8(uint32_t color) {
     return (0xFF << 24) | (b << 16) | (g << 8) | r;
 }
 
-uint32_t Gpu::rgb6ToRgb8(uint32_t color) {
-    // Convert an RGB6 value to an RGB8 value
-    uint8_t r = ((color >> 0) & 0x3F) * 255 / 63;
-    uint8_t g = ((color >> 6) & 0x3F) * 255 / 63;
-    uint8_t b = ((color >> 12) & 0x3F) * 255 / 63;
-    return (0xFF << 24) | (b << 16) | (g << 8) | r;
-}
-
 uint16_t Gpu::rgb6ToRgb5(uint32_t color) {
     // Convert an RGB6 value to an RGB5 value
     uint8_t r = ((color >> 0) & 0x3F) / 2;
@@ -101,20 +94,15 @@ bool Gpu::getFrame(uint32_t *out, bool gbaCrop) {
 
     if (gbaCrop) {
         // Output the frame in RGB8 format, cropped for GBA
-        if (Settings::highRes3D || Settings::screenFilter == 1) {
+        if (core->config.highRes3D || core->config.screenFilter == 1) {
             // GBA doesn't have 3D, but draw the screen upscaled for consistency
-            for (int y = 0; y < 160; y++) {
-                uint32_t *line = &out[y * 240 * 4];
-                for (int x = 0; x < 240; x++)
-                    line[x * 2] = line[x * 2 + 1] = rgb5ToRgb8(buffers.framebuffer[y * 256 + x]);
-                memcpy(&line[240 * 2], line, 240 * 8);
-            }
+            for (int y = 0; y < 160; y++)
+                GpuSimd::rgb5ToRgb8x2(&buffers.framebuffer[y * 256], &out[y * 240 * 4], 240);
         }
         else {
             // Draw to a native resolution buffer
             for (int y = 0; y < 160; y++)
-                for (int x = 0; x < 240; x++)
-                    out[y * 240 + x] = rgb5ToRgb8(buffers.framebuffer[y * 256 + x]);
+                GpuSimd::rgb5ToRgb8(&buffers.framebuffer[y * 256], &out[y * 240], 240);
         }
     }
     else if (core->gbaMode) {
@@ -125,7 +113,7 @@ bool Gpu::getFrame(uint32_t *out, bool gbaCrop) {
         // The DS draws the GBA screen by capturing it to alternating VRAM blocks and then displaying that
         // While not used officially, it's possible to copy images into VRAM before entering GBA mode to use as a border
         // Output the GBA frame, centered, with the current VRAM border around it
-        if (Settings::highRes3D || Settings::screenFilter == 1) {
+        if (core->config.highRes3D || core->config.screenFilter == 1) {
             // GBA doesn't have 3D, but draw the screen upscaled for consistency
             for (int y = 0; y < 192; y++) {
                 uint32_t *line = &out[offset * 4 + y * 256 * 4];
@@ -151,45 +139,22 @@ bool Gpu::getFrame(uint32_t *out, bool gbaCrop) {
     }
     else {
         // Output the full frame in RGB8 format
-        if (Settings::highRes3D || Settings::screenFilter == 1) {
+        if (core->config.highRes3D || core->config.screenFilter == 1) {
             if (buffers.hiRes3D) {
                 // Draw the screens upscaled, replacing any 3D pixels with high-res output
-                for (int y = 0; y < 192 * 2; y++) {
-                    for (int x = 0; x < 256; x++) {
-                        uint32_t value = buffers.framebuffer[y * 256 + x];
-                        int i = (y * 2) * (256 * 2) + (x * 2);
-                        if (value & BIT(26)) { // 3D
-                            uint32_t value2 = buffers.hiRes3D[(i + 0) % (256 * 192 * 4)];
-                            out[i + 0] = rgb6ToRgb8((value2 & 0xFC0000) ? value2 : value);
-                            value2 = buffers.hiRes3D[(i + 1) % (256 * 192 * 4)];
-                            out[i + 1] = rgb6ToRgb8((value2 & 0xFC0000) ? value2 : value);
-                            value2 = buffers.hiRes3D[(i + 512) % (256 * 192 * 4)];
-                            out[i + 512] = rgb6ToRgb8((value2 & 0xFC0000) ? value2 : value);
-                            value2 = buffers.hiRes3D[(i + 513) % (256 * 192 * 4)];
-                            out[i + 513] = rgb6ToRgb8((value2 & 0xFC0000) ? value2 : value);
-                        }
-                        else {
-                            uint32_t color = rgb6ToRgb8(value);
-                            out[i + 0] = out[i + 1] = color;
-                            out[i + 512] = out[i + 513] = color;
-                        }
-                    }
-                }
+                // The high-res buffer only covers one screen, so both screens read from the same lines
+                for (int y = 0; y < 192 * 2; y++)
+                    GpuSimd::merge3D(&buffers.framebuffer[y * 256], &buffers.hiRes3D[(y % 192) * 256 * 4], &out[y * 256 * 4], 256);
             }
             else {
                 // Even when 3D isn't enabled, draw the screens upscaled for consistency
-                for (int y = 0; y < 192 * 2; y++) {
-                    uint32_t *line = &out[y * 256 * 4];
-                    for (int x = 0; x < 256; x++)
-                        line[x * 2] = line[x * 2 + 1] = rgb6ToRgb8(buffers.framebuffer[y * 256 + x]);
-                    memcpy(&line[256 * 2], line, 256 * 8);
-                }
+                for (int y = 0; y < 192 * 2; y++)
+                    GpuSimd::rgb6ToRgb8x2(&buffers.framebuffer[y * 256], &out[y * 256 * 4], 256);
             }
         }
         else {
             // Draw to a native resolution buffer
-            for (int i = 0; i < 256 * 192 * 2; i++)
-                out[i] = rgb6ToRgb8(buffers.framebuffer[i]);
+            GpuSimd::rgb6ToRgb8(buffers.framebuffer, out, 256 * 192 * 2);
         }
     }
 
@@ -197,21 +162,15 @@ bool Gpu::getFrame(uint32_t *out, bool gbaCrop) {
     delete[] buffers.framebuffer;
     delete[] buffers.hiRes3D;
 
-    if (Settings::screenGhost) {
+    if (core->config.screenGhost) {
         // Get the size of the output framebuffer
         static uint32_t prev[256 * 192 * 8];
-        uint32_t width = (gbaCrop ? 240 : 256) << (Settings::highRes3D || Settings::screenFilter == 1);
-        uint32_t height = (gbaCrop ? 160 : (192 * 2)) << (Settings::highRes3D || Settings::screenFilter == 1);
+        uint32_t width = (gbaCrop ? 240 : 256) << (core->config.highRes3D || core->config.screenFilter == 1);
+        uint32_t height = (gbaCrop ? 160 : (192 * 2)) << (core->config.highRes3D || core->config.screenFilter == 1);
         uint32_t size = width * height;
 
         // Blend output with the previous frame if ghosting is enabled
-        for (uint32_t i = 0; i < size; i++) {
-            uint8_t r = (((prev[i] >> 0) & 0xFF) + ((out[i] >> 0) & 0xFF)) >> 1;
-            uint8_t g = (((prev[i] >> 8) & 0xFF) + ((out[i] >> 8) & 0xFF)) >> 1;
-            uint8_t b = (((prev[i] >> 16) & 0xFF) + ((out[i] >> 16) & 0xFF)) >> 1;
-            prev[i] = out[i];
-            out[i] = 0xFF000000 | (b << 16) | (g << 8) | r;
-        }
+        GpuSimd::blendGhost(out, prev, size);
     }
 
     // Remove the frame from the queue
@@ -222,17 +181,38 @@ bool Gpu::getFrame(uint32_t *out, bool gbaCrop) {
     return true;
 }
 
+void Gpu::countFrame() {
+    // Skip frames based on the frameskip setting, or the interval tuned by turbo mode if larger
+    int skip = std::max(core->config.frameskip, core->turbo.getInterval() - 1);
+    if (frames++ >= skip)
+        frames = 0;
+
+    // In turbo mode, also skip frames that would be dropped because the queue is full
+    // Frames with or right after a display capture are always drawn though, so captured data doesn't go stale
+    if (core->turbo.isActive()) {
+        if (captured || (dispCapCnt & BIT(31)))
+            frames = 0;
+        else if (frames == 0 && framebuffers.size() >= 2)
+            frames = 1;
+    }
+    captured = false;
+}
+
 void Gpu::gbaScanline240() {
     if (vCount < 160) {
+        core->perfTimers.enter(PERF_GPU2D);
         if (thread) {
             // Wait for the thread to finish the scanline
+            core->tracer.begin("2D wait", TRACK_EMU, vCount);
             while (drawing.load() != 0)
                 std::this_thread::yield();
+            core->tracer.end();
         }
         else if (frames == 0) {
             // Draw the current scanline
             core->gpu2D[0].drawGbaScanline(vCount);
         }
+        core->perfTimers.leave();
 
         // Trigger H-blank DMA transfers for visible scanlines
         core->dma[1].trigger(2);
@@ -287,10 +267,13 @@ void Gpu::gbaScanline308() {
             ready.store(true);
             mutex.unlock();
         }
+        else if (frames == 0) {
+            // Count frames that were drawn but dropped because the queue was full
+            core->metrics.droppedFrames++;
+        }
 
         // Update the frame count to skip frames when non-zero
-        if (frames++ >= Settings::frameskip)
-            frames = 0;
+        countFrame();
 
         // Stop execution here in case the frontend needs to do things
         core->endFrame();
@@ -306,8 +289,8 @@ void Gpu::gbaScanline308() {
         vCount = 0;
         core->gpu2D[0].reloadRegisters();
 
-        // Start the 2D thread if enabled
-        if (Settings::threaded2D && frames == 0 && !thread) {
+        // Start the 2D thread if enabled, unless the core shares a work pool with others
+        if (core->config.threaded2D && frames == 0 && !thread && !core->workPool) {
             running.store(true);
             thread = new std::thread(&Gpu::drawGbaThreaded, this);
         }
@@ -341,8 +324,10 @@ void Gpu::gbaScanline308() {
 
 void Gpu::scanline256() {
     if (vCount < 192) {
+        core->perfTimers.enter(PERF_GPU2D);
         if (thread) {
             // Make sure the thread has started before changing the state
+            core->tracer.begin("2D wait", TRACK_EMU, vCount);
             while (drawing.load() == 1)
                 std::this_thread::yield();
 
@@ -357,12 +342,14 @@ void Gpu::scanline256() {
                     std::this_thread::yield();
                 break;
             }
+            core->tracer.end();
         }
         else if (frames == 0) {
             // Draw the current scanlines
             core->gpu2D[0].drawScanline(vCount);
             core->gpu2D[1].drawScanline(vCount);
         }
+        core->perfTimers.leave();
 
         // Trigger H-blank DMA transfers for visible scanlines (ARM9 only)
         core->dma[0].trigger(2);
@@ -373,6 +360,8 @@ void Gpu::scanline256() {
 
         // Perform a display capture
         if (displayCapture) {
+            captured = true;
+
             // Determine the capture size
             static const uint16_t sizes[] = { 128, 128, 256, 64, 256, 128, 256, 192 };
             const uint16_t *size = &sizes[(dispCapCnt >> 19) & 0x6];
@@ -389,7 +378,7 @@ void Gpu::scanline256() {
                 // Choose from 2D engine A or the 3D engine
                 // In high-res mode, skip every other pixel when capturing 3D
                 uint32_t *source = (dispCapCnt & BIT(24)) ? core->gpu3DRenderer.getLine(vCount) : core->gpu2D[0].getRawLine();
-                bool resShift = (Settings::highRes3D && (dispCapCnt & BIT(24)));
+                bool resShift = (core->config.highRes3D && (dispCapCnt & BIT(24)));
 
                 // Copy a scanline to memory
                 for (int i = 0; i < width; i++)
@@ -423,7 +412,7 @@ void Gpu::scanline256() {
                 // Choose from 2D engine A or the 3D engine
                 // In high-res mode, skip every other pixel when capturing 3D
                 uint32_t *source = (dispCapCnt & BIT(24)) ? core->gpu3DRenderer.getLine(vCount) : core->gpu2D[0].getRawLine();
-                bool resShift = (Settings::highRes3D && (dispCapCnt & BIT(24)));
+                bool resShift = (core->config.highRes3D && (dispCapCnt & BIT(24)));
 
                 // Get the VRAM source address for the current scanline
                 uint32_t readOffset = ((dispCapCnt & 0x0C000000) >> 11) + vCount * width * 2;
@@ -462,7 +451,9 @@ void Gpu::scanline256() {
     // Bit 0 of the dirty variable represents invalidation, and bit 1 represents a frame currently drawing
     if (frames == 0 && dirty3D && (core->gpu2D[0].readDispCnt() & BIT(3)) && ((vCount + 48) % 263) < 192) {
         if (vCount == 215) dirty3D = BIT(1);
+        core->perfTimers.enter(PERF_RASTER);
         core->gpu3DRenderer.drawScanline((vCount + 48) % 263);
+        core->perfTimers.leave();
         if (vCount == 143) dirty3D &= ~BIT(1);
     }
 
@@ -504,8 +495,11 @@ void Gpu::scanline355() {
         }
 
         // Swap the buffers of the 3D engine if needed
-        if (core->gpu3D.shouldSwap())
+        if (core->gpu3D.shouldSwap()) {
+            core->perfTimers.enter(PERF_GEOMETRY);
             core->gpu3D.swapBuffers();
+            core->perfTimers.leave();
+        }
 
         // Allow up to 2 framebuffers to be queued, to preserve frame pacing if emulation runs ahead
         if (frames == 0 && framebuffers.size() < 2) {
@@ -527,7 +521,7 @@ void Gpu::scanline355() {
             }
 
             // Copy the upscaled 3D output to a new buffer if enabled
-            if (Settings::highRes3D && (core->gpu2D[0].readDispCnt() & BIT(3))) {
+            if (core->config.highRes3D && (core->gpu2D[0].readDispCnt() & BIT(3))) {
                 buffers.hiRes3D = new uint32_t[256 * 192 * 4];
                 memcpy(buffers.hiRes3D, core->gpu3DRenderer.getLine(0), 256 * 192 * 4 * sizeof(uint32_t));
                 buffers.top3D = (powCnt1 & BIT(15));
@@ -539,10 +533,13 @@ void Gpu::scanline355() {
             ready.store(true);
             mutex.unlock();
         }
+        else if (frames == 0) {
+            // Count frames that were drawn but dropped because the queue was full
+            core->metrics.droppedFrames++;
+        }
 
         // Update the frame count to skip frames when non-zero
-        if (frames++ >= Settings::frameskip)
-            frames = 0;
+        countFrame();
 
         // Apply cheats and stop execution in case the frontend needs to do things
         core->actionReplay.applyCheats();
@@ -561,8 +558,8 @@ void Gpu::scanline355() {
         core->gpu2D[0].reloadRegisters();
         core->gpu2D[1].reloadRegisters();
 
-        // Start the 2D thread if enabled
-        if (Settings::threaded2D && frames == 0 && !thread) {
+        // Start the 2D thread if enabled, unless the core shares a work pool with others
+        if (core->config.threaded2D && frames == 0 && !thread && !core->workPool) {
             running.store(true);
             thread = new std::thread(&Gpu::drawThreaded, this);
         }
@@ -609,7 +606,9 @@ void Gpu::drawGbaThreaded() {
         }
 
         // Draw the current scanline
+        core->tracer.begin("2D scanline", TRACK_GPU2D, vCount);
         core->gpu2D[0].drawGbaScanline(vCount);
+        core->tracer.end(TRACK_GPU2D);
 
         // Signal that the scanline is finished
         drawing.store(0);
@@ -625,12 +624,14 @@ void Gpu::drawThreaded() {
         }
 
         // Draw engine A's scanline
+        core->tracer.begin("2D scanline", TRACK_GPU2D, vCount);
         drawing.store(2);
         core->gpu2D[0].drawScanline(vCount);
 
         // Draw engine B's scanline if it hasn't started yet
         if (drawing.exchange(3) == 2)
             core->gpu2D[1].drawScanline(vCount);
+        core->tracer.end(TRACK_GPU2D);
 
         // Signal that the scanlines are finished
         drawing.store(0);
@@ -647,6 +648,26 @@ void Gpu::writeDispCapCnt(uint32_t mask, uint32_t value) {
     // Write to the DISPCAPCNT register
     mask &= 0xEF3F1F1F;
     dispCapCnt = (dispCapCnt & ~mask) | (value & mask);
+
+    // Draw the next frame after all if a capture is requested during V-blank of a frame turbo mode skipped
+    if ((dispCapCnt & BIT(31)) && frames != 0 && vCount >= 192 && core->turbo.isActive())
+        unskipFrame();
+}
+
+void Gpu::unskipFrame() {
+    // Mark the next frame to be drawn
+    frames = 0;
+    if (!dirty3D || !(core->gpu2D[0].readDispCnt() & BIT(3)))
+        return;
+
+    // Catch up on 3D scanlines that would have been drawn in advance, up to the last H-blank that ran
+    int last = vCount - !(dispStat[0] & BIT(1));
+    if (last < 215) return;
+    dirty3D = BIT(1);
+    core->perfTimers.enter(PERF_RASTER);
+    for (int i = 215; i <= last; i++)
+        core->gpu3DRenderer.drawScanline(i + 48 - 263);
+    core->perfTimers.leave();
 }
 
 void Gpu::writePowCnt1(uint16_t mask, uint16_t value) {
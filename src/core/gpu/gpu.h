@@ -28,6 +28,7 @@
 #include "../defines.h"
 
 class Core;
+class StateBuffer;
 
 class Gpu {
 public:
@@ -35,8 +36,8 @@ public:
     ~Gpu();
 
     void init();
-    void saveState(FILE *file);
-    void loadState(FILE *file);
+    void saveState(StateBuffer *buffer);
+    void loadState(StateBuffer *buffer);
 
     bool getFrame(uint32_t *out, bool gbaCrop);
     void invalidate3D() { dirty3D |= BIT(0); }
@@ -75,6 +76,7 @@ private:
     int frames = 0;
     bool gbaBlock = true;
     bool displayCapture = false;
+    bool captured = false;
     uint8_t dirty3D = 0;
 
     uint16_t dispStat[2] = {};
@@ -83,9 +85,10 @@ private:
     uint16_t powCnt1 = 0;
 
     static uint32_t rgb5ToRgb8(uint32_t color);
-    static uint32_t rgb6ToRgb8(uint32_t color);
     static uint16_t rgb6ToRgb5(uint32_t color);
 
+    void countFrame();
+    void unskipFrame();
     void drawGbaThreaded();
     void drawThreaded();
 };
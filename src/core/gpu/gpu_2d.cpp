@@ -29,58 +29,58 @@ Gpu2D::Gpu2D(Core *core, bool engine): core(core), engine(engine) {
     extPalettes = engine ? core->memory.engBExtPal : core->memory.engAExtPal;
 }
 
-void Gpu2D::saveState(FILE *file) {
-    // Write state data to the file
-    fwrite(winHFlip, sizeof(bool), sizeof(winHFlip) / sizeof(bool), file);
-    fwrite(winVFlag, sizeof(bool), sizeof(winVFlag) / sizeof(bool), file);
-    fwrite(&dispCnt, sizeof(dispCnt), 1, file);
-    fwrite(bgCnt, 2, sizeof(bgCnt) / 2, file);
-    fwrite(bgHOfs, 2, sizeof(bgHOfs) / 2, file);
-    fwrite(bgVOfs, 2, sizeof(bgVOfs) / 2, file);
-    fwrite(bgPA, 2, sizeof(bgPA) / 2, file);
-    fwrite(bgPB, 2, sizeof(bgPB) / 2, file);
-    fwrite(bgPC, 2, sizeof(bgPC) / 2, file);
-    fwrite(bgPD, 2, sizeof(bgPD) / 2, file);
-    fwrite(bgX, 4, sizeof(bgX) / 4, file);
-    fwrite(bgY, 4, sizeof(bgY) / 4, file);
-    fwrite(winX1, 2, sizeof(winX1) / 2, file);
-    fwrite(winX2, 2, sizeof(winX2) / 2, file);
-    fwrite(winY1, 2, sizeof(winY1) / 2, file);
-    fwrite(winY2, 2, sizeof(winY2) / 2, file);
-    fwrite(&winIn, sizeof(winIn), 1, file);
-    fwrite(&winOut, sizeof(winOut), 1, file);
-    fwrite(&bldCnt, sizeof(bldCnt), 1, file);
-    fwrite(&mosaic, sizeof(mosaic), 1, file);
-    fwrite(&bldAlpha, sizeof(bldAlpha), 1, file);
-    fwrite(&bldY, sizeof(bldY), 1, file);
-    fwrite(&masterBright, sizeof(masterBright), 1, file);
+void Gpu2D::saveState(StateBuffer *buffer) {
+    // Write state data to the buffer
+    buffer->write(winHFlip, sizeof(bool), sizeof(winHFlip) / sizeof(bool));
+    buffer->write(winVFlag, sizeof(bool), sizeof(winVFlag) / sizeof(bool));
+    buffer->write(&dispCnt, sizeof(dispCnt), 1);
+    buffer->write(bgCnt, 2, sizeof(bgCnt) / 2);
+    buffer->write(bgHOfs, 2, sizeof(bgHOfs) / 2);
+    buffer->write(bgVOfs, 2, sizeof(bgVOfs) / 2);
+    buffer->write(bgPA, 2, sizeof(bgPA) / 2);
+    buffer->write(bgPB, 2, sizeof(bgPB) / 2);
+    buffer->write(bgPC, 2, sizeof(bgPC) / 2);
+    buffer->write(bgPD, 2, sizeof(bgPD) / 2);
+    buffer->write(bgX, 4, sizeof(bgX) / 4);
+    buffer->write(bgY, 4, sizeof(bgY) / 4);
+    buffer->write(winX1, 2, sizeof(winX1) / 2);
+    buffer->write(winX2, 2, sizeof(winX2) / 2);
+    buffer->write(winY1, 2, sizeof(winY1) / 2);
+    buffer->write(winY2, 2, sizeof(winY2) / 2);
+    buffer->write(&winIn, sizeof(winIn), 1);
+    buffer->write(&winOut, sizeof(winOut), 1);
+    buffer->write(&bldCnt, sizeof(bldCnt), 1);
+    buffer->write(&mosaic, sizeof(mosaic), 1);
+    buffer->write(&bldAlpha, sizeof(bldAlpha), 1);
+    buffer->write(&bldY, sizeof(bldY), 1);
+    buffer->write(&masterBright, sizeof(masterBright), 1);
 }
 
-void Gpu2D::loadState(FILE *file) {
-    // Read state data from the file
-    fread(winHFlip, sizeof(bool), sizeof(winHFlip) / sizeof(bool), file);
-    fread(winVFlag, sizeof(bool), sizeof(winVFlag) / sizeof(bool), file);
-    fread(&dispCnt, sizeof(dispCnt), 1, file);
-    fread(bgCnt, 2, sizeof(bgCnt) / 2, file);
-    fread(bgHOfs, 2, sizeof(bgHOfs) / 2, file);
-    fread(bgVOfs, 2, sizeof(bgVOfs) / 2, file);
-    fread(bgPA, 2, sizeof(bgPA) / 2, file);
-    fread(bgPB, 2, sizeof(bgPB) / 2, file);
-    fread(bgPC, 2, sizeof(bgPC) / 2, file);
-    fread(bgPD, 2, sizeof(bgPD) / 2, file);
-    fread(bgX, 4, sizeof(bgX) / 4, file);
-    fread(bgY, 4, sizeof(bgY) / 4, file);
-    fread(winX1, 2, sizeof(winX1) / 2, file);
-    fread(winX2, 2, sizeof(winX2) / 2, file);
-    fread(winY1, 2, sizeof(winY1) / 2, file);
-    fread(winY2, 2, sizeof(winY2) / 2, file);
-    fread(&winIn, sizeof(winIn), 1, file);
-    fread(&winOut, sizeof(winOut), 1, file);
-    fread(&bldCnt, sizeof(bldCnt), 1, file);
-    fread(&mosaic, sizeof(mosaic), 1, file);
-    fread(&bldAlpha, sizeof(bldAlpha), 1, file);
-    fread(&bldY, sizeof(bldY), 1, file);
-    fread(&masterBright, sizeof(masterBright), 1, file);
+void Gpu2D::loadState(StateBuffer *buffer) {
+    // Read state data from the buffer
+    buffer->read(winHFlip, sizeof(bool), sizeof(winHFlip) / sizeof(bool));
+    buffer->read(winVFlag, sizeof(bool), sizeof(winVFlag) / sizeof(bool));
+    buffer->read(&dispCnt, sizeof(dispCnt), 1);
+    buffer->read(bgCnt, 2, sizeof(bgCnt) / 2);
+    buffer->read(bgHOfs, 2, sizeof(bgHOfs) / 2);
+    buffer->read(bgVOfs, 2, sizeof(bgVOfs) / 2);
+    buffer->read(bgPA, 2, sizeof(bgPA) / 2);
+    buffer->read(bgPB, 2, sizeof(bgPB) / 2);
+    buffer->read(bgPC, 2, sizeof(bgPC) / 2);
+    buffer->read(bgPD, 2, sizeof(bgPD) / 2);
+    buffer->read(bgX, 4, sizeof(bgX) / 4);
+    buffer->read(bgY, 4, sizeof(bgY) / 4);
+    buffer->read(winX1, 2, sizeof(winX1) / 2);
+    buffer->read(winX2, 2, sizeof(winX2) / 2);
+    buffer->read(winY1, 2, sizeof(winY1) / 2);
+    buffer->read(winY2, 2, sizeof(winY2) / 2);
+    buffer->read(&winIn, sizeof(winIn), 1);
+    buffer->read(&winOut, sizeof(winOut), 1);
+    buffer->read(&bldCnt, sizeof(bldCnt), 1);
+    buffer->read(&mosaic, sizeof(mosaic), 1);
+    buffer->read(&bldAlpha, sizeof(bldAlpha), 1);
+    buffer->read(&bldY, sizeof(bldY), 1);
+    buffer->read(&masterBright, sizeof(masterBright), 1);
 }
 
 uint32_t Gpu2D::rgb5ToRgb6(uint32_t color) {
@@ -487,7 +487,7 @@ template <bool gbaMode> void Gpu2D::drawText(int bg, int line) {
     if (!gbaMode && bg == 0 && (dispCnt & BIT(3))) {
         // In high-res 3D mode, skip every other pixel
         uint32_t *data = core->gpu3DRenderer.getLine(line);
-        bool resShift = Settings::highRes3D;
+        bool resShift = core->config.highRes3D;
 
         // Draw a scanline of 3D pixels
         for (int i = 0; i < 256; i++)
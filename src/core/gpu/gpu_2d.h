@@ -23,12 +23,13 @@
 #include <cstdio>
 
 class Core;
+class StateBuffer;
 
 class Gpu2D {
 public:
     Gpu2D(Core *core, bool engine);
-    void saveState(FILE *file);
-    void loadState(FILE *file);
+    void saveState(StateBuffer *buffer);
+    void loadState(StateBuffer *buffer);
 
     void reloadRegisters();
     void updateWindows(int line);
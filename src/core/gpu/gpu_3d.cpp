@@ -65,118 +65,118 @@ const uint8_t Gpu3D::paramCounts[] = {
     3, 2, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 0x70-0x7F
 };
 
-void Gpu3D::saveState(FILE *file) {
-    // Write state data to the file
-    fwrite(&state, sizeof(state), 1, file);
-    fwrite(&pipeSize, sizeof(pipeSize), 1, file);
-    fwrite(&testQueue, sizeof(testQueue), 1, file);
-    fwrite(&matrixQueue, sizeof(matrixQueue), 1, file);
-    fwrite(&matrixMode, sizeof(matrixMode), 1, file);
-    fwrite(&clipDirty, sizeof(clipDirty), 1, file);
-    fwrite(&projection, sizeof(projection), 1, file);
-    fwrite(&projectionStack, sizeof(projectionStack), 1, file);
-    fwrite(&coordinate, sizeof(coordinate), 1, file);
-    fwrite(coordinateStack, sizeof(Matrix), sizeof(coordinateStack) / sizeof(Matrix), file);
-    fwrite(&direction, sizeof(direction), 1, file);
-    fwrite(directionStack, sizeof(Matrix), sizeof(coordinateStack) / sizeof(Matrix), file);
-    fwrite(&texture, sizeof(texture), 1, file);
-    fwrite(&textureStack, sizeof(textureStack), 1, file);
-    fwrite(&clip, sizeof(clip), 1, file);
-    fwrite(verticesIn, sizeof(Vertex), sizeof(vertices1) / sizeof(Vertex), file);
-    fwrite(verticesOut, sizeof(Vertex), sizeof(vertices2) / sizeof(Vertex), file);
-    fwrite(&vertexCountIn, sizeof(vertexCountIn), 1, file);
-    fwrite(&vertexCountOut, sizeof(vertexCountOut), 1, file);
-    fwrite(&processCount, sizeof(processCount), 1, file);
-    fwrite(polygonsIn, sizeof(_Polygon), sizeof(polygons1) / sizeof(_Polygon), file);
-    fwrite(polygonsOut, sizeof(_Polygon), sizeof(polygons2) / sizeof(_Polygon), file);
-    fwrite(&polygonCountIn, sizeof(polygonCountIn), 1, file);
-    fwrite(&polygonCountOut, sizeof(polygonCountOut), 1, file);
-    fwrite(&savedVertex, sizeof(savedVertex), 1, file);
-    fwrite(&savedPolygon, sizeof(savedPolygon), 1, file);
-    fwrite(&s, sizeof(s), 1, file);
-    fwrite(&t, sizeof(t), 1, file);
-    fwrite(&vertexCount, sizeof(vertexCount), 1, file);
-    fwrite(&clockwise, sizeof(clockwise), 1, file);
-    fwrite(&polygonType, sizeof(polygonType), 1, file);
-    fwrite(&textureCoordMode, sizeof(textureCoordMode), 1, file);
-    fwrite(&polygonAttr, sizeof(polygonAttr), 1, file);
-    fwrite(&enabledLights, sizeof(enabledLights), 1, file);
-    fwrite(&renderBack, sizeof(renderBack), 1, file);
-    fwrite(&renderFront, sizeof(renderFront), 1, file);
-    fwrite(&diffuseColor, sizeof(diffuseColor), 1, file);
-    fwrite(&ambientColor, sizeof(ambientColor), 1, file);
-    fwrite(&specularColor, sizeof(specularColor), 1, file);
-    fwrite(&emissionColor, sizeof(emissionColor), 1, file);
-    fwrite(&shininessEnabled, sizeof(shininessEnabled), 1, file);
-    fwrite(lightVector, sizeof(Vector), sizeof(lightVector) / sizeof(Vector), file);
-    fwrite(halfVector, sizeof(Vector), sizeof(halfVector) / sizeof(Vector), file);
-    fwrite(lightColor, 4, sizeof(lightColor) / 4, file);
-    fwrite(shininess, 1, sizeof(shininess), file);
-    fwrite(viewport, 2, sizeof(viewport) / 2, file);
-    fwrite(viewportNext, 2, sizeof(viewportNext) / 2, file);
-    fwrite(&gxFifo, sizeof(gxFifo), 1, file);
-    fwrite(&gxStat, sizeof(gxStat), 1, file);
-    fwrite(posResult, 4, sizeof(posResult) / 4, file);
-    fwrite(vecResult, 2, sizeof(vecResult) / 2, file);
-    fwrite(&gxFifoCount, sizeof(gxFifoCount), 1, file);
-    SaveStates::writeFifo(fifo, file);
-}
-
-void Gpu3D::loadState(FILE *file) {
-    // Read state data from the file
-    fread(&state, sizeof(state), 1, file);
-    fread(&pipeSize, sizeof(pipeSize), 1, file);
-    fread(&testQueue, sizeof(testQueue), 1, file);
-    fread(&matrixQueue, sizeof(matrixQueue), 1, file);
-    fread(&matrixMode, sizeof(matrixMode), 1, file);
-    fread(&clipDirty, sizeof(clipDirty), 1, file);
-    fread(&projection, sizeof(projection), 1, file);
-    fread(&projectionStack, sizeof(projectionStack), 1, file);
-    fread(&coordinate, sizeof(coordinate), 1, file);
-    fread(coordinateStack, sizeof(Matrix), sizeof(coordinateStack) / sizeof(Matrix), file);
-    fread(&direction, sizeof(direction), 1, file);
-    fread(directionStack, sizeof(Matrix), sizeof(coordinateStack) / sizeof(Matrix), file);
-    fread(&texture, sizeof(texture), 1, file);
-    fread(&textureStack, sizeof(textureStack), 1, file);
-    fread(&clip, sizeof(clip), 1, file);
-    fread(vertices1, sizeof(Vertex), sizeof(vertices1) / sizeof(Vertex), file);
-    fread(vertices2, sizeof(Vertex), sizeof(vertices2) / sizeof(Vertex), file);
-    fread(&vertexCountIn, sizeof(vertexCountIn), 1, file);
-    fread(&vertexCountOut, sizeof(vertexCountOut), 1, file);
-    fread(&processCount, sizeof(processCount), 1, file);
-    fread(polygons1, sizeof(_Polygon), sizeof(polygons1) / sizeof(_Polygon), file);
-    fread(polygons2, sizeof(_Polygon), sizeof(polygons2) / sizeof(_Polygon), file);
-    fread(&polygonCountIn, sizeof(polygonCountIn), 1, file);
-    fread(&polygonCountOut, sizeof(polygonCountOut), 1, file);
-    fread(&savedVertex, sizeof(savedVertex), 1, file);
-    fread(&savedPolygon, sizeof(savedPolygon), 1, file);
-    fread(&s, sizeof(s), 1, file);
-    fread(&t, sizeof(t), 1, file);
-    fread(&vertexCount, sizeof(vertexCount), 1, file);
-    fread(&clockwise, sizeof(clockwise), 1, file);
-    fread(&polygonType, sizeof(polygonType), 1, file);
-    fread(&textureCoordMode, sizeof(textureCoordMode), 1, file);
-    fread(&polygonAttr, sizeof(polygonAttr), 1, file);
-    fread(&enabledLights, sizeof(enabledLights), 1, file);
-    fread(&renderBack, sizeof(renderBack), 1, file);
-    fread(&renderFront, sizeof(renderFront), 1, file);
-    fread(&diffuseColor, sizeof(diffuseColor), 1, file);
-    fread(&ambientColor, sizeof(ambientColor), 1, file);
-    fread(&specularColor, sizeof(specularColor), 1, file);
-    fread(&emissionColor, sizeof(emissionColor), 1, file);
-    fread(&shininessEnabled, sizeof(shininessEnabled), 1, file);
-    fread(lightVector, sizeof(Vector), sizeof(lightVector) / sizeof(Vector), file);
-    fread(halfVector, sizeof(Vector), sizeof(halfVector) / sizeof(Vector), file);
-    fread(lightColor, 4, sizeof(lightColor) / 4, file);
-    fread(shininess, 1, sizeof(shininess), file);
-    fread(viewport, 2, sizeof(viewport) / 2, file);
-    fread(viewportNext, 2, sizeof(viewportNext) / 2, file);
-    fread(&gxFifo, sizeof(gxFifo), 1, file);
-    fread(&gxStat, sizeof(gxStat), 1, file);
-    fread(posResult, 4, sizeof(posResult) / 4, file);
-    fread(vecResult, 2, sizeof(vecResult) / 2, file);
-    fread(&gxFifoCount, sizeof(gxFifoCount), 1, file);
-    SaveStates::readFifo(fifo, file);
+void Gpu3D::saveState(StateBuffer *buffer) {
+    // Write state data to the buffer
+    buffer->write(&state, sizeof(state), 1);
+    buffer->write(&pipeSize, sizeof(pipeSize), 1);
+    buffer->write(&testQueue, sizeof(testQueue), 1);
+    buffer->write(&matrixQueue, sizeof(matrixQueue), 1);
+    buffer->write(&matrixMode, sizeof(matrixMode), 1);
+    buffer->write(&clipDirty, sizeof(clipDirty), 1);
+    buffer->write(&projection, sizeof(projection), 1);
+    buffer->write(&projectionStack, sizeof(projectionStack), 1);
+    buffer->write(&coordinate, sizeof(coordinate), 1);
+    buffer->write(coordinateStack, sizeof(Matrix), sizeof(coordinateStack) / sizeof(Matrix));
+    buffer->write(&direction, sizeof(direction), 1);
+    buffer->write(directionStack, sizeof(Matrix), sizeof(coordinateStack) / sizeof(Matrix));
+    buffer->write(&texture, sizeof(texture), 1);
+    buffer->write(&textureStack, sizeof(textureStack), 1);
+    buffer->write(&clip, sizeof(clip), 1);
+    buffer->write(verticesIn, sizeof(Vertex), sizeof(vertices1) / sizeof(Vertex));
+    buffer->write(verticesOut, sizeof(Vertex), sizeof(vertices2) / sizeof(Vertex));
+    buffer->write(&vertexCountIn, sizeof(vertexCountIn), 1);
+    buffer->write(&vertexCountOut, sizeof(vertexCountOut), 1);
+    buffer->write(&processCount, sizeof(processCount), 1);
+    buffer->write(polygonsIn, sizeof(_Polygon), sizeof(polygons1) / sizeof(_Polygon));
+    buffer->write(polygonsOut, sizeof(_Polygon), sizeof(polygons2) / sizeof(_Polygon));
+    buffer->write(&polygonCountIn, sizeof(polygonCountIn), 1);
+    buffer->write(&polygonCountOut, sizeof(polygonCountOut), 1);
+    buffer->write(&savedVertex, sizeof(savedVertex), 1);
+    buffer->write(&savedPolygon, sizeof(savedPolygon), 1);
+    buffer->write(&s, sizeof(s), 1);
+    buffer->write(&t, sizeof(t), 1);
+    buffer->write(&vertexCount, sizeof(vertexCount), 1);
+    buffer->write(&clockwise, sizeof(clockwise), 1);
+    buffer->write(&polygonType, sizeof(polygonType), 1);
+    buffer->write(&textureCoordMode, sizeof(textureCoordMode), 1);
+    buffer->write(&polygonAttr, sizeof(polygonAttr), 1);
+    buffer->write(&enabledLights, sizeof(enabledLights), 1);
+    buffer->write(&renderBack, sizeof(renderBack), 1);
+    buffer->write(&renderFront, sizeof(renderFront), 1);
+    buffer->write(&diffuseColor, sizeof(diffuseColor), 1);
+    buffer->write(&ambientColor, sizeof(ambientColor), 1);
+    buffer->write(&specularColor, sizeof(specularColor), 1);
+    buffer->write(&emissionColor, sizeof(emissionColor), 1);
+    buffer->write(&shininessEnabled, sizeof(shininessEnabled), 1);
+    buffer->write(lightVector, sizeof(Vector), sizeof(lightVector) / sizeof(Vector));
+    buffer->write(halfVector, sizeof(Vector), sizeof(halfVector) / sizeof(Vector));
+    buffer->write(lightColor, 4, sizeof(lightColor) / 4);
+    buffer->write(shininess, 1, sizeof(shininess));
+    buffer->write(viewport, 2, sizeof(viewport) / 2);
+    buffer->write(viewportNext, 2, sizeof(viewportNext) / 2);
+    buffer->write(&gxFifo, sizeof(gxFifo), 1);
+    buffer->write(&gxStat, sizeof(gxStat), 1);
+    buffer->write(posResult, 4, sizeof(posResult) / 4);
+    buffer->write(vecResult, 2, sizeof(vecResult) / 2);
+    buffer->write(&gxFifoCount, sizeof(gxFifoCount), 1);
+    SaveStates::writeFifo(fifo, buffer);
+}
+
+void Gpu3D::loadState(StateBuffer *buffer) {
+    // Read state data from the buffer
+    buffer->read(&state, sizeof(state), 1);
+    buffer->read(&pipeSize, sizeof(pipeSize), 1);
+    buffer->read(&testQueue, sizeof(testQueue), 1);
+    buffer->read(&matrixQueue, sizeof(matrixQueue), 1);
+    buffer->read(&matrixMode, sizeof(matrixMode), 1);
+    buffer->read(&clipDirty, sizeof(clipDirty), 1);
+    buffer->read(&projection, sizeof(projection), 1);
+    buffer->read(&projectionStack, sizeof(projectionStack), 1);
+    buffer->read(&coordinate, sizeof(coordinate), 1);
+    buffer->read(coordinateStack, sizeof(Matrix), sizeof(coordinateStack) / sizeof(Matrix));
+    buffer->read(&direction, sizeof(direction), 1);
+    buffer->read(directionStack, sizeof(Matrix), sizeof(coordinateStack) / sizeof(Matrix));
+    buffer->read(&texture, sizeof(texture), 1);
+    buffer->read(&textureStack, sizeof(textureStack), 1);
+    buffer->read(&clip, sizeof(clip), 1);
+    buffer->read(vertices1, sizeof(Vertex), sizeof(vertices1) / sizeof(Vertex));
+    buffer->read(vertices2, sizeof(Vertex), sizeof(vertices2) / sizeof(Vertex));
+    buffer->read(&vertexCountIn, sizeof(vertexCountIn), 1);
+    buffer->read(&vertexCountOut, sizeof(vertexCountOut), 1);
+    buffer->read(&processCount, sizeof(processCount), 1);
+    buffer->read(polygons1, sizeof(_Polygon), sizeof(polygons1) / sizeof(_Polygon));
+    buffer->read(polygons2, sizeof(_Polygon), sizeof(polygons2) / sizeof(_Polygon));
+    buffer->read(&polygonCountIn, sizeof(polygonCountIn), 1);
+    buffer->read(&polygonCountOut, sizeof(polygonCountOut), 1);
+    buffer->read(&savedVertex, sizeof(savedVertex), 1);
+    buffer->read(&savedPolygon, sizeof(savedPolygon), 1);
+    buffer->read(&s, sizeof(s), 1);
+    buffer->read(&t, sizeof(t), 1);
+    buffer->read(&vertexCount, sizeof(vertexCount), 1);
+    buffer->read(&clockwise, sizeof(clockwise), 1);
+    buffer->read(&polygonType, sizeof(polygonType), 1);
+    buffer->read(&textureCoordMode, sizeof(textureCoordMode), 1);
+    buffer->read(&polygonAttr, sizeof(polygonAttr), 1);
+    buffer->read(&enabledLights, sizeof(enabledLights), 1);
+    buffer->read(&renderBack, sizeof(renderBack), 1);
+    buffer->read(&renderFront, sizeof(renderFront), 1);
+    buffer->read(&diffuseColor, sizeof(diffuseColor), 1);
+    buffer->read(&ambientColor, sizeof(ambientColor), 1);
+    buffer->read(&specularColor, sizeof(specularColor), 1);
+    buffer->read(&emissionColor, sizeof(emissionColor), 1);
+    buffer->read(&shininessEnabled, sizeof(shininessEnabled), 1);
+    buffer->read(lightVector, sizeof(Vector), sizeof(lightVector) / sizeof(Vector));
+    buffer->read(halfVector, sizeof(Vector), sizeof(halfVector) / sizeof(Vector));
+    buffer->read(lightColor, 4, sizeof(lightColor) / 4);
+    buffer->read(shininess, 1, sizeof(shininess));
+    buffer->read(viewport, 2, sizeof(viewport) / 2);
+    buffer->read(viewportNext, 2, sizeof(viewportNext) / 2);
+    buffer->read(&gxFifo, sizeof(gxFifo), 1);
+    buffer->read(&gxStat, sizeof(gxStat), 1);
+    buffer->read(posResult, 4, sizeof(posResult) / 4);
+    buffer->read(vecResult, 2, sizeof(vecResult) / 2);
+    buffer->read(&gxFifoCount, sizeof(gxFifoCount), 1);
+    SaveStates::readFifo(fifo, buffer);
 
     // Reset vertex and polygon buffers
     verticesIn = vertices1;
@@ -264,6 +264,7 @@ bool Gpu3D::clipPolygon(Vertex *unclipped, Vertex *clipped, uint8_t *size) {
 
 void Gpu3D::runCommands() {
     // Run a batch of geometry commands
+    core->perfTimers.enter(PERF_GEOMETRY);
     uint32_t cycles = 0;
     while (cycles < GPU3D_BATCH) {
         // Fetch the next geometry command
@@ -285,6 +286,7 @@ void Gpu3D::runCommands() {
         }
 
         // Execute the geometry command
+        core->metrics.gxCommands++;
         switch (entry.command) {
             case 0x10: mtxModeCmd(entry.param); break; // MTX_MODE
             case 0x11: mtxPushCmd(); break; // MTX_PUSH
@@ -370,11 +372,12 @@ void Gpu3D::runCommands() {
         else
             state = GX_IDLE;
     }
+    core->perfTimers.leave();
 }
 
 void Gpu3D::processVertices() {
     // Scale the viewport based on the high-res 3D setting
-    bool resShift = Settings::highRes3D;
+    bool resShift = core->config.highRes3D;
     uint16_t x = viewport[0] << resShift;
     uint16_t y = viewport[1] << resShift;
     uint16_t w = viewport[2] << resShift;
@@ -423,6 +426,10 @@ void Gpu3D::swapBuffers() {
                 p->wShift -= 4;
     }
 
+    // Count the finished geometry towards the frame metrics
+    core->metrics.polygons += polygonCountIn;
+    core->metrics.vertices += vertexCountIn;
+
     // Swap the vertex buffers
     SWAP(verticesOut, verticesIn);
     vertexCountOut = vertexCountIn;
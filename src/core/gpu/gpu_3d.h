@@ -26,6 +26,7 @@
 #include "../defines.h"
 
 class Core;
+class StateBuffer;
 
 enum GXState {
     GX_IDLE = 0,
@@ -98,8 +99,8 @@ public:
     uint16_t vertexCountOut = 0;
 
     Gpu3D(Core *core): core(core) {}
-    void saveState(FILE *file);
-    void loadState(FILE *file);
+    void saveState(StateBuffer *buffer);
+    void loadState(StateBuffer *buffer);
 
     void runCommands();
     void swapBuffers();
@@ -17,6 +17,7 @@
     along with NooDS. If not, see <https://www.gnu.org/licenses/>.
 */
 
+#include <algorithm>
 #include <cstring>
 #include <vector>
 
@@ -27,38 +28,42 @@ Gpu3DRenderer::Gpu3DRenderer(Core *core): core(core) {
     // This is mainly in case 3D is requested before the threads have a chance to start
     for (int i = 0; i < 192 * 2; i++)
         ready[i].store(3);
+    pixelsDrawn.store(0);
+    poolJobs.store(0);
+    nextLine.store(0);
 }
 
 Gpu3DRenderer::~Gpu3DRenderer() {
-    // Clean up the threads
+    // Clean up the threads, and wait for pool jobs since they reference the renderer
+    waitJobs();
     for (size_t i = 0; i < threads.size(); i++) {
         threads[i]->join();
         delete threads[i];
     }
 }
 
-void Gpu3DRenderer::saveState(FILE *file) {
-    // Write state data to the file
-    fwrite(&disp3DCnt, sizeof(disp3DCnt), 1, file);
-    fwrite(edgeColor, 2, sizeof(edgeColor) / 2, file);
-    fwrite(&clearColor, sizeof(clearColor), 1, file);
-    fwrite(&clearDepth, sizeof(clearDepth), 1, file);
-    fwrite(&fogColor, sizeof(fogColor), 1, file);
-    fwrite(&fogOffset, sizeof(fogOffset), 1, file);
-    fwrite(fogTable, 1, sizeof(fogTable), file);
-    fwrite(toonTable, 2, sizeof(toonTable) / 2, file);
+void Gpu3DRenderer::saveState(StateBuffer *buffer) {
+    // Write state data to the buffer
+    buffer->write(&disp3DCnt, sizeof(disp3DCnt), 1);
+    buffer->write(edgeColor, 2, sizeof(edgeColor) / 2);
+    buffer->write(&clearColor, sizeof(clearColor), 1);
+    buffer->write(&clearDepth, sizeof(clearDepth), 1);
+    buffer->write(&fogColor, sizeof(fogColor), 1);
+    buffer->write(&fogOffset, sizeof(fogOffset), 1);
+    buffer->write(fogTable, 1, sizeof(fogTable));
+    buffer->write(toonTable, 2, sizeof(toonTable) / 2);
 }
 
-void Gpu3DRenderer::loadState(FILE *file) {
-    // Read state data from the file
-    fread(&disp3DCnt, sizeof(disp3DCnt), 1, file);
-    fread(edgeColor, 2, sizeof(edgeColor) / 2, file);
-    fread(&clearColor, sizeof(clearColor), 1, file);
-    fread(&clearDepth, sizeof(clearDepth), 1, file);
-    fread(&fogColor, sizeof(fogColor), 1, file);
-    fread(&fogOffset, sizeof(fogOffset), 1, file);
-    fread(fogTable, 1, sizeof(fogTable), file);
-    fread(toonTable, 2, sizeof(toonTable) / 2, file);
+void Gpu3DRenderer::loadState(StateBuffer *buffer) {
+    // Read state data from the buffer
+    buffer->read(&disp3DCnt, sizeof(disp3DCnt), 1);
+    buffer->read(edgeColor, 2, sizeof(edgeColor) / 2);
+    buffer->read(&clearColor, sizeof(clearColor), 1);
+    buffer->read(&clearDepth, sizeof(clearDepth), 1);
+    buffer->read(&fogColor, sizeof(fogColor), 1);
+    buffer->read(&fogOffset, sizeof(fogOffset), 1);
+    buffer->read(fogTable, 1, sizeof(fogTable));
+    buffer->read(toonTable, 2, sizeof(toonTable) / 2);
 }
 
 uint32_t Gpu3DRenderer::rgba5ToRgba6(uint32_t color) {
@@ -72,16 +77,30 @@ uint32_t Gpu3DRenderer::rgba5ToRgba6(uint32_t color) {
 
 uint32_t *Gpu3DRenderer::getLine(int line) {
     // Get 2 lines when high-res is enabled, to ensure they're both finished
-    if (resShift) {
-        uint32_t *data = getLine1(line * 2);
-        getLine1(line * 2 + 1);
-        return data;
-    }
-
-    return getLine1(line);
+    core->perfTimers.enter(PERF_RASTER);
+    uint32_t *data = getLine1(line << resShift);
+    if (resShift) getLine1(line * 2 + 1);
+    core->perfTimers.leave();
+    return data;
 }
 
 uint32_t *Gpu3DRenderer::getLine1(int line) {
+    if (pooled) {
+        // Draw the scanline and its neighbors here if no job has started them, then finish it if needed
+        // Scanlines being drawn elsewhere never wait on anything, so this can't get stuck behind busy workers
+        if (ready[line].load() < 3) {
+            core->tracer.begin("3D wait", TRACK_EMU, line);
+            for (int i = std::max(line - 1, 0); i <= std::min(line + 1, (192 << resShift) - 1); i++)
+                claimLine(i);
+            while (ready[line].load() < 3) {
+                tryFinish(line);
+                std::this_thread::yield();
+            }
+            core->tracer.end();
+        }
+        return &framebuffer[0][line * 256 * 2];
+    }
+
     // If a thread is falling behind, see if this thread can help out instead of waiting around
     // Threads go back for the final pass after drawing their next scanline, so check 2 scanlines ahead
     if (ready[line].load() < 3 && line + activeThreads * 2 < (192 << resShift)) {
@@ -89,7 +108,9 @@ uint32_t *Gpu3DRenderer::getLine1(int line) {
         switch (ready[next].exchange(1)) {
         case 0:
             // Draw the scanline if it hasn't been started yet
+            core->tracer.begin("3D scanline", TRACK_EMU, next);
             drawScanline1(next);
+            core->tracer.end();
             ready[next].store(2);
             break;
 
@@ -107,7 +128,11 @@ uint32_t *Gpu3DRenderer::getLine1(int line) {
     }
 
     // Wait until a scanline is ready, and then return it
-    while (ready[line].load() < 3) std::this_thread::yield();
+    if (ready[line].load() < 3) {
+        core->tracer.begin("3D wait", TRACK_EMU, line);
+        while (ready[line].load() < 3) std::this_thread::yield();
+        core->tracer.end();
+    }
     return &framebuffer[0][line * 256 * 2];
 }
 
@@ -130,7 +155,7 @@ void Gpu3DRenderer::drawScanline(int line) {
         }
 
         // Update the resolution shift for the next frame
-        resShift = Settings::highRes3D;
+        resShift = core->config.highRes3D;
 
         // Clean up any existing threads
         for (size_t i = 0; i < threads.size(); i++) {
@@ -139,8 +164,26 @@ void Gpu3DRenderer::drawScanline(int line) {
         }
         threads.clear();
 
+        // Render with jobs on the core's work pool if it has one, using the thread count as the job count
+        waitJobs();
+        if ((pooled = (core->workPool != nullptr))) {
+            // Mark the scanlines as not ready
+            for (int i = 0; i < (192 << resShift); i++) {
+                ready[i].store(0);
+                finishing[i].store(false);
+            }
+
+            // Queue jobs that draw scanlines in order until none are left
+            int jobs = std::max(1, core->config.threaded3D & 0xF);
+            nextLine.store(0);
+            poolJobs.store(jobs);
+            for (int i = 0; i < jobs; i++)
+                core->workPool->submit(std::bind(&Gpu3DRenderer::drawPooled, this), true);
+            activeThreads = jobs;
+        }
+
         // Set up threaded 3D rendering if enabled
-        if ((activeThreads = Settings::threaded3D & 0xF)) {
+        else if ((activeThreads = core->config.threaded3D & 0xF)) {
             // Mark the scanlines as not ready
             for (int i = 0; i < (192 << resShift); i++)
                 ready[i].store(0);
@@ -170,6 +213,45 @@ void Gpu3DRenderer::drawScanline(int line) {
     }
 }
 
+void Gpu3DRenderer::drawPooled() {
+    // Draw the next unclaimed scanlines until the frame is covered
+    for (int i; (i = nextLine.fetch_add(1)) < (192 << resShift);)
+        claimLine(i);
+    poolJobs.fetch_sub(1);
+}
+
+bool Gpu3DRenderer::claimLine(int line) {
+    // Draw a scanline if nothing else has started it, and finish any scanlines this completes the neighbors of
+    int expected = 0;
+    if (!ready[line].compare_exchange_strong(expected, 1))
+        return false;
+    drawScanline1(line);
+    ready[line].store(2);
+    for (int i = std::max(line - 1, 0); i <= std::min(line + 1, (192 << resShift) - 1); i++)
+        tryFinish(i);
+    return true;
+}
+
+void Gpu3DRenderer::tryFinish(int line) {
+    // Finish a scanline once it and its neighbors are drawn, making sure only one thread does it
+    int last = (192 << resShift) - 1;
+    if ((line > 0 && ready[line - 1].load() < 2) || ready[line].load() < 2 || (line < last && ready[line + 1].load() < 2))
+        return;
+    if (finishing[line].exchange(true))
+        return;
+    finishScanline(line);
+    ready[line].store(3);
+}
+
+void Gpu3DRenderer::waitJobs() {
+    // Wait for the last frame's jobs to finish, running queued urgent jobs in the meantime
+    // This way, a job still waiting for a worker can't hold things up
+    while (poolJobs.load() > 0) {
+        if (!core->workPool->runUrgent())
+            std::this_thread::yield();
+    }
+}
+
 void Gpu3DRenderer::drawThreaded(int thread) {
     // Draw the 3D scanlines in a threaded sequence
     // The amount of scanlines skipped per thread depends on the number of active threads
@@ -179,7 +261,9 @@ void Gpu3DRenderer::drawThreaded(int thread) {
         switch (ready[i].exchange(1)) {
         case 0:
             // Draw a scanline if it hasn't been started, save for the final pass
+            core->tracer.begin("3D scanline", TRACK_GPU3D + thread, i);
             drawScanline1(i);
+            core->tracer.end(TRACK_GPU3D + thread);
             ready[i].store(2);
             break;
 
@@ -193,22 +277,30 @@ void Gpu3DRenderer::drawThreaded(int thread) {
         int prev = i - activeThreads;
 
         // Wait for this thread's previous scanline and its surrounding scanlines to be drawn
+        core->tracer.begin("3D wait", TRACK_GPU3D + thread, prev);
         while ((prev > 0 && ready[prev - 1].load() < 2) || ready[prev].load() < 2 || ready[prev + 1].load() < 2)
             std::this_thread::yield();
+        core->tracer.end(TRACK_GPU3D + thread);
 
         // Finish this thread's previous scanline
+        core->tracer.begin("3D finish", TRACK_GPU3D + thread, prev);
         finishScanline(prev);
+        core->tracer.end(TRACK_GPU3D + thread);
         ready[prev].store(3);
     }
 
     int prev = i - activeThreads;
 
     // Wait for this thread's final scanline and its surrounding scanlines to be drawn
+    core->tracer.begin("3D wait", TRACK_GPU3D + thread, prev);
     while (ready[prev - 1].load() < 2 || ready[prev].load() < 2 || (prev < 191 && ready[prev + 1].load() < 2))
         std::this_thread::yield();
+    core->tracer.end(TRACK_GPU3D + thread);
 
     // Finish this thread's final scanline
+    core->tracer.begin("3D finish", TRACK_GPU3D + thread, prev);
     finishScanline(prev);
+    core->tracer.end(TRACK_GPU3D + thread);
     ready[prev].store(3);
 }
 
@@ -229,6 +321,7 @@ void Gpu3DRenderer::drawScanline1(int line) {
     }
 
     stencilClear[line] = false;
+    linePixels[line] = 0;
 
     std::vector<int> translucent;
 
@@ -252,6 +345,9 @@ void Gpu3DRenderer::drawScanline1(int line) {
 }
 
 void Gpu3DRenderer::finishScanline(int line) {
+    // Count the scanline's pixels towards the frame metrics
+    pixelsDrawn.fetch_add(linePixels[line], std::memory_order_relaxed);
+
     // Perform edge marking if enabled
     if (disp3DCnt & BIT(5)) {
         int offset = line * 256 * 2;
@@ -926,6 +1022,10 @@ void Gpu3DRenderer::drawPolygon(int line, int polygonIndex) {
     int lastS = 0xFFFF, lastT = 0xFFFF;
     uint32_t texel;
 
+    // Count the pixels covered by the line segment
+    uint32_t width = 256 << resShift;
+    if (x1 < x4) linePixels[line] += std::min(x4, width) - std::min(x1, width);
+
     // Draw a line segment
     for (uint32_t x = x1; x < x4; x++) {
         // Skip the polygon interior for wireframe polygons
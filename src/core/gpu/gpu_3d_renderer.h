@@ -25,6 +25,7 @@
 #include <thread>
 
 class Core;
+class StateBuffer;
 struct Vertex;
 struct _Polygon;
 
@@ -33,11 +34,13 @@ public:
     Gpu3DRenderer(Core *core);
     ~Gpu3DRenderer();
 
-    void saveState(FILE *file);
-    void loadState(FILE *file);
+    void saveState(StateBuffer *buffer);
+    void loadState(StateBuffer *buffer);
 
     void drawScanline(int line);
     uint32_t *getLine(int line);
+    void waitJobs();
+    uint32_t takePixels() { return pixelsDrawn.exchange(0, std::memory_order_relaxed); }
 
     uint16_t readDisp3DCnt() { return disp3DCnt; }
 
@@ -67,6 +70,13 @@ private:
     std::vector<std::thread*> threads;
     std::atomic<int> ready[192 * 2];
 
+    bool pooled = false;
+    std::atomic<int> poolJobs;
+    std::atomic<int> nextLine;
+    std::atomic<bool> finishing[192 * 2];
+    uint32_t linePixels[192 * 2] = {};
+    std::atomic<uint32_t> pixelsDrawn;
+
     uint16_t disp3DCnt = 0;
     uint16_t edgeColor[8] = {};
     uint32_t clearColor = 0;
@@ -81,6 +91,9 @@ private:
     uint32_t *getLine1(int line);
 
     void drawThreaded(int thread);
+    void drawPooled();
+    bool claimLine(int line);
+    void tryFinish(int line);
     void drawScanline1(int line);
     void finishScanline(int line);
 
@@ -0,0 +1,417 @@
+/*
+    Copyright 2019-2026 Hydr8gon
+
+    This file is part of NooDS.
+
+    NooDS is free software: you can redistribute it and/or modify it
+    under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    NooDS is distributed in the hope that it will be useful, but
+    WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+    General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with NooDS. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "gpu_simd.h"
+#include "../defines.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SIMD_AVX2
+#define AVX2_FUNC __attribute__((target("avx2")))
+#include <immintrin.h>
+#endif
+
+#if defined(__SSE2__)
+#define SIMD_SSE2
+#include <emmintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#define SIMD_NEON
+#include <arm_neon.h>
+#endif
+
+template <bool rgb5> static FORCE_INLINE uint32_t convert(uint32_t color) {
+    // Convert an RGB5 or RGB6 value to an RGB8 value, with RGB6 as an intermediate
+    if (rgb5) color = ((color & 0x7C00) << 3) | ((color & 0x3E0) << 2) | ((color & 0x1F) << 1);
+    uint8_t r = ((color >> 0) & 0x3F) * 255 / 63;
+    uint8_t g = ((color >> 6) & 0x3F) * 255 / 63;
+    uint8_t b = ((color >> 12) & 0x3F) * 255 / 63;
+    return (0xFF << 24) | (b << 16) | (g << 8) | r;
+}
+
+static FORCE_INLINE uint32_t blend(uint32_t c1, uint32_t c2) {
+    // Average each color channel, rounding down, and force full alpha
+    return ((c1 & c2) + (((c1 ^ c2) >> 1) & 0x7F7F7F7F)) | 0xFF000000;
+}
+
+template <bool rgb5> static void convertScalar(const uint32_t *src, uint32_t *dst, int count) {
+    // Convert a line of pixels one at a time
+    for (int i = 0; i < count; i++)
+        dst[i] = convert<rgb5>(src[i]);
+}
+
+template <bool rgb5> static void convertScalarX2(const uint32_t *src, uint32_t *dst, int count) {
+    // Convert a line of pixels one at a time, writing each to a 2x2 block
+    for (int i = 0; i < count; i++) {
+        uint32_t color = convert<rgb5>(src[i]);
+        dst[i * 2 + 0] = dst[i * 2 + 1] = color;
+        dst[count * 2 + i * 2 + 0] = dst[count * 2 + i * 2 + 1] = color;
+    }
+}
+
+static FORCE_INLINE void merge3DTail(const uint32_t *src, const uint32_t *hiRes, uint32_t *dst, int count, int x) {
+    // Finish a merged line with any pixels left over from a vector loop
+    for (; x < count; x++) {
+        uint32_t value = src[x];
+        for (int i = x * 2; i < count * 4; i += count * 2) {
+            uint32_t value2 = hiRes[i + 0];
+            dst[i + 0] = convert<false>(((value & BIT(26)) && (value2 & 0xFC0000)) ? value2 : value);
+            value2 = hiRes[i + 1];
+            dst[i + 1] = convert<false>(((value & BIT(26)) && (value2 & 0xFC0000)) ? value2 : value);
+        }
+    }
+}
+
+static void merge3DScalar(const uint32_t *src, const uint32_t *hiRes, uint32_t *dst, int count) {
+    // Draw a line upscaled, replacing any 3D pixels with high-res output
+    merge3DTail(src, hiRes, dst, count, 0);
+}
+
+static void blendGhostScalar(uint32_t *out, uint32_t *prev, int count) {
+    // Blend output with the previous frame one pixel at a time
+    for (int i = 0; i < count; i++) {
+        uint32_t color = out[i];
+        out[i] = blend(prev[i], color);
+        prev[i] = color;
+    }
+}
+
+#ifdef SIMD_SSE2
+
+template <bool rgb5> static FORCE_INLINE __m128i convertSse2(__m128i color) {
+    // Spread the 6-bit channels into separate bytes
+    __m128i value;
+    if (rgb5)
+        value = _mm_or_si128(_mm_or_si128(_mm_slli_epi32(_mm_and_si128(color, _mm_set1_epi32(0x1F)), 1),
+            _mm_slli_epi32(_mm_and_si128(color, _mm_set1_epi32(0x3E0)), 4)),
+            _mm_slli_epi32(_mm_and_si128(color, _mm_set1_epi32(0x7C00)), 7));
+    else
+        value = _mm_or_si128(_mm_or_si128(_mm_and_si128(color, _mm_set1_epi32(0x3F)),
+            _mm_slli_epi32(_mm_and_si128(color, _mm_set1_epi32(0xFC0)), 2)),
+            _mm_slli_epi32(_mm_and_si128(color, _mm_set1_epi32(0x3F000)), 4));
+
+    // Widen to 16 bits and scale each channel by 255 / 63, using a multiply that matches integer division
+    __m128i zero = _mm_setzero_si128();
+    __m128i lo = _mm_mullo_epi16(_mm_unpacklo_epi8(value, zero), _mm_set1_epi16(255));
+    __m128i hi = _mm_mullo_epi16(_mm_unpackhi_epi8(value, zero), _mm_set1_epi16(255));
+    lo = _mm_srli_epi16(_mm_mulhi_epu16(lo, _mm_set1_epi16((short)33289)), 5);
+    hi = _mm_srli_epi16(_mm_mulhi_epu16(hi, _mm_set1_epi16((short)33289)), 5);
+    return _mm_or_si128(_mm_packus_epi16(lo, hi), _mm_set1_epi32(0xFF000000));
+}
+
+template <bool rgb5> static void convertLineSse2(const uint32_t *src, uint32_t *dst, int count) {
+    // Convert a line of pixels 4 at a time
+    int i = 0;
+    for (; i + 4 <= count; i += 4)
+        _mm_storeu_si128((__m128i*)&dst[i], convertSse2<rgb5>(_mm_loadu_si128((const __m128i*)&src[i])));
+    convertScalar<rgb5>(&src[i], &dst[i], count - i);
+}
+
+template <bool rgb5> static void convertLineSse2X2(const uint32_t *src, uint32_t *dst, int count) {
+    // Convert a line of pixels 4 at a time, writing each to a 2x2 block
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i color = convertSse2<rgb5>(_mm_loadu_si128((const __m128i*)&src[i]));
+        __m128i lo = _mm_unpacklo_epi32(color, color);
+        __m128i hi = _mm_unpackhi_epi32(color, color);
+        _mm_storeu_si128((__m128i*)&dst[i * 2 + 0], lo);
+        _mm_storeu_si128((__m128i*)&dst[i * 2 + 4], hi);
+        _mm_storeu_si128((__m128i*)&dst[count * 2 + i * 2 + 0], lo);
+        _mm_storeu_si128((__m128i*)&dst[count * 2 + i * 2 + 4], hi);
+    }
+    for (; i < count; i++) {
+        uint32_t color = convert<rgb5>(src[i]);
+        dst[i * 2 + 0] = dst[i * 2 + 1] = color;
+        dst[count * 2 + i * 2 + 0] = dst[count * 2 + i * 2 + 1] = color;
+    }
+}
+
+static void merge3DSse2(const uint32_t *src, const uint32_t *hiRes, uint32_t *dst, int count) {
+    // Draw a line upscaled 4 pixels at a time, replacing any 3D pixels with high-res output
+    __m128i zero = _mm_setzero_si128();
+    int x = 0;
+    for (; x + 4 <= count; x += 4) {
+        // Duplicate the source pixels and flag the ones that aren't 3D
+        __m128i value = _mm_loadu_si128((const __m128i*)&src[x]);
+        __m128i not3D = _mm_cmpeq_epi32(_mm_and_si128(value, _mm_set1_epi32(BIT(26))), zero);
+        __m128i values[] = { _mm_unpacklo_epi32(value, value), _mm_unpackhi_epi32(value, value) };
+        __m128i masks[] = { _mm_unpacklo_epi32(not3D, not3D), _mm_unpackhi_epi32(not3D, not3D) };
+
+        // Use high-res pixels for 3D pixels, unless the high-res pixel is empty
+        for (int i = x * 2; i < count * 4; i += count * 2) {
+            for (int j = 0; j < 2; j++) {
+                __m128i value2 = _mm_loadu_si128((const __m128i*)&hiRes[i + j * 4]);
+                __m128i mask = _mm_or_si128(masks[j], _mm_cmpeq_epi32(_mm_and_si128(value2, _mm_set1_epi32(0xFC0000)), zero));
+                value2 = _mm_or_si128(_mm_and_si128(mask, values[j]), _mm_andnot_si128(mask, value2));
+                _mm_storeu_si128((__m128i*)&dst[i + j * 4], convertSse2<false>(value2));
+            }
+        }
+    }
+    merge3DTail(src, hiRes, dst, count, x);
+}
+
+static void blendGhostSse2(uint32_t *out, uint32_t *prev, int count) {
+    // Blend output with the previous frame 4 pixels at a time
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i c1 = _mm_loadu_si128((const __m128i*)&prev[i]);
+        __m128i c2 = _mm_loadu_si128((const __m128i*)&out[i]);
+        __m128i avg = _mm_add_epi32(_mm_and_si128(c1, c2),
+            _mm_and_si128(_mm_srli_epi32(_mm_xor_si128(c1, c2), 1), _mm_set1_epi32(0x7F7F7F7F)));
+        _mm_storeu_si128((__m128i*)&out[i], _mm_or_si128(avg, _mm_set1_epi32(0xFF000000)));
+        _mm_storeu_si128((__m128i*)&prev[i], c2);
+    }
+    blendGhostScalar(&out[i], &prev[i], count - i);
+}
+
+#endif // SIMD_SSE2
+
+#ifdef SIMD_AVX2
+
+template <bool rgb5> static FORCE_INLINE AVX2_FUNC __m256i convertAvx2(__m256i color) {
+    // Spread the 6-bit channels into separate bytes
+    __m256i value;
+    if (rgb5)
+        value = _mm256_or_si256(_mm256_or_si256(_mm256_slli_epi32(_mm256_and_si256(color, _mm256_set1_epi32(0x1F)), 1),
+            _mm256_slli_epi32(_mm256_and_si256(color, _mm256_set1_epi32(0x3E0)), 4)),
+            _mm256_slli_epi32(_mm256_and_si256(color, _mm256_set1_epi32(0x7C00)), 7));
+    else
+        value = _mm256_or_si256(_mm256_or_si256(_mm256_and_si256(color, _mm256_set1_epi32(0x3F)),
+            _mm256_slli_epi32(_mm256_and_si256(color, _mm256_set1_epi32(0xFC0)), 2)),
+            _mm256_slli_epi32(_mm256_and_si256(color, _mm256_set1_epi32(0x3F000)), 4));
+
+    // Widen to 16 bits and scale each channel by 255 / 63, using a multiply that matches integer division
+    __m256i zero = _mm256_setzero_si256();
+    __m256i lo = _mm256_mullo_epi16(_mm256_unpacklo_epi8(value, zero), _mm256_set1_epi16(255));
+    __m256i hi = _mm256_mullo_epi16(_mm256_unpackhi_epi8(value, zero), _mm256_set1_epi16(255));
+    lo = _mm256_srli_epi16(_mm256_mulhi_epu16(lo, _mm256_set1_epi16((short)33289)), 5);
+    hi = _mm256_srli_epi16(_mm256_mulhi_epu16(hi, _mm256_set1_epi16((short)33289)), 5);
+    return _mm256_or_si256(_mm256_packus_epi16(lo, hi), _mm256_set1_epi32(0xFF000000));
+}
+
+template <bool rgb5> static AVX2_FUNC void convertLineAvx2(const uint32_t *src, uint32_t *dst, int count) {
+    // Convert a line of pixels 8 at a time
+    int i = 0;
+    for (; i + 8 <= count; i += 8)
+        _mm256_storeu_si256((__m256i*)&dst[i], convertAvx2<rgb5>(_mm256_loadu_si256((const __m256i*)&src[i])));
+    convertScalar<rgb5>(&src[i], &dst[i], count - i);
+}
+
+template <bool rgb5> static AVX2_FUNC void convertLineAvx2X2(const uint32_t *src, uint32_t *dst, int count) {
+    // Convert a line of pixels 8 at a time, writing each to a 2x2 block
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i color = convertAvx2<rgb5>(_mm256_loadu_si256((const __m256i*)&src[i]));
+        __m256i lo = _mm256_unpacklo_epi32(color, color);
+        __m256i hi = _mm256_unpackhi_epi32(color, color);
+        __m256i out0 = _mm256_permute2x128_si256(lo, hi, 0x20);
+        __m256i out1 = _mm256_permute2x128_si256(lo, hi, 0x31);
+        _mm256_storeu_si256((__m256i*)&dst[i * 2 + 0], out0);
+        _mm256_storeu_si256((__m256i*)&dst[i * 2 + 8], out1);
+        _mm256_storeu_si256((__m256i*)&dst[count * 2 + i * 2 + 0], out0);
+        _mm256_storeu_si256((__m256i*)&dst[count * 2 + i * 2 + 8], out1);
+    }
+    for (; i < count; i++) {
+        uint32_t color = convert<rgb5>(src[i]);
+        dst[i * 2 + 0] = dst[i * 2 + 1] = color;
+        dst[count * 2 + i * 2 + 0] = dst[count * 2 + i * 2 + 1] = color;
+    }
+}
+
+static AVX2_FUNC void merge3DAvx2(const uint32_t *src, const uint32_t *hiRes, uint32_t *dst, int count) {
+    // Draw a line upscaled 8 pixels at a time, replacing any 3D pixels with high-res output
+    __m256i zero = _mm256_setzero_si256();
+    int x = 0;
+    for (; x + 8 <= count; x += 8) {
+        // Duplicate the source pixels and flag the ones that aren't 3D
+        __m256i value = _mm256_loadu_si256((const __m256i*)&src[x]);
+        __m256i not3D = _mm256_cmpeq_epi32(_mm256_and_si256(value, _mm256_set1_epi32(BIT(26))), zero);
+        __m256i lo = _mm256_unpacklo_epi32(value, value), hi = _mm256_unpackhi_epi32(value, value);
+        __m256i values[] = { _mm256_permute2x128_si256(lo, hi, 0x20), _mm256_permute2x128_si256(lo, hi, 0x31) };
+        lo = _mm256_unpacklo_epi32(not3D, not3D), hi = _mm256_unpackhi_epi32(not3D, not3D);
+        __m256i masks[] = { _mm256_permute2x128_si256(lo, hi, 0x20), _mm256_permute2x128_si256(lo, hi, 0x31) };
+
+        // Use high-res pixels for 3D pixels, unless the high-res pixel is empty
+        for (int i = x * 2; i < count * 4; i += count * 2) {
+            for (int j = 0; j < 2; j++) {
+                __m256i value2 = _mm256_loadu_si256((const __m256i*)&hiRes[i + j * 8]);
+                __m256i mask = _mm256_or_si256(masks[j], _mm256_cmpeq_epi32(_mm256_and_si256(value2, _mm256_set1_epi32(0xFC0000)), zero));
+                value2 = _mm256_blendv_epi8(value2, values[j], mask);
+                _mm256_storeu_si256((__m256i*)&dst[i + j * 8], convertAvx2<false>(value2));
+            }
+        }
+    }
+    merge3DTail(src, hiRes, dst, count, x);
+}
+
+static AVX2_FUNC void blendGhostAvx2(uint32_t *out, uint32_t *prev, int count) {
+    // Blend output with the previous frame 8 pixels at a time
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i c1 = _mm256_loadu_si256((const __m256i*)&prev[i]);
+        __m256i c2 = _mm256_loadu_si256((const __m256i*)&out[i]);
+        __m256i avg = _mm256_add_epi32(_mm256_and_si256(c1, c2),
+            _mm256_and_si256(_mm256_srli_epi32(_mm256_xor_si256(c1, c2), 1), _mm256_set1_epi32(0x7F7F7F7F)));
+        _mm256_storeu_si256((__m256i*)&out[i], _mm256_or_si256(avg, _mm256_set1_epi32(0xFF000000)));
+        _mm256_storeu_si256((__m256i*)&prev[i], c2);
+    }
+    blendGhostScalar(&out[i], &prev[i], count - i);
+}
+
+#endif // SIMD_AVX2
+
+#ifdef SIMD_NEON
+
+// Lookup table for scaling 6-bit channels to 8 bits
+static const uint8_t scaleTable[64] = {
+    0x00, 0x04, 0x08, 0x0C, 0x10, 0x14, 0x18, 0x1C, 0x20, 0x24, 0x28, 0x2C, 0x30, 0x34, 0x38, 0x3C,
+    0x40, 0x44, 0x48, 0x4C, 0x50, 0x55, 0x59, 0x5D, 0x61, 0x65, 0x69, 0x6D, 0x71, 0x75, 0x79, 0x7D,
+    0x81, 0x85, 0x89, 0x8D, 0x91, 0x95, 0x99, 0x9D, 0xA1, 0xA5, 0xAA, 0xAE, 0xB2, 0xB6, 0xBA, 0xBE,
+    0xC2, 0xC6, 0xCA, 0xCE, 0xD2, 0xD6, 0xDA, 0xDE, 0xE2, 0xE6, 0xEA, 0xEE, 0xF2, 0xF6, 0xFA, 0xFF
+};
+
+template <bool rgb5> static FORCE_INLINE uint32x4_t convertNeon(uint32x4_t color, const uint8x16x4_t &table) {
+    // Spread the 6-bit channels into separate bytes
+    uint32x4_t value;
+    if (rgb5)
+        value = vorrq_u32(vorrq_u32(vshlq_n_u32(vandq_u32(color, vdupq_n_u32(0x1F)), 1),
+            vshlq_n_u32(vandq_u32(color, vdupq_n_u32(0x3E0)), 4)),
+            vshlq_n_u32(vandq_u32(color, vdupq_n_u32(0x7C00)), 7));
+    else
+        value = vorrq_u32(vorrq_u32(vandq_u32(color, vdupq_n_u32(0x3F)),
+            vshlq_n_u32(vandq_u32(color, vdupq_n_u32(0xFC0)), 2)),
+            vshlq_n_u32(vandq_u32(color, vdupq_n_u32(0x3F000)), 4));
+
+    // Scale each channel with a table lookup and force full alpha
+    uint8x16_t bytes = vqtbl4q_u8(table, vreinterpretq_u8_u32(value));
+    return vorrq_u32(vreinterpretq_u32_u8(bytes), vdupq_n_u32(0xFF000000));
+}
+
+template <bool rgb5> static void convertLineNeon(const uint32_t *src, uint32_t *dst, int count) {
+    // Convert a line of pixels 4 at a time
+    uint8x16x4_t table = vld1q_u8_x4(scaleTable);
+    int i = 0;
+    for (; i + 4 <= count; i += 4)
+        vst1q_u32(&dst[i], convertNeon<rgb5>(vld1q_u32(&src[i]), table));
+    convertScalar<rgb5>(&src[i], &dst[i], count - i);
+}
+
+template <bool rgb5> static void convertLineNeonX2(const uint32_t *src, uint32_t *dst, int count) {
+    // Convert a line of pixels 4 at a time, writing each to a 2x2 block
+    uint8x16x4_t table = vld1q_u8_x4(scaleTable);
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        uint32x4_t color = convertNeon<rgb5>(vld1q_u32(&src[i]), table);
+        uint32x4_t lo = vzip1q_u32(color, color);
+        uint32x4_t hi = vzip2q_u32(color, color);
+        vst1q_u32(&dst[i * 2 + 0], lo);
+        vst1q_u32(&dst[i * 2 + 4], hi);
+        vst1q_u32(&dst[count * 2 + i * 2 + 0], lo);
+        vst1q_u32(&dst[count * 2 + i * 2 + 4], hi);
+    }
+    for (; i < count; i++) {
+        uint32_t color = convert<rgb5>(src[i]);
+        dst[i * 2 + 0] = dst[i * 2 + 1] = color;
+        dst[count * 2 + i * 2 + 0] = dst[count * 2 + i * 2 + 1] = color;
+    }
+}
+
+static void merge3DNeon(const uint32_t *src, const uint32_t *hiRes, uint32_t *dst, int count) {
+    // Draw a line upscaled 4 pixels at a time, replacing any 3D pixels with high-res output
+    uint8x16x4_t table = vld1q_u8_x4(scaleTable);
+    int x = 0;
+    for (; x + 4 <= count; x += 4) {
+        // Duplicate the source pixels and flag the ones that are 3D
+        uint32x4_t value = vld1q_u32(&src[x]);
+        uint32x4_t is3D = vtstq_u32(value, vdupq_n_u32(BIT(26)));
+        uint32x4_t values[] = { vzip1q_u32(value, value), vzip2q_u32(value, value) };
+        uint32x4_t masks[] = { vzip1q_u32(is3D, is3D), vzip2q_u32(is3D, is3D) };
+
+        // Use high-res pixels for 3D pixels, unless the high-res pixel is empty
+        for (int i = x * 2; i < count * 4; i += count * 2) {
+            for (int j = 0; j < 2; j++) {
+                uint32x4_t value2 = vld1q_u32(&hiRes[i + j * 4]);
+                uint32x4_t mask = vandq_u32(masks[j], vtstq_u32(value2, vdupq_n_u32(0xFC0000)));
+                vst1q_u32(&dst[i + j * 4], convertNeon<false>(vbslq_u32(mask, value2, values[j]), table));
+            }
+        }
+    }
+    merge3DTail(src, hiRes, dst, count, x);
+}
+
+static void blendGhostNeon(uint32_t *out, uint32_t *prev, int count) {
+    // Blend output with the previous frame 4 pixels at a time
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        uint8x16_t c1 = vreinterpretq_u8_u32(vld1q_u32(&prev[i]));
+        uint8x16_t c2 = vreinterpretq_u8_u32(vld1q_u32(&out[i]));
+        uint32x4_t avg = vreinterpretq_u32_u8(vhaddq_u8(c1, c2));
+        vst1q_u32(&out[i], vorrq_u32(avg, vdupq_n_u32(0xFF000000)));
+        vst1q_u32(&prev[i], vreinterpretq_u32_u8(c2));
+    }
+    blendGhostScalar(&out[i], &prev[i], count - i);
+}
+
+#endif // SIMD_NEON
+
+// Default to the scalar kernels until selection runs at startup
+void (*GpuSimd::rgb5ToRgb8)(const uint32_t*, uint32_t*, int) = convertScalar<true>;
+void (*GpuSimd::rgb6ToRgb8)(const uint32_t*, uint32_t*, int) = convertScalar<false>;
+void (*GpuSimd::rgb5ToRgb8x2)(const uint32_t*, uint32_t*, int) = convertScalarX2<true>;
+void (*GpuSimd::rgb6ToRgb8x2)(const uint32_t*, uint32_t*, int) = convertScalarX2<false>;
+void (*GpuSimd::merge3D)(const uint32_t*, const uint32_t*, uint32_t*, int) = merge3DScalar;
+void (*GpuSimd::blendGhost)(uint32_t*, uint32_t*, int) = blendGhostScalar;
+const char *GpuSimd::name = GpuSimd::select();
+
+const char *GpuSimd::select() {
+#ifdef SIMD_AVX2
+    // Use AVX2 kernels if the CPU supports them
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        rgb5ToRgb8 = convertLineAvx2<true>;
+        rgb6ToRgb8 = convertLineAvx2<false>;
+        rgb5ToRgb8x2 = convertLineAvx2X2<true>;
+        rgb6ToRgb8x2 = convertLineAvx2X2<false>;
+        merge3D = merge3DAvx2;
+        blendGhost = blendGhostAvx2;
+        return "AVX2";
+    }
+#endif
+
+#if defined(SIMD_SSE2)
+    // Use SSE2 kernels, which are always available when enabled at compile time
+    rgb5ToRgb8 = convertLineSse2<true>;
+    rgb6ToRgb8 = convertLineSse2<false>;
+    rgb5ToRgb8x2 = convertLineSse2X2<true>;
+    rgb6ToRgb8x2 = convertLineSse2X2<false>;
+    merge3D = merge3DSse2;
+    blendGhost = blendGhostSse2;
+    return "SSE2";
+#elif defined(SIMD_NEON)
+    // Use NEON kernels, which are always available on AArch64
+    rgb5ToRgb8 = convertLineNeon<true>;
+    rgb6ToRgb8 = convertLineNeon<false>;
+    rgb5ToRgb8x2 = convertLineNeonX2<true>;
+    rgb6ToRgb8x2 = convertLineNeonX2<false>;
+    merge3D = merge3DNeon;
+    blendGhost = blendGhostNeon;
+    return "NEON";
+#else
+    // Fall back to the scalar kernels
+    return "Scalar";
+#endif
+}
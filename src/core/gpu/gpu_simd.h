@@ -0,0 +1,42 @@
+/*
+    Copyright 2019-2026 Hydr8gon
+
+    This file is part of NooDS.
+
+    NooDS is free software: you can redistribute it and/or modify it
+    under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    NooDS is distributed in the hope that it will be useful, but
+    WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+    General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with NooDS. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <cstdint>
+
+// Pixel kernels used to output frames, selected at runtime based on CPU features
+// Upscaled kernels write 2 output lines for each source line, with a stride of twice the count
+class GpuSimd {
+public:
+    static void (*rgb5ToRgb8)(const uint32_t *src, uint32_t *dst, int count);
+    static void (*rgb6ToRgb8)(const uint32_t *src, uint32_t *dst, int count);
+    static void (*rgb5ToRgb8x2)(const uint32_t *src, uint32_t *dst, int count);
+    static void (*rgb6ToRgb8x2)(const uint32_t *src, uint32_t *dst, int count);
+    static void (*merge3D)(const uint32_t *src, const uint32_t *hiRes, uint32_t *dst, int count);
+    static void (*blendGhost)(uint32_t *out, uint32_t *prev, int count);
+
+    static const char *getName() { return name; }
+
+private:
+    static const char *name;
+
+    GpuSimd() {} // Private to prevent instantiation
+    static const char *select();
+};
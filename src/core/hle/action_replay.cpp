@@ -29,6 +29,13 @@ void ActionReplay::setFd(int fd) {
     this->fd = fd;
 }
 
+void ActionReplay::inherit(ActionReplay &parent) {
+    // Copy the parent's cheats without a path, so they can't be saved over the parent's file
+    parent.mutex.lock();
+    cheats = parent.cheats;
+    parent.mutex.unlock();
+}
+
 FILE *ActionReplay::openFile(const char *mode) {
     // Open the cheat file if one is set
     if (fd != -1)
@@ -39,6 +39,7 @@ public:
     ActionReplay(Core *core): core(core) {}
     void setPath(std::string path);
     void setFd(int fd);
+    void inherit(ActionReplay &parent);
 
     bool loadCheats();
     bool saveCheats();
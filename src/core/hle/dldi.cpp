@@ -26,21 +26,33 @@ Dldi::~Dldi() {
         fclose(sdImage);
 }
 
+void Dldi::inherit(Dldi &parent) {
+    // Open the parent's SD image read-only, so forks can't corrupt it with conflicting writes
+    patched = parent.patched;
+    if (parent.sdImage)
+        sdImage = fopen(core->config.sdImagePath.c_str(), "rb");
+}
+
+bool Dldi::isDriver(const uint8_t *rom, uint32_t i) {
+    // Check for the DLDI magic number and string
+    return U8TO32(rom, i) == 0xBF8DA5ED && !memcmp(&rom[i + 4], " Chishm\0", 8);
+}
+
+bool Dldi::findDriver(const uint8_t *rom, uint32_t size) {
+    // Scan the ROM for a DLDI driver without patching it
+    for (uint32_t i = 0; i < size; i += 4) {
+        if (isDriver(rom, i))
+            return true;
+    }
+    return false;
+}
+
 void Dldi::patchRom(uint8_t *rom, uint32_t offset, uint32_t size) {
     // Scan the ROM for DLDI drivers and patch them if found
     for (uint32_t i = 0; i < size; i += 4) {
-        // Check for the DLDI magic number
-        if (U8TO32(rom, i) != 0xBF8DA5ED)
-        next:
+        if (!isDriver(rom, i))
             continue;
 
-        // Check for the DLDI magic string
-        const char *str = " Chishm\0";
-        for (size_t j = 0; j < 8; j++) {
-            if (rom[i + 4 + j] != str[j])
-                goto next;
-        }
-
         // Ensure there's room to patch the DLDI driver
         if (rom[i + 0x0F] < 0x08) { // Space in ROM
             LOG_CRIT("Not enough space to patch DLDI driver at ROM offset 0x%X\n", offset + i);
@@ -79,7 +91,7 @@ void Dldi::patchRom(uint8_t *rom, uint32_t offset, uint32_t size) {
 
 int Dldi::startup() {
     // Try to open the SD image
-    sdImage = fopen(Settings::sdImagePath.c_str(), "rb+");
+    sdImage = fopen(core->config.sdImagePath.c_str(), "rb+");
     return (sdImage ? 1 : 0);
 }
 
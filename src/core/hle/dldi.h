@@ -38,7 +38,9 @@ public:
     Dldi(Core *core): core(core) {}
     ~Dldi();
 
+    void inherit(Dldi &parent);
     void patchRom(uint8_t *rom, uint32_t offset, uint32_t size);
+    static bool findDriver(const uint8_t *rom, uint32_t size);
     bool isPatched() { return patched; }
 
     int startup();
@@ -52,4 +54,6 @@ private:
     Core *core;
     bool patched = false;
     FILE *sdImage = nullptr;
+
+    static bool isDriver(const uint8_t *rom, uint32_t i);
 };
@@ -26,16 +26,16 @@ void HleArm7::init() {
     core->ipc.writeIpcFifoCnt(1, -1, 0x8000);
 }
 
-void HleArm7::saveState(FILE *file) {
-    // Write state data to the file
-    fwrite(&inited, 1, sizeof(inited), file);
-    fwrite(&autoTouch, 1, sizeof(autoTouch), file);
+void HleArm7::saveState(StateBuffer *buffer) {
+    // Write state data to the buffer
+    buffer->write(&inited, 1, sizeof(inited));
+    buffer->write(&autoTouch, 1, sizeof(autoTouch));
 }
 
-void HleArm7::loadState(FILE *file) {
-    // Read state data from the file
-    fread(&inited, 1, sizeof(inited), file);
-    fread(&autoTouch, 1, sizeof(autoTouch), file);
+void HleArm7::loadState(StateBuffer *buffer) {
+    // Read state data from the buffer
+    buffer->read(&inited, 1, sizeof(inited));
+    buffer->read(&autoTouch, 1, sizeof(autoTouch));
 }
 
 void HleArm7::ipcSync(uint8_t value) {
@@ -23,14 +23,15 @@
 #include <cstdio>
 
 class Core;
+class StateBuffer;
 
 class HleArm7 {
 public:
     HleArm7(Core *core): core(core) {}
     void init();
 
-    void saveState(FILE *file);
-    void loadState(FILE *file);
+    void saveState(StateBuffer *buffer);
+    void loadState(StateBuffer *buffer);
 
     void ipcSync(uint8_t value);
     void ipcFifo(uint32_t value);
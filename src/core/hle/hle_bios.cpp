@@ -59,14 +59,14 @@ int (HleBios::*HleBios::swiTableGba[])(uint32_t**) = {
     &HleBios::swiUnknown // 0x20
 };
 
-void HleBios::saveState(FILE *file) {
-    // Write state data to the file
-    fwrite(&waitFlags, sizeof(waitFlags), 1, file);
+void HleBios::saveState(StateBuffer *buffer) {
+    // Write state data to the buffer
+    buffer->write(&waitFlags, sizeof(waitFlags), 1);
 }
 
-void HleBios::loadState(FILE *file) {
-    // Read state data from the file
-    fread(&waitFlags, sizeof(waitFlags), 1, file);
+void HleBios::loadState(StateBuffer *buffer) {
+    // Read state data from the buffer
+    buffer->read(&waitFlags, sizeof(waitFlags), 1);
 }
 
 int HleBios::execute(uint8_t vector, uint32_t **registers) {
@@ -23,6 +23,7 @@
 #include <cstdio>
 
 class Core;
+class StateBuffer;
 
 class HleBios {
 public:
@@ -32,8 +33,8 @@ public:
 
     HleBios(Core *core, bool arm7, int (HleBios::**swiTable)(uint32_t**)):
         core(core), arm7(arm7), swiTable(swiTable) {}
-    void saveState(FILE *file);
-    void loadState(FILE *file);
+    void saveState(StateBuffer *buffer);
+    void loadState(StateBuffer *buffer);
 
     int execute(uint8_t vector, uint32_t **registers);
     void checkWaitFlags();
@@ -44,48 +44,48 @@ Aes::Aes(Core *core): core(core) {
     }
 }
 
-void Aes::saveState(FILE *file) {
-    // Write DSi state data to the file
+void Aes::saveState(StateBuffer *buffer) {
+    // Write DSi state data to the buffer
     if (!core->dsiMode) return;
-    fwrite(&scheduled, sizeof(scheduled), 1, file);
-    fwrite(keys, 4, sizeof(keys) / 4, file);
-    fwrite(keysX, 4, sizeof(keysX) / 4, file);
-    fwrite(keysY, 4, sizeof(keysY) / 4, file);
-    fwrite(rKey, 4, sizeof(rKey) / 4, file);
-    fwrite(ctr, 4, sizeof(ctr) / 4, file);
-    fwrite(cbc, 4, sizeof(cbc) / 4, file);
-    fwrite(&curBlock, sizeof(curBlock), 1, file);
-    fwrite(&curExtra, sizeof(curExtra), 1, file);
-    fwrite(&curKey, sizeof(curKey), 1, file);
-    fwrite(&aesCnt, sizeof(aesCnt), 1, file);
-    fwrite(&aesBlkcnt, sizeof(aesBlkcnt), 1, file);
-    fwrite(&aesRdfifo, sizeof(aesRdfifo), 1, file);
-    fwrite(aesIv, 4, sizeof(aesIv) / 4, file);
-    fwrite(aesMac, 4, sizeof(aesMac) / 4, file);
-    SaveStates::writeFifo(writeFifo, file);
-    SaveStates::writeFifo(readFifo, file);
+    buffer->write(&scheduled, sizeof(scheduled), 1);
+    buffer->write(keys, 4, sizeof(keys) / 4);
+    buffer->write(keysX, 4, sizeof(keysX) / 4);
+    buffer->write(keysY, 4, sizeof(keysY) / 4);
+    buffer->write(rKey, 4, sizeof(rKey) / 4);
+    buffer->write(ctr, 4, sizeof(ctr) / 4);
+    buffer->write(cbc, 4, sizeof(cbc) / 4);
+    buffer->write(&curBlock, sizeof(curBlock), 1);
+    buffer->write(&curExtra, sizeof(curExtra), 1);
+    buffer->write(&curKey, sizeof(curKey), 1);
+    buffer->write(&aesCnt, sizeof(aesCnt), 1);
+    buffer->write(&aesBlkcnt, sizeof(aesBlkcnt), 1);
+    buffer->write(&aesRdfifo, sizeof(aesRdfifo), 1);
+    buffer->write(aesIv, 4, sizeof(aesIv) / 4);
+    buffer->write(aesMac, 4, sizeof(aesMac) / 4);
+    SaveStates::writeFifo(writeFifo, buffer);
+    SaveStates::writeFifo(readFifo, buffer);
 }
 
-void Aes::loadState(FILE *file) {
-    // Read DSi state data from the file
+void Aes::loadState(StateBuffer *buffer) {
+    // Read DSi state data from the buffer
     if (!core->dsiMode) return;
-    fread(&scheduled, sizeof(scheduled), 1, file);
-    fread(keys, 4, sizeof(keys) / 4, file);
-    fread(keysX, 4, sizeof(keysX) / 4, file);
-    fread(keysY, 4, sizeof(keysY) / 4, file);
-    fread(rKey, 4, sizeof(rKey) / 4, file);
-    fread(ctr, 4, sizeof(ctr) / 4, file);
-    fread(cbc, 4, sizeof(cbc) / 4, file);
-    fread(&curBlock, sizeof(curBlock), 1, file);
-    fread(&curExtra, sizeof(curExtra), 1, file);
-    fread(&curKey, sizeof(curKey), 1, file);
-    fread(&aesCnt, sizeof(aesCnt), 1, file);
-    fread(&aesBlkcnt, sizeof(aesBlkcnt), 1, file);
-    fread(&aesRdfifo, sizeof(aesRdfifo), 1, file);
-    fread(aesIv, 4, sizeof(aesIv) / 4, file);
-    fread(aesMac, 4, sizeof(aesMac) / 4, file);
-    SaveStates::readFifo(writeFifo, file);
-    SaveStates::readFifo(readFifo, file);
+    buffer->read(&scheduled, sizeof(scheduled), 1);
+    buffer->read(keys, 4, sizeof(keys) / 4);
+    buffer->read(keysX, 4, sizeof(keysX) / 4);
+    buffer->read(keysY, 4, sizeof(keysY) / 4);
+    buffer->read(rKey, 4, sizeof(rKey) / 4);
+    buffer->read(ctr, 4, sizeof(ctr) / 4);
+    buffer->read(cbc, 4, sizeof(cbc) / 4);
+    buffer->read(&curBlock, sizeof(curBlock), 1);
+    buffer->read(&curExtra, sizeof(curExtra), 1);
+    buffer->read(&curKey, sizeof(curKey), 1);
+    buffer->read(&aesCnt, sizeof(aesCnt), 1);
+    buffer->read(&aesBlkcnt, sizeof(aesBlkcnt), 1);
+    buffer->read(&aesRdfifo, sizeof(aesRdfifo), 1);
+    buffer->read(aesIv, 4, sizeof(aesIv) / 4);
+    buffer->read(aesMac, 4, sizeof(aesMac) / 4);
+    SaveStates::readFifo(writeFifo, buffer);
+    SaveStates::readFifo(readFifo, buffer);
 }
 
 uint32_t Aes::scatter8(uint8_t *t, uint32_t a, uint32_t b, uint32_t c, uint32_t d) {
@@ -23,12 +23,13 @@
 #include <deque>
 
 class Core;
+class StateBuffer;
 
 class Aes {
 public:
     Aes(Core *core);
-    void saveState(FILE *file);
-    void loadState(FILE *file);
+    void saveState(StateBuffer *buffer);
+    void loadState(StateBuffer *buffer);
     void update();
 
     uint32_t readCnt() { return aesCnt; }
@@ -20,28 +20,28 @@
 #include <cmath>
 #include "../core.h"
 
-void DivSqrt::saveState(FILE *file) {
-    // Write state data to the file
-    fwrite(&divCnt, sizeof(divCnt), 1, file);
-    fwrite(&divNumer, sizeof(divNumer), 1, file);
-    fwrite(&divDenom, sizeof(divDenom), 1, file);
-    fwrite(&divResult, sizeof(divResult), 1, file);
-    fwrite(&divRemResult, sizeof(divRemResult), 1, file);
-    fwrite(&sqrtCnt, sizeof(sqrtCnt), 1, file);
-    fwrite(&sqrtResult, sizeof(sqrtResult), 1, file);
-    fwrite(&sqrtParam, sizeof(sqrtParam), 1, file);
+void DivSqrt::saveState(StateBuffer *buffer) {
+    // Write state data to the buffer
+    buffer->write(&divCnt, sizeof(divCnt), 1);
+    buffer->write(&divNumer, sizeof(divNumer), 1);
+    buffer->write(&divDenom, sizeof(divDenom), 1);
+    buffer->write(&divResult, sizeof(divResult), 1);
+    buffer->write(&divRemResult, sizeof(divRemResult), 1);
+    buffer->write(&sqrtCnt, sizeof(sqrtCnt), 1);
+    buffer->write(&sqrtResult, sizeof(sqrtResult), 1);
+    buffer->write(&sqrtParam, sizeof(sqrtParam), 1);
 }
 
-void DivSqrt::loadState(FILE *file) {
-    // Read state data from the file
-    fread(&divCnt, sizeof(divCnt), 1, file);
-    fread(&divNumer, sizeof(divNumer), 1, file);
-    fread(&divDenom, sizeof(divDenom), 1, file);
-    fread(&divResult, sizeof(divResult), 1, file);
-    fread(&divRemResult, sizeof(divRemResult), 1, file);
-    fread(&sqrtCnt, sizeof(sqrtCnt), 1, file);
-    fread(&sqrtResult, sizeof(sqrtResult), 1, file);
-    fread(&sqrtParam, sizeof(sqrtParam), 1, file);
+void DivSqrt::loadState(StateBuffer *buffer) {
+    // Read state data from the buffer
+    buffer->read(&divCnt, sizeof(divCnt), 1);
+    buffer->read(&divNumer, sizeof(divNumer), 1);
+    buffer->read(&divDenom, sizeof(divDenom), 1);
+    buffer->read(&divResult, sizeof(divResult), 1);
+    buffer->read(&divRemResult, sizeof(divRemResult), 1);
+    buffer->read(&sqrtCnt, sizeof(sqrtCnt), 1);
+    buffer->read(&sqrtResult, sizeof(sqrtResult), 1);
+    buffer->read(&sqrtParam, sizeof(sqrtParam), 1);
 }
 
 void DivSqrt::divide() {
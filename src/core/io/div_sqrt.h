@@ -23,12 +23,13 @@
 #include <cstdio>
 
 class Core;
+class StateBuffer;
 
 class DivSqrt {
 public:
     DivSqrt(Core *core): core(core) {}
-    void saveState(FILE *file);
-    void loadState(FILE *file);
+    void saveState(StateBuffer *buffer);
+    void loadState(StateBuffer *buffer);
 
     uint16_t readDivCnt() { return divCnt; }
     uint32_t readDivNumerL() { return divNumer; }
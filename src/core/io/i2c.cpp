@@ -19,24 +19,24 @@
 
 #include "../core.h"
 
-void I2c::saveState(FILE *file) {
-    // Write DSi state data to the file
+void I2c::saveState(StateBuffer *buffer) {
+    // Write DSi state data to the buffer
     if (!core->dsiMode) return;
-    fwrite(&writeCount, sizeof(writeCount), 1, file);
-    fwrite(&devAddr, sizeof(devAddr), 1, file);
-    fwrite(&regAddr, sizeof(regAddr), 1, file);
-    fwrite(&i2cData, sizeof(i2cData), 1, file);
-    fwrite(&i2cCnt, sizeof(i2cCnt), 1, file);
+    buffer->write(&writeCount, sizeof(writeCount), 1);
+    buffer->write(&devAddr, sizeof(devAddr), 1);
+    buffer->write(&regAddr, sizeof(regAddr), 1);
+    buffer->write(&i2cData, sizeof(i2cData), 1);
+    buffer->write(&i2cCnt, sizeof(i2cCnt), 1);
 }
 
-void I2c::loadState(FILE *file) {
-    // Read DSi state data from the file
+void I2c::loadState(StateBuffer *buffer) {
+    // Read DSi state data from the buffer
     if (!core->dsiMode) return;
-    fread(&writeCount, sizeof(writeCount), 1, file);
-    fread(&devAddr, sizeof(devAddr), 1, file);
-    fread(&regAddr, sizeof(regAddr), 1, file);
-    fread(&i2cData, sizeof(i2cData), 1, file);
-    fread(&i2cCnt, sizeof(i2cCnt), 1, file);
+    buffer->read(&writeCount, sizeof(writeCount), 1);
+    buffer->read(&devAddr, sizeof(devAddr), 1);
+    buffer->read(&regAddr, sizeof(regAddr), 1);
+    buffer->read(&i2cData, sizeof(i2cData), 1);
+    buffer->read(&i2cCnt, sizeof(i2cCnt), 1);
 }
 
 uint8_t I2c::readMcu() {
@@ -22,12 +22,13 @@
 #include <cstdint>
 
 class Core;
+class StateBuffer;
 
 class I2c {
 public:
     I2c(Core *core): core(core) {}
-    void saveState(FILE *file);
-    void loadState(FILE *file);
+    void saveState(StateBuffer *buffer);
+    void loadState(StateBuffer *buffer);
 
     uint8_t readData() { return i2cData; }
     uint8_t readCnt() { return i2cCnt; }
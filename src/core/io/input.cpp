@@ -22,25 +22,64 @@
 void Input::pressKey(int key) {
     // Clear key bits to indicate presses
     if (key < 10) // A, B, select, start, right, left, up, down, R, L
-        keyInput &= ~BIT(key);
+        host.keyInput &= ~BIT(key);
     else if (key < 12) // X, Y
-        extKeyIn &= ~BIT(key - 10);
+        host.extKeyIn &= ~BIT(key - 10);
+    update();
 }
 
 void Input::releaseKey(int key) {
     // Set key bits to indicate releases
     if (key < 10) // A, B, select, start, right, left, up, down, R, L
-        keyInput |= BIT(key);
+        host.keyInput |= BIT(key);
     else if (key < 12) // X, Y
-        extKeyIn |= BIT(key - 10);
+        host.extKeyIn |= BIT(key - 10);
+    update();
 }
 
 void Input::pressScreen() {
     // Clear the pen down bit to indicate a touch press
-    extKeyIn &= ~BIT(6);
+    host.extKeyIn &= ~BIT(6);
+    update();
 }
 
 void Input::releaseScreen() {
     // Set the pen down bit to indicate a touch release
-    extKeyIn |= BIT(6);
+    host.extKeyIn |= BIT(6);
+    update();
+}
+
+void Input::setTouch(uint16_t x, uint16_t y) {
+    // Set the touchscreen ADC values, as converted by the SPI
+    host.touchX = x;
+    host.touchY = y;
+    update();
+}
+
+void Input::setLid(bool closed) {
+    // Set or clear the hinge bit to indicate the lid being closed or opened
+    if (closed)
+        host.extKeyIn |= BIT(7);
+    else
+        host.extKeyIn &= ~BIT(7);
+    update();
+}
+
+void Input::setLatched(bool value) {
+    // Catch up with the frontend when unlatching, since changes were held back until now
+    latched = value;
+    apply(host);
+}
+
+void Input::apply(const InputState &value) {
+    // Make an input state visible to the emulated system
+    state = value;
+    core->spi.touchX = state.touchX;
+    core->spi.touchY = state.touchY;
+}
+
+void Input::update() {
+    // Apply frontend changes right away unless they're latched until the end of a frame
+    if (!latched)
+        apply(host);
 }
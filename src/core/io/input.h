@@ -23,6 +23,15 @@
 
 class Core;
 
+struct InputState {
+    uint16_t keyInput = 0x03FF;
+    uint16_t extKeyIn = 0x007F;
+    uint16_t touchX = 0x000;
+    uint16_t touchY = 0xFFF;
+};
+
+// Tracks input from the frontend, and the copy of it that the emulated system sees
+// Changes normally apply right away, but can be latched so they only apply between frames
 class Input {
 public:
     Input(Core *core): core(core) {}
@@ -31,13 +40,22 @@ public:
     void releaseKey(int key);
     void pressScreen();
     void releaseScreen();
+    void setTouch(uint16_t x, uint16_t y);
+    void setLid(bool closed);
 
-    uint16_t readKeyInput() { return keyInput; }
-    uint16_t readExtKeyIn() { return extKeyIn; }
+    void setLatched(bool value);
+    void apply(const InputState &value);
+    const InputState &getHostState() { return host; }
+    const InputState &getState() { return state; }
+
+    uint16_t readKeyInput() { return state.keyInput; }
+    uint16_t readExtKeyIn() { return state.extKeyIn; }
 
 private:
     Core *core;
 
-    uint16_t keyInput = 0x03FF;
-    uint16_t extKeyIn = 0x007F;
+    InputState host, state;
+    bool latched = false;
+
+    void update();
 };
@@ -19,22 +19,22 @@
 
 #include "../core.h"
 
-void Ipc::saveState(FILE *file) {
-    // Write state data to the file
-    fwrite(ipcSync, 2, sizeof(ipcSync) / 2, file);
-    fwrite(ipcFifoCnt, 2, sizeof(ipcFifoCnt) / 2, file);
-    fwrite(ipcFifoRecv, 4, sizeof(ipcFifoRecv) / 4, file);
-    SaveStates::writeFifo(fifos[0], file);
-    SaveStates::writeFifo(fifos[1], file);
+void Ipc::saveState(StateBuffer *buffer) {
+    // Write state data to the buffer
+    buffer->write(ipcSync, 2, sizeof(ipcSync) / 2);
+    buffer->write(ipcFifoCnt, 2, sizeof(ipcFifoCnt) / 2);
+    buffer->write(ipcFifoRecv, 4, sizeof(ipcFifoRecv) / 4);
+    SaveStates::writeFifo(fifos[0], buffer);
+    SaveStates::writeFifo(fifos[1], buffer);
 }
 
-void Ipc::loadState(FILE *file) {
-    // Read state data from the file
-    fread(ipcSync, 2, sizeof(ipcSync) / 2, file);
-    fread(ipcFifoCnt, 2, sizeof(ipcFifoCnt) / 2, file);
-    fread(ipcFifoRecv, 4, sizeof(ipcFifoRecv) / 4, file);
-    SaveStates::readFifo(fifos[0], file);
-    SaveStates::readFifo(fifos[1], file);
+void Ipc::loadState(StateBuffer *buffer) {
+    // Read state data from the buffer
+    buffer->read(ipcSync, 2, sizeof(ipcSync) / 2);
+    buffer->read(ipcFifoCnt, 2, sizeof(ipcFifoCnt) / 2);
+    buffer->read(ipcFifoRecv, 4, sizeof(ipcFifoRecv) / 4);
+    SaveStates::readFifo(fifos[0], buffer);
+    SaveStates::readFifo(fifos[1], buffer);
 }
 
 void Ipc::writeIpcSync(bool arm7, uint16_t mask, uint16_t value) {
@@ -24,12 +24,13 @@
 #include <queue>
 
 class Core;
+class StateBuffer;
 
 class Ipc {
 public:
     Ipc(Core *core): core(core) {}
-    void saveState(FILE *file);
-    void loadState(FILE *file);
+    void saveState(StateBuffer *buffer);
+    void loadState(StateBuffer *buffer);
 
     uint16_t readIpcSync(bool arm7) { return ipcSync[arm7]; }
     uint16_t readIpcFifoCnt(bool arm7) { return ipcFifoCnt[arm7]; }
@@ -0,0 +1,78 @@
+/*
+    Copyright 2019-2026 Hydr8gon
+
+    This file is part of NooDS.
+
+    NooDS is free software: you can redistribute it and/or modify it
+    under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    NooDS is distributed in the hope that it will be useful, but
+    WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+    General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with NooDS. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <cmath>
+
+#include "resampler.h"
+
+void Resampler::setRates(int inRate, int outRate) {
+    // Place the cutoff just below the lower of the two Nyquist frequencies
+    double cutoff = 0.9 * std::min(1.0, (double)outRate / inRate);
+
+    // Build a table of Blackman-windowed sinc coefficients, with an extra phase for rounding up to the next sample
+    const double pi = 3.14159265358979323846;
+    for (int p = 0; p <= phases; p++) {
+        double coefs[taps], sum = 0;
+        for (int i = 0; i < taps; i++) {
+            double x = (i - (taps / 2 - 1)) - (double)p / phases;
+            double sinc = (x == 0) ? 1 : (sin(pi * cutoff * x) / (pi * cutoff * x));
+            double window = 0.42 + 0.5 * cos(pi * x / (taps / 2)) + 0.08 * cos(2 * pi * x / (taps / 2));
+            coefs[i] = sinc * std::max(0.0, window);
+            sum += coefs[i];
+        }
+
+        // Normalize each phase to unity gain with 14 fractional bits
+        for (int i = 0; i < taps; i++)
+            table[p][i] = lround(coefs[i] * 0x4000 / sum);
+    }
+}
+
+void Resampler::push(uint32_t sample) {
+    // Add a sample to the history, mirrored so a full window can always be read without wrapping
+    int16_t left = sample, right = sample >> 16;
+    history[0][pointer] = history[0][pointer + taps] = left;
+    history[1][pointer] = history[1][pointer + taps] = right;
+    pointer = (pointer + 1) % taps;
+}
+
+uint32_t Resampler::filter(uint32_t phase, bool sinc) {
+    // Filter each channel at a position between the two middle samples of the window
+    int32_t out[2];
+    for (int c = 0; c < 2; c++) {
+        int32_t *window = &history[c][pointer];
+        if (sinc) {
+            // Apply the filter for the nearest phase
+            const int16_t *coefs = table[(phase + (0x8000 / phases)) / (0x10000 / phases)];
+            int32_t sum = 0;
+            for (int i = 0; i < taps; i++)
+                sum += window[i] * coefs[i];
+            out[c] = sum >> 14;
+        }
+        else {
+            // Interpolate linearly between the two middle samples
+            int32_t a = window[taps / 2 - 1], b = window[taps / 2];
+            out[c] = a + (((int64_t)(b - a) * phase) >> 16);
+        }
+
+        // Clip the sample to the 16-bit range
+        out[c] = std::max(-0x8000, std::min(0x7FFF, out[c]));
+    }
+    return (out[1] << 16) | (out[0] & 0xFFFF);
+}
@@ -0,0 +1,39 @@
+/*
+    Copyright 2019-2026 Hydr8gon
+
+    This file is part of NooDS.
+
+    NooDS is free software: you can redistribute it and/or modify it
+    under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    NooDS is distributed in the hope that it will be useful, but
+    WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+    General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with NooDS. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <cstdint>
+
+// Converts a stream of packed stereo samples between sample rates
+// Input is pushed one sample at a time, and output is filtered at a 16-bit fractional position
+class Resampler {
+public:
+    void setRates(int inRate, int outRate);
+    void push(uint32_t sample);
+    uint32_t filter(uint32_t phase, bool sinc);
+
+private:
+    static const int taps = 16;
+    static const int phases = 256;
+
+    int16_t table[phases + 1][taps] = {};
+    int32_t history[2][taps * 2] = {};
+    int pointer = 0;
+};
@@ -20,32 +20,37 @@
 #include <ctime>
 #include "../core.h"
 
-void Rtc::saveState(FILE *file) {
-    // Write state data to the file
-    fwrite(&csCur, sizeof(csCur), 1, file);
-    fwrite(&sckCur, sizeof(sckCur), 1, file);
-    fwrite(&sioCur, sizeof(sioCur), 1, file);
-    fwrite(&writeCount, sizeof(writeCount), 1, file);
-    fwrite(&command, sizeof(command), 1, file);
-    fwrite(&control, sizeof(control), 1, file);
-    fwrite(dateTime, 1, sizeof(dateTime), file);
-    fwrite(&rtc, sizeof(rtc), 1, file);
-    fwrite(&gpDirection, sizeof(gpDirection), 1, file);
-    fwrite(&gpControl, sizeof(gpControl), 1, file);
+void Rtc::saveState(StateBuffer *buffer) {
+    // Write state data to the buffer
+    buffer->write(&csCur, sizeof(csCur), 1);
+    buffer->write(&sckCur, sizeof(sckCur), 1);
+    buffer->write(&sioCur, sizeof(sioCur), 1);
+    buffer->write(&writeCount, sizeof(writeCount), 1);
+    buffer->write(&command, sizeof(command), 1);
+    buffer->write(&control, sizeof(control), 1);
+    buffer->write(dateTime, 1, sizeof(dateTime));
+    buffer->write(&rtc, sizeof(rtc), 1);
+    buffer->write(&gpDirection, sizeof(gpDirection), 1);
+    buffer->write(&gpControl, sizeof(gpControl), 1);
 }
 
-void Rtc::loadState(FILE *file) {
-    // Read state data from the file
-    fread(&csCur, sizeof(csCur), 1, file);
-    fread(&sckCur, sizeof(sckCur), 1, file);
-    fread(&sioCur, sizeof(sioCur), 1, file);
-    fread(&writeCount, sizeof(writeCount), 1, file);
-    fread(&command, sizeof(command), 1, file);
-    fread(&control, sizeof(control), 1, file);
-    fread(dateTime, 1, sizeof(dateTime), file);
-    fread(&rtc, sizeof(rtc), 1, file);
-    fread(&gpDirection, sizeof(gpDirection), 1, file);
-    fread(&gpControl, sizeof(gpControl), 1, file);
+void Rtc::loadState(StateBuffer *buffer) {
+    // Read state data from the buffer
+    buffer->read(&csCur, sizeof(csCur), 1);
+    buffer->read(&sckCur, sizeof(sckCur), 1);
+    buffer->read(&sioCur, sizeof(sioCur), 1);
+    buffer->read(&writeCount, sizeof(writeCount), 1);
+    buffer->read(&command, sizeof(command), 1);
+    buffer->read(&control, sizeof(control), 1);
+    buffer->read(dateTime, 1, sizeof(dateTime));
+    buffer->read(&rtc, sizeof(rtc), 1);
+    buffer->read(&gpDirection, sizeof(gpDirection), 1);
+
+    // Update the memory map if the read status of the GP registers changed
+    uint16_t control = gpControl;
+    buffer->read(&gpControl, sizeof(gpControl), 1);
+    if (gpControl != control)
+        core->memory.updateMap7(0x8000000, 0x8001000);
 }
 
 void Rtc::updateRtc(bool cs, bool sck, bool sio) {
@@ -89,9 +94,9 @@ void Rtc::updateRtc(bool cs, bool sck, bool sio) {
 }
 
 void Rtc::updateDateTime() {
-    // Get the local time
-    std::time_t t = std::time(nullptr);
-    std::tm *time = std::localtime(&t);
+    // Get the local time, or a fixed UTC time if one is set so results don't depend on the host
+    std::time_t t = (fixedTime >= 0) ? std::time_t(fixedTime) : std::time(nullptr);
+    std::tm *time = (fixedTime >= 0) ? std::gmtime(&t) : std::localtime(&t);
     time->tm_year %= 100; // The DS only counts years 2000-2099
     time->tm_mon++; // The DS starts month values at 1, not 0
 
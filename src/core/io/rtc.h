@@ -23,16 +23,21 @@
 #include "../defines.h"
 
 class Core;
+class StateBuffer;
 
 class Rtc {
 public:
     Rtc(Core *core): core(core) {}
-    void saveState(FILE *file);
-    void loadState(FILE *file);
+    void saveState(StateBuffer *buffer);
+    void loadState(StateBuffer *buffer);
 
     void enableGpRtc() { gpRtc = true; }
+    void inherit(Rtc &parent) { gpRtc = parent.gpRtc; }
     void reset();
 
+    void setFixedTime(int64_t seconds) { fixedTime = seconds; }
+    void clearFixedTime() { fixedTime = -1; }
+
     uint8_t readRtc();
     uint16_t readGpData();
     uint16_t readGpDirection() { return gpDirection; }
@@ -46,6 +51,7 @@ public:
 private:
     Core *core;
     bool gpRtc = false;
+    int64_t fixedTime = -1;
 
     bool csCur = false;
     bool sckCur = false;
@@ -18,32 +18,32 @@
 */
 
 #include <cstring>
+#include "../asset_cache.h"
 #include "../core.h"
 
 Language Spi::language = LG_ENGLISH;
 
 Spi::~Spi() {
-    // Free any dynamic memory
-    if (firmware) delete[] firmware;
+    // Free any dynamic memory; firmware is freed once no cores share it
     if (micBuffer) delete[] micBuffer;
 }
 
-void Spi::saveState(FILE *file) {
-    // Write state data to the file
-    fwrite(&writeCount, sizeof(writeCount), 1, file);
-    fwrite(&address, sizeof(address), 1, file);
-    fwrite(&command, sizeof(command), 1, file);
-    fwrite(&spiCnt, sizeof(spiCnt), 1, file);
-    fwrite(&spiData, sizeof(spiData), 1, file);
+void Spi::saveState(StateBuffer *buffer) {
+    // Write state data to the buffer
+    buffer->write(&writeCount, sizeof(writeCount), 1);
+    buffer->write(&address, sizeof(address), 1);
+    buffer->write(&command, sizeof(command), 1);
+    buffer->write(&spiCnt, sizeof(spiCnt), 1);
+    buffer->write(&spiData, sizeof(spiData), 1);
 }
 
-void Spi::loadState(FILE *file) {
-    // Read state data from the file
-    fread(&writeCount, sizeof(writeCount), 1, file);
-    fread(&address, sizeof(address), 1, file);
-    fread(&command, sizeof(command), 1, file);
-    fread(&spiCnt, sizeof(spiCnt), 1, file);
-    fread(&spiData, sizeof(spiData), 1, file);
+void Spi::loadState(StateBuffer *buffer) {
+    // Read state data from the buffer
+    buffer->read(&writeCount, sizeof(writeCount), 1);
+    buffer->read(&address, sizeof(address), 1);
+    buffer->read(&command, sizeof(command), 1);
+    buffer->read(&spiCnt, sizeof(spiCnt), 1);
+    buffer->read(&spiData, sizeof(spiData), 1);
 }
 
 uint16_t Spi::crc16(uint32_t value, uint8_t *data, size_t size) {
@@ -59,22 +59,28 @@ uint16_t Spi::crc16(uint32_t value, uint8_t *data, size_t size) {
     return value;
 }
 
+void Spi::inherit(Spi &parent) {
+    // Share the parent's firmware, which is never written once loaded
+    firmSize = parent.firmSize;
+    firmData = parent.firmData;
+    firmware = firmData.get();
+}
+
 bool Spi::loadFirmware() {
-    // Ensure firmware memory isn't already allocated
-    if (firmware)
-        delete[] firmware;
-
-    // Load the firmware from a file if it exists
-    std::string &path = core->dsiMode ? Settings::dsiFirmPath : Settings::ndsFirmPath;
-    if (FILE *file = fopen(path.c_str(), "rb")) {
-        fseek(file, 0, SEEK_END);
-        firmSize = ftell(file);
-        fseek(file, 0, SEEK_SET);
-        firmware = new uint8_t[firmSize];
-        fread(firmware, sizeof(uint8_t), firmSize, file);
-        fclose(file);
+    // Load the firmware through the asset cache if the file exists, so other cores can share it
+    std::string &path = core->dsiMode ? core->config.dsiFirmPath : core->config.ndsFirmPath;
+    Asset asset = AssetCache::load(path);
+    if (asset.data) {
+        firmSize = asset.size;
+        firmData = asset.data;
+        firmware = firmData.get();
 
         if (core->id > 0) {
+            // Make a private copy of the firmware before changing it
+            firmware = new uint8_t[firmSize];
+            memcpy(firmware, firmData.get(), firmSize);
+            firmData.reset(firmware, std::default_delete<uint8_t[]>());
+
             // Increment the MAC address based on the instance ID
             // This allows instances to be detected as separate systems
             firmware[0x3B] += core->id;
@@ -91,8 +97,8 @@ bool Spi::loadFirmware() {
 
     // Create a basic, non-bootable firmware if one isn't provided
     firmSize = 0x20000;
-    firmware = new uint8_t[firmSize];
-    memset(firmware, 0, firmSize);
+    firmware = new uint8_t[firmSize]();
+    firmData.reset(firmware, std::default_delete<uint8_t[]>());
 
     // Set some firmware header data
     firmware[0x20] = 0xC0; // User settings offset / 8, byte 1
@@ -187,15 +193,17 @@ void Spi::setTouch(int x, int y) {
     if (x < 1) x = 1; else if (x > 254) x = 254;
     if (y < 1) y = 1; else if (y > 190) y = 190;
 
-    // Convert the coordinates to ADC values
-    if (scrX2 - scrX1 != 0) touchX = (x - (scrX1 - 1)) * (adcX2 - adcX1) / (scrX2 - scrX1) + adcX1;
-    if (scrY2 - scrY1 != 0) touchY = (y - (scrY1 - 1)) * (adcY2 - adcY1) / (scrY2 - scrY1) + adcY1;
+    // Convert the coordinates to ADC values and pass them on as input
+    uint16_t adcX = core->input.getHostState().touchX;
+    uint16_t adcY = core->input.getHostState().touchY;
+    if (scrX2 - scrX1 != 0) adcX = (x - (scrX1 - 1)) * (adcX2 - adcX1) / (scrX2 - scrX1) + adcX1;
+    if (scrY2 - scrY1 != 0) adcY = (y - (scrY1 - 1)) * (adcY2 - adcY1) / (scrY2 - scrY1) + adcY1;
+    core->input.setTouch(adcX, adcY);
 }
 
 void Spi::clearTouch() {
     // Set the ADC values to their default state
-    touchX = 0x000;
-    touchY = 0xFFF;
+    core->input.setTouch(0x000, 0xFFF);
 }
 
 void Spi::sendMicData(const int16_t* samples, size_t count, size_t rate) {
@@ -21,6 +21,7 @@
 
 #include <cstdint>
 #include <cstdio>
+#include <memory>
 #include <mutex>
 
 enum Language {
@@ -33,6 +34,7 @@ enum Language {
 };
 
 class Core;
+class StateBuffer;
 
 class Spi {
 public:
@@ -42,9 +44,10 @@ public:
     Spi(Core *core): core(core) {}
     ~Spi();
 
-    void saveState(FILE *file);
-    void loadState(FILE *file);
+    void saveState(StateBuffer *buffer);
+    void loadState(StateBuffer *buffer);
 
+    void inherit(Spi &parent);
     bool loadFirmware();
     void directBoot();
 
@@ -65,6 +68,7 @@ private:
 
     static Language language;
     uint8_t *firmware = nullptr;
+    std::shared_ptr<uint8_t> firmData;
     size_t firmSize = 0;
 
     int16_t *micBuffer = nullptr;
@@ -19,9 +19,19 @@
 
 #include <chrono>
 #include <cstring>
+#include <thread>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
 
 #include "../core.h"
 
+const int Spu::batchSize;
+const uint32_t Spu::ringSize;
+
 const int Spu::indexTable[] = {
     -1, -1, -1, -1, 2, 4, 6, 8
 };
@@ -37,168 +47,246 @@ const int16_t Spu::adpcmTable[] = {
     0x5771, 0x602F, 0x69CE, 0x7462, 0x7FFF
 };
 
-Spu::Spu(Core *core): core(core) {
-    // Mark the buffer as not ready
-    ready.store(false);
-}
-
-Spu::~Spu() {
-    // Free the buffers
-    delete[] bufferIn;
-    delete[] bufferOut;
-}
-
-void Spu::saveState(FILE *file) {
-    // Write state data to the file
-    fwrite(&gbaFrameSequencer, sizeof(gbaFrameSequencer), 1, file);
-    fwrite(gbaSoundTimers, 4, sizeof(gbaSoundTimers) / 4, file);
-    fwrite(gbaEnvelopes, 1, sizeof(gbaEnvelopes), file);
-    fwrite(gbaEnvTimers, 1, sizeof(gbaEnvTimers), file);
-    fwrite(&gbaSweepTimer, sizeof(gbaSweepTimer), 1, file);
-    fwrite(&gbaWaveDigit, sizeof(gbaWaveDigit), 1, file);
-    fwrite(&gbaNoiseValue, sizeof(gbaNoiseValue), 1, file);
-    fwrite(gbaWaveRam, 1, sizeof(gbaWaveRam), file);
-    fwrite(&gbaSampleA, sizeof(gbaSampleA), 1, file);
-    fwrite(&gbaSampleB, sizeof(gbaSampleB), 1, file);
-    fwrite(&enabled, sizeof(enabled), 1, file);
-    fwrite(adpcmValue, 4, sizeof(adpcmValue) / 4, file);
-    fwrite(adpcmLoopValue, 4, sizeof(adpcmLoopValue) / 4, file);
-    fwrite(adpcmIndex, 1, sizeof(adpcmIndex), file);
-    fwrite(adpcmLoopIndex, 1, sizeof(adpcmLoopIndex), file);
-    fwrite(adpcmToggle, sizeof(bool), sizeof(adpcmToggle) / sizeof(bool), file);
-    fwrite(dutyCycles, 1, sizeof(dutyCycles), file);
-    fwrite(noiseValues, 2, sizeof(noiseValues) / 2, file);
-    fwrite(soundCurrent, 4, sizeof(soundCurrent) / 4, file);
-    fwrite(soundTimers, 2, sizeof(soundTimers) / 2, file);
-    fwrite(sndCapCurrent, 4, sizeof(sndCapCurrent) / 4, file);
-    fwrite(sndCapTimers, 2, sizeof(sndCapTimers) / 2, file);
-    fwrite(gbaSoundCntL, 1, sizeof(gbaSoundCntL), file);
-    fwrite(gbaSoundCntH, 2, sizeof(gbaSoundCntH) / 2, file);
-    fwrite(gbaSoundCntX, 2, sizeof(gbaSoundCntX) / 2, file);
-    fwrite(&gbaMainSoundCntL, sizeof(gbaMainSoundCntL), 1, file);
-    fwrite(&gbaMainSoundCntH, sizeof(gbaMainSoundCntH), 1, file);
-    fwrite(&gbaMainSoundCntX, sizeof(gbaMainSoundCntX), 1, file);
-    fwrite(&gbaSoundBias, sizeof(gbaSoundBias), 1, file);
-    fwrite(soundCnt, 4, sizeof(soundCnt) / 4, file);
-    fwrite(soundSad, 4, sizeof(soundSad) / 4, file);
-    fwrite(soundTmr, 2, sizeof(soundTmr) / 2, file);
-    fwrite(soundPnt, 2, sizeof(soundPnt) / 2, file);
-    fwrite(soundLen, 4, sizeof(soundLen) / 4, file);
-    fwrite(&mainSoundCnt, sizeof(mainSoundCnt), 1, file);
-    fwrite(&soundBias, sizeof(soundBias), 1, file);
-    fwrite(sndCapCnt, 1, sizeof(sndCapCnt), file);
-    fwrite(sndCapDad, 4, sizeof(sndCapDad) / 4, file);
-    fwrite(sndCapLen, 2, sizeof(sndCapLen) / 2, file);
-    SaveStates::writeFifo(gbaFifos[0], file);
-    SaveStates::writeFifo(gbaFifos[1], file);
-}
-
-void Spu::loadState(FILE *file) {
-    // Read state data from the file
-    fread(&gbaFrameSequencer, sizeof(gbaFrameSequencer), 1, file);
-    fread(gbaSoundTimers, 4, sizeof(gbaSoundTimers) / 4, file);
-    fread(gbaEnvelopes, 1, sizeof(gbaEnvelopes), file);
-    fread(gbaEnvTimers, 1, sizeof(gbaEnvTimers), file);
-    fread(&gbaSweepTimer, sizeof(gbaSweepTimer), 1, file);
-    fread(&gbaWaveDigit, sizeof(gbaWaveDigit), 1, file);
-    fread(&gbaNoiseValue, sizeof(gbaNoiseValue), 1, file);
-    fread(gbaWaveRam, 1, sizeof(gbaWaveRam), file);
-    fread(&gbaSampleA, sizeof(gbaSampleA), 1, file);
-    fread(&gbaSampleB, sizeof(gbaSampleB), 1, file);
-    fread(&enabled, sizeof(enabled), 1, file);
-    fread(adpcmValue, 4, sizeof(adpcmValue) / 4, file);
-    fread(adpcmLoopValue, 4, sizeof(adpcmLoopValue) / 4, file);
-    fread(adpcmIndex, 1, sizeof(adpcmIndex), file);
-    fread(adpcmLoopIndex, 1, sizeof(adpcmLoopIndex), file);
-    fread(adpcmToggle, sizeof(bool), sizeof(adpcmToggle) / sizeof(bool), file);
-    fread(dutyCycles, 1, sizeof(dutyCycles), file);
-    fread(noiseValues, 2, sizeof(noiseValues) / 2, file);
-    fread(soundCurrent, 4, sizeof(soundCurrent) / 4, file);
-    fread(soundTimers, 2, sizeof(soundTimers) / 2, file);
-    fread(sndCapCurrent, 4, sizeof(sndCapCurrent) / 4, file);
-    fread(sndCapTimers, 2, sizeof(sndCapTimers) / 2, file);
-    fread(gbaSoundCntL, 1, sizeof(gbaSoundCntL), file);
-    fread(gbaSoundCntH, 2, sizeof(gbaSoundCntH) / 2, file);
-    fread(gbaSoundCntX, 2, sizeof(gbaSoundCntX) / 2, file);
-    fread(&gbaMainSoundCntL, sizeof(gbaMainSoundCntL), 1, file);
-    fread(&gbaMainSoundCntH, sizeof(gbaMainSoundCntH), 1, file);
-    fread(&gbaMainSoundCntX, sizeof(gbaMainSoundCntX), 1, file);
-    fread(&gbaSoundBias, sizeof(gbaSoundBias), 1, file);
-    fread(soundCnt, 4, sizeof(soundCnt) / 4, file);
-    fread(soundSad, 4, sizeof(soundSad) / 4, file);
-    fread(soundTmr, 2, sizeof(soundTmr) / 2, file);
-    fread(soundPnt, 2, sizeof(soundPnt) / 2, file);
-    fread(soundLen, 4, sizeof(soundLen) / 4, file);
-    fread(&mainSoundCnt, sizeof(mainSoundCnt), 1, file);
-    fread(&soundBias, sizeof(soundBias), 1, file);
-    fread(sndCapCnt, 1, sizeof(sndCapCnt), file);
-    fread(sndCapDad, 4, sizeof(sndCapDad) / 4, file);
-    fread(sndCapLen, 2, sizeof(sndCapLen) / 2, file);
-    SaveStates::readFifo(gbaFifos[0], file);
-    SaveStates::readFifo(gbaFifos[1], file);
-}
-
-uint32_t *Spu::getSamples(int count) {
-    // Initialize the buffers
-    if (bufferSize != count) {
-        delete[] bufferIn;
-        delete[] bufferOut;
-        bufferIn = new uint32_t[count];
-        bufferOut = new uint32_t[count];
-        bufferSize = count;
-        bufferPointer = 0;
+static FORCE_INLINE void accumulate(int32_t *mixer, const int32_t *data, int count) {
+    // Add a batch of channel samples to the mixer, using vector instructions where available
+    int i = 0;
+#if defined(__SSE2__)
+    for (; i + 4 <= count; i += 4) {
+        __m128i sum = _mm_add_epi32(_mm_loadu_si128((__m128i*)&mixer[i]), _mm_loadu_si128((const __m128i*)&data[i]));
+        _mm_storeu_si128((__m128i*)&mixer[i], sum);
     }
+#elif defined(__ARM_NEON)
+    for (; i + 4 <= count; i += 4)
+        vst1q_s32(&mixer[i], vaddq_s32(vld1q_s32(&mixer[i]), vld1q_s32(&data[i])));
+#endif
+    for (; i < count; i++)
+        mixer[i] += data[i];
+}
 
-    bool wait;
+Spu::Spu(Core *core): core(core) {
+    // Start with an empty sample buffer
+    ringRead.store(0);
+    ringWrite.store(0);
+    ringLimit.store(0);
+    underruns.store(0);
+}
 
-    // If FPS limit is enabled, try to wait until the buffer is filled
-    // If the emulation isn't full speed, waiting would starve the audio buffer
-    // So if it's taking too long, just let it play an empty buffer
-    if (Settings::fpsLimiter == 2) { // Accurate
-        std::chrono::steady_clock::time_point waitTime = std::chrono::steady_clock::now();
-        wait = false;
+void Spu::saveState(StateBuffer *buffer) {
+    // Write state data to the buffer
+    buffer->write(&gbaFrameSequencer, sizeof(gbaFrameSequencer), 1);
+    buffer->write(gbaSoundTimers, 4, sizeof(gbaSoundTimers) / 4);
+    buffer->write(gbaEnvelopes, 1, sizeof(gbaEnvelopes));
+    buffer->write(gbaEnvTimers, 1, sizeof(gbaEnvTimers));
+    buffer->write(&gbaSweepTimer, sizeof(gbaSweepTimer), 1);
+    buffer->write(&gbaWaveDigit, sizeof(gbaWaveDigit), 1);
+    buffer->write(&gbaNoiseValue, sizeof(gbaNoiseValue), 1);
+    buffer->write(gbaWaveRam, 1, sizeof(gbaWaveRam));
+    buffer->write(&gbaSampleA, sizeof(gbaSampleA), 1);
+    buffer->write(&gbaSampleB, sizeof(gbaSampleB), 1);
+    buffer->write(&enabled, sizeof(enabled), 1);
+    buffer->write(adpcmValue, 4, sizeof(adpcmValue) / 4);
+    buffer->write(adpcmLoopValue, 4, sizeof(adpcmLoopValue) / 4);
+    buffer->write(adpcmIndex, 1, sizeof(adpcmIndex));
+    buffer->write(adpcmLoopIndex, 1, sizeof(adpcmLoopIndex));
+    buffer->write(adpcmToggle, sizeof(bool), sizeof(adpcmToggle) / sizeof(bool));
+    buffer->write(dutyCycles, 1, sizeof(dutyCycles));
+    buffer->write(noiseValues, 2, sizeof(noiseValues) / 2);
+    buffer->write(soundCurrent, 4, sizeof(soundCurrent) / 4);
+    buffer->write(soundTimers, 2, sizeof(soundTimers) / 2);
+    buffer->write(sndCapCurrent, 4, sizeof(sndCapCurrent) / 4);
+    buffer->write(sndCapTimers, 2, sizeof(sndCapTimers) / 2);
+    buffer->write(gbaSoundCntL, 1, sizeof(gbaSoundCntL));
+    buffer->write(gbaSoundCntH, 2, sizeof(gbaSoundCntH) / 2);
+    buffer->write(gbaSoundCntX, 2, sizeof(gbaSoundCntX) / 2);
+    buffer->write(&gbaMainSoundCntL, sizeof(gbaMainSoundCntL), 1);
+    buffer->write(&gbaMainSoundCntH, sizeof(gbaMainSoundCntH), 1);
+    buffer->write(&gbaMainSoundCntX, sizeof(gbaMainSoundCntX), 1);
+    buffer->write(&gbaSoundBias, sizeof(gbaSoundBias), 1);
+    buffer->write(soundCnt, 4, sizeof(soundCnt) / 4);
+    buffer->write(soundSad, 4, sizeof(soundSad) / 4);
+    buffer->write(soundTmr, 2, sizeof(soundTmr) / 2);
+    buffer->write(soundPnt, 2, sizeof(soundPnt) / 2);
+    buffer->write(soundLen, 4, sizeof(soundLen) / 4);
+    buffer->write(&mainSoundCnt, sizeof(mainSoundCnt), 1);
+    buffer->write(&soundBias, sizeof(soundBias), 1);
+    buffer->write(sndCapCnt, 1, sizeof(sndCapCnt));
+    buffer->write(sndCapDad, 4, sizeof(sndCapDad) / 4);
+    buffer->write(sndCapLen, 2, sizeof(sndCapLen) / 2);
+    buffer->write(&lastCycles, sizeof(lastCycles), 1);
+    buffer->write(&endCycles, sizeof(endCycles), 1);
+    buffer->write(&scheduled, sizeof(scheduled), 1);
+    SaveStates::writeFifo(gbaFifos[0], buffer);
+    SaveStates::writeFifo(gbaFifos[1], buffer);
+}
 
-        // Use a while loop to constantly check if the wait condition has been satisfied
-        // This is wasteful, but ensures a swift break from the wait state
-        while (!ready.load()) {
-            if (std::chrono::steady_clock::now() - waitTime > std::chrono::microseconds(1000000 / 60)) {
-                wait = true;
-                break;
-            }
-        }
+void Spu::loadState(StateBuffer *buffer) {
+    // Read state data from the buffer
+    buffer->read(&gbaFrameSequencer, sizeof(gbaFrameSequencer), 1);
+    buffer->read(gbaSoundTimers, 4, sizeof(gbaSoundTimers) / 4);
+    buffer->read(gbaEnvelopes, 1, sizeof(gbaEnvelopes));
+    buffer->read(gbaEnvTimers, 1, sizeof(gbaEnvTimers));
+    buffer->read(&gbaSweepTimer, sizeof(gbaSweepTimer), 1);
+    buffer->read(&gbaWaveDigit, sizeof(gbaWaveDigit), 1);
+    buffer->read(&gbaNoiseValue, sizeof(gbaNoiseValue), 1);
+    buffer->read(gbaWaveRam, 1, sizeof(gbaWaveRam));
+    buffer->read(&gbaSampleA, sizeof(gbaSampleA), 1);
+    buffer->read(&gbaSampleB, sizeof(gbaSampleB), 1);
+    buffer->read(&enabled, sizeof(enabled), 1);
+    buffer->read(adpcmValue, 4, sizeof(adpcmValue) / 4);
+    buffer->read(adpcmLoopValue, 4, sizeof(adpcmLoopValue) / 4);
+    buffer->read(adpcmIndex, 1, sizeof(adpcmIndex));
+    buffer->read(adpcmLoopIndex, 1, sizeof(adpcmLoopIndex));
+    buffer->read(adpcmToggle, sizeof(bool), sizeof(adpcmToggle) / sizeof(bool));
+    buffer->read(dutyCycles, 1, sizeof(dutyCycles));
+    buffer->read(noiseValues, 2, sizeof(noiseValues) / 2);
+    buffer->read(soundCurrent, 4, sizeof(soundCurrent) / 4);
+    buffer->read(soundTimers, 2, sizeof(soundTimers) / 2);
+    buffer->read(sndCapCurrent, 4, sizeof(sndCapCurrent) / 4);
+    buffer->read(sndCapTimers, 2, sizeof(sndCapTimers) / 2);
+    buffer->read(gbaSoundCntL, 1, sizeof(gbaSoundCntL));
+    buffer->read(gbaSoundCntH, 2, sizeof(gbaSoundCntH) / 2);
+    buffer->read(gbaSoundCntX, 2, sizeof(gbaSoundCntX) / 2);
+    buffer->read(&gbaMainSoundCntL, sizeof(gbaMainSoundCntL), 1);
+    buffer->read(&gbaMainSoundCntH, sizeof(gbaMainSoundCntH), 1);
+    buffer->read(&gbaMainSoundCntX, sizeof(gbaMainSoundCntX), 1);
+    buffer->read(&gbaSoundBias, sizeof(gbaSoundBias), 1);
+    buffer->read(soundCnt, 4, sizeof(soundCnt) / 4);
+    buffer->read(soundSad, 4, sizeof(soundSad) / 4);
+    buffer->read(soundTmr, 2, sizeof(soundTmr) / 2);
+    buffer->read(soundPnt, 2, sizeof(soundPnt) / 2);
+    buffer->read(soundLen, 4, sizeof(soundLen) / 4);
+    buffer->read(&mainSoundCnt, sizeof(mainSoundCnt), 1);
+    buffer->read(&soundBias, sizeof(soundBias), 1);
+    buffer->read(sndCapCnt, 1, sizeof(sndCapCnt));
+    buffer->read(sndCapDad, 4, sizeof(sndCapDad) / 4);
+    buffer->read(sndCapLen, 2, sizeof(sndCapLen) / 2);
+    buffer->read(&lastCycles, sizeof(lastCycles), 1);
+    buffer->read(&endCycles, sizeof(endCycles), 1);
+    buffer->read(&scheduled, sizeof(scheduled), 1);
+    SaveStates::readFifo(gbaFifos[0], buffer);
+    SaveStates::readFifo(gbaFifos[1], buffer);
+}
+
+int Spu::readSamples(int16_t *dst, int count) {
+    // Let up to two reads worth of samples queue before throttling, similar to double buffering
+    // Requests larger than the ring can only be partly filled from it, with the rest padded below
+    int limit = std::min<int>(count, (int)ringSize);
+    ringLimit.store(std::min<uint32_t>(limit * 2, ringSize), std::memory_order_relaxed);
+
+    // Copy as many samples as are available into the output as signed 16-bit stereo
+    uint32_t read = ringRead.load(std::memory_order_relaxed);
+    int avail = std::min<int>(limit, ringWrite.load(std::memory_order_acquire) - read);
+    for (int i = 0; i < avail; i++) {
+        uint32_t sample = ring[(read + i) & (ringSize - 1)];
+        dst[i * 2 + 0] = sample >> 0;
+        dst[i * 2 + 1] = sample >> 16;
     }
-    else { // Disabled/Light
-        // Use a condition variable to save CPU cycles
-        // This might take longer than expected due to the OS scheduler and other factors
-        std::unique_lock<std::mutex> lock(mutex2);
-        wait = !cond2.wait_for(lock, std::chrono::microseconds(1000000 / 60), [&]{ return ready.load(); });
+
+    // Release the read samples back to the emulator
+    if (avail > 0) {
+        lastSample = ring[(read + avail - 1) & (ringSize - 1)];
+        ringRead.store(read + avail, std::memory_order_release);
     }
 
-    uint32_t *out = new uint32_t[count];
-    
-    if (wait) {
-        // Fill the output buffer with the last played sample to prevent crackles when running slow
-        for (int i = 0; i < count; i++)
-            out[i] = bufferOut[count - 1];
+    // Fill the rest with the last played sample to prevent crackles when running slow
+    for (int i = avail; i < count; i++) {
+        dst[i * 2 + 0] = lastSample >> 0;
+        dst[i * 2 + 1] = lastSample >> 16;
     }
-    else {
-        // Fill the output buffer with new data
-        memcpy(out, bufferOut, count * sizeof(uint32_t));
+
+    // Keep track of samples that weren't ready in time
+    if (avail < count)
+        underruns.fetch_add(count - avail, std::memory_order_relaxed);
+    return avail;
+}
+
+int Spu::readSamples(int16_t *dst, int count, int rate) {
+    // Read directly if no resampling is needed
+    if (rate == 32768)
+        return readSamples(dst, count);
+
+    // Update the resampling filter if the rate changed
+    if (resampleRate != rate) {
+        resampler.setRates(32768, rate);
+        resampleRate = rate;
     }
 
-    { // Signal that the buffer was played
-        std::lock_guard<std::mutex> guard(mutex1);
-        ready.store(false);
-        cond1.notify_one();
+    // Let up to two reads worth of input samples queue before throttling
+    uint32_t needed = (uint64_t)count * 32768 / rate + 1;
+    uint32_t limit = std::min<uint32_t>(needed * 2, ringSize);
+    ringLimit.store(limit, std::memory_order_relaxed);
+
+    // Adjust the resampling step slightly to keep the buffer around its target level
+    // This absorbs jitter in emulation speed without running dry or throttling unevenly
+    uint32_t read = ringRead.load(std::memory_order_relaxed);
+    uint32_t avail = ringWrite.load(std::memory_order_acquire) - read;
+    int32_t target = limit * 3 / 4;
+    double error = std::max(-1.0, std::min(1.0, ((int32_t)avail - target) / (double)target));
+    uint32_t step = 32768.0 * 0x10000 / rate * (1.0 + error * 0.005);
+
+    // Generate output samples, pulling input samples from the buffer as the position advances
+    uint32_t used = 0, missing = 0;
+    int real = 0;
+    for (int i = 0; i < count; i++) {
+        for (; resamplePos >= 0x10000; resamplePos -= 0x10000) {
+            if (used < avail)
+                lastSample = ring[(read + used++) & (ringSize - 1)];
+            else
+                missing++;
+            resampler.push(lastSample);
+        }
+
+        // Filter a sample at the current position
+        uint32_t sample = resampler.filter(resamplePos, core->config.audioResample);
+        dst[i * 2 + 0] = sample >> 0;
+        dst[i * 2 + 1] = sample >> 16;
+        resamplePos += step;
+        if (!missing) real++;
     }
 
-    return out;
+    // Release the read samples back to the emulator and keep track of any that weren't ready
+    ringRead.store(read + used, std::memory_order_release);
+    if (missing)
+        underruns.fetch_add(missing, std::memory_order_relaxed);
+    return real;
+}
+
+void Spu::scheduleInit() {
+    // Start sample timing from the current cycle and schedule the first event
+    lastCycles = core->globalCycles;
+    scheduled = false;
+    scheduleNext();
+}
+
+void Spu::scheduleNext() {
+    // Only use events in lazy mode when sound capture needs its data on time
+    bool capture = !core->gbaMode && ((sndCapCnt[0] | sndCapCnt[1]) & BIT(7));
+    scheduled = (!core->config.lazyAudio || capture);
+    if (!scheduled) return;
+
+    // Schedule the next sample, or batch of samples if nothing depends on their timing
+    // Sound capture feeds mixer output back into memory, so mix one sample at a time while it's active
+    endCycles = lastCycles + (core->gbaMode ? 512 : ((capture ? 1 : batchSize) * 512 * 2));
+    core->schedule(core->gbaMode ? GBA_SPU_SAMPLE : NDS_SPU_SAMPLE, endCycles - core->globalCycles);
+}
+
+void Spu::endFrame() {
+    // Mix all pending samples, and restart events in case lazy mode was turned off
+    catchUp();
+    if (!scheduled)
+        scheduleNext();
 }
 
 void Spu::runGbaSample() {
-    // Push a dummy sample if disabled and schedule the next one
-    core->schedule(GBA_SPU_SAMPLE, 512);
-    if (!Settings::emulateAudio) return pushSample(0, 0);
+    // Ignore outdated events and mix all samples that are due
+    if (core->globalCycles != endCycles) return;
+    catchUp();
+    scheduleNext();
+}
+
+void Spu::mixGbaSample() {
+    // Push a dummy sample if disabled
+    if (!core->config.emulateAudio) return pushSample(0, 0);
 
     // Generate an audio sample
     int32_t sampleLeft = 0, sampleRight = 0;
@@ -424,284 +512,354 @@ void Spu::runGbaSample() {
 }
 
 void Spu::runSample() {
-    // Push a dummy sample if disabled and schedule the next one
-    core->schedule(NDS_SPU_SAMPLE, 512 * 2);
-    if (!Settings::emulateAudio) return pushSample(0, 0);
+    // Ignore outdated events from before the batch size changed
+    if (core->globalCycles != endCycles) return;
 
-    // Mix the sound channels
-    int64_t mixerLeft = 0, mixerRight = 0;
-    int64_t channelsLeft[2] = {}, channelsRight[2] = {};
-    for (int i = 0; enabled >> i; i++) {
-        // Skip disabled channels
-        if (!(enabled & BIT(i))) continue;
-        uint8_t format = (soundCnt[i] >> 29) & 0x3;
-        int64_t data = 0;
+    // Mix all samples that are due and schedule the next batch
+    catchUp();
+    scheduleNext();
+}
+
+void Spu::catchUp() {
+    core->perfTimers.enter(PERF_SPU);
+    core->tracer.begin("SPU mix", TRACK_EMU, (core->globalCycles - lastCycles) >> (core->gbaMode ? 9 : 10));
+    if (core->gbaMode) {
+        // Mix GBA samples up to the current cycle, one at a time
+        uint32_t count = (core->globalCycles - lastCycles) / 512;
+        lastCycles += count * 512;
+        while (count--)
+            mixGbaSample();
+    }
+    else {
+        // Mix NDS samples up to the current cycle, in batches
+        // The SPU runs at 16756991Hz with a sample rate of 32768Hz
+        // 16756991 / 32768 = ~512 cycles per sample, or 1024 system cycles
+        uint32_t count = (core->globalCycles - lastCycles) / (512 * 2);
+        lastCycles += count * 512 * 2;
+        for (; count > 0; count -= std::min<uint32_t>(count, batchSize))
+            mixSamples(std::min<uint32_t>(count, batchSize));
+    }
+    core->tracer.end();
+    core->perfTimers.leave();
+}
+
+void Spu::resetCycles() {
+    // Adjust the sample cycles for a global cycle reset
+    lastCycles -= core->globalCycles;
+    endCycles -= core->globalCycles;
+}
+
+FORCE_INLINE void Spu::stepChannel(int channel, int format) {
+    // Increment the timer for the length of a sample
+    // The SPU runs at 16756991Hz with a sample rate of 32768Hz
+    // 16756991 / 32768 = ~512 cycles per sample
+    soundTimers[channel] += 512;
+    bool overflow = (soundTimers[channel] < 512);
+
+    // Handle timer overflow
+    while (overflow) {
+        // Reload the timer
+        soundTimers[channel] += soundTmr[channel];
+        overflow = (soundTimers[channel] < soundTmr[channel]);
 
-        // Read the sample data
         switch (format) {
-        case 0: // PCM8
-            data = (int8_t)core->memory.read<uint8_t>(1, soundCurrent[i]) << 8;
+        case 0: case 1: // PCM8/PCM16
+            // Increment the data pointer by the size of one sample
+            soundCurrent[channel] += 1 + format;
             break;
 
-        case 1: // PCM16
-            data = (int16_t)core->memory.read<uint16_t>(1, soundCurrent[i]);
-            break;
+        case 2: { // ADPCM
+            // Save the ADPCM values at the loop position
+            if (soundCurrent[channel] == soundSad[channel] + soundPnt[channel] * 4 && !adpcmToggle[channel]) {
+                adpcmLoopValue[channel] = adpcmValue[channel];
+                adpcmLoopIndex[channel] = adpcmIndex[channel];
+            }
+
+            // Get the 4-bit ADPCM data
+            uint8_t adpcmData = core->memory.read<uint8_t>(1, soundCurrent[channel]);
+            adpcmData = adpcmToggle[channel] ? ((adpcmData & 0xF0) >> 4) : (adpcmData & 0x0F);
+
+            // Calculate the sample difference
+            int32_t diff = adpcmTable[adpcmIndex[channel]] / 8;
+            if (adpcmData & BIT(0)) diff += adpcmTable[adpcmIndex[channel]] / 4;
+            if (adpcmData & BIT(1)) diff += adpcmTable[adpcmIndex[channel]] / 2;
+            if (adpcmData & BIT(2)) diff += adpcmTable[adpcmIndex[channel]] / 1;
+
+            // Apply the sample difference to the sample
+            if (adpcmData & BIT(3)) {
+                adpcmValue[channel] += diff;
+                if (adpcmValue[channel] > 0x7FFF) adpcmValue[channel] = 0x7FFF;
+            }
+            else {
+                adpcmValue[channel] -= diff;
+                if (adpcmValue[channel] < -0x7FFF) adpcmValue[channel] = -0x7FFF;
+            }
+
+            // Calculate the next index
+            adpcmIndex[channel] += indexTable[adpcmData & 0x7];
+            if (adpcmIndex[channel] < 0) adpcmIndex[channel] = 0;
+            if (adpcmIndex[channel] > 88) adpcmIndex[channel] = 88;
+
+            // Move to the next 4-bit ADPCM data
+            adpcmToggle[channel] = !adpcmToggle[channel];
+            if (!adpcmToggle[channel]) soundCurrent[channel]++;
 
-        case 2: // ADPCM
-            data = adpcmValue[i];
             break;
+        }
 
         case 3: // Pulse/Noise
-            if (i >= 8 && i <= 13) { // Pulse waves
-                // Set the sample to low or high depending on the position in the duty cycle
-                uint8_t duty = 7 - ((soundCnt[i] & 0x07000000) >> 24);
-                data = (dutyCycles[i - 8] < duty) ? -0x7FFF : 0x7FFF;
+            if (channel >= 8 && channel <= 13) { // Pulse waves
+                // Increment the duty cycle counter
+                dutyCycles[channel - 8] = (dutyCycles[channel - 8] + 1) % 8;
             }
-            else if (i >= 14) { // Noise
-                // Set the sample to low or high depending on the carry bit (saved as bit 15)
-                data = (noiseValues[i - 14] & BIT(15)) ? -0x7FFF : 0x7FFF;
+            else if (channel >= 14) { // Noise
+                // Clear the previous saved carry bit
+                noiseValues[channel - 14] &= ~BIT(15);
+
+                // Advance the random generator and save the carry bit to bit 15
+                if (noiseValues[channel - 14] & BIT(0))
+                    noiseValues[channel - 14] = BIT(15) | ((noiseValues[channel - 14] >> 1) ^ 0x6000);
+                else
+                    noiseValues[channel - 14] >>= 1;
             }
             break;
         }
 
-        // Increment the timer for the length of a sample
-        // The SPU runs at 16756991Hz with a sample rate of 32768Hz
-        // 16756991 / 32768 = ~512 cycles per sample
-        soundTimers[i] += 512;
-        bool overflow = (soundTimers[i] < 512);
-
-        // Handle timer overflow
-        while (overflow) {
-            // Reload the timer
-            soundTimers[i] += soundTmr[i];
-            overflow = (soundTimers[i] < soundTmr[i]);
+        // Repeat or end the sound if the end of the data is reached
+        uint32_t end = soundSad[channel] + (soundPnt[channel] + soundLen[channel]) * 4;
+        if (format != 3 && soundCurrent[channel] >= end) {
+            if ((soundCnt[channel] & 0x18000000) >> 27 == 1) { // Loop infinite
+                soundCurrent[channel] = soundSad[channel] + soundPnt[channel] * 4;
+
+                // Restore the ADPCM values from the loop position
+                if (format == 2) {
+                    adpcmValue[channel] = adpcmLoopValue[channel];
+                    adpcmIndex[channel] = adpcmLoopIndex[channel];
+                    adpcmToggle[channel] = false;
+                }
+            }
+            else { // One-shot
+                soundCnt[channel] &= ~BIT(31);
+                enabled &= ~BIT(channel);
+                return;
+            }
+        }
+    }
+}
 
-            switch (format) {
-            case 0: case 1: // PCM8/PCM16
-                // Increment the data pointer by the size of one sample
-                soundCurrent[i] += 1 + format;
-                break;
+void Spu::skipSamples(int count) {
+    // Advance the sound channels without mixing or output, keeping their state the same as when mixing
+    for (int i = 0; enabled >> i; i++) {
+        if (!(enabled & BIT(i))) continue;
+        uint8_t format = (soundCnt[i] >> 29) & 0x3;
+        for (int j = 0; j < count && (enabled & BIT(i)); j++)
+            stepChannel(i, format);
+    }
+}
 
-            case 2: { // ADPCM
-                // Save the ADPCM values at the loop position
-                if (soundCurrent[i] == soundSad[i] + soundPnt[i] * 4 && !adpcmToggle[i]) {
-                    adpcmLoopValue[i] = adpcmValue[i];
-                    adpcmLoopIndex[i] = adpcmIndex[i];
-                }
+void Spu::mixSamples(int count) {
+    // Push dummy samples if disabled
+    if (!core->config.emulateAudio) {
+        for (int j = 0; j < count; j++)
+            pushSample(0, 0);
+        return;
+    }
 
-                // Get the 4-bit ADPCM data
-                uint8_t adpcmData = core->memory.read<uint8_t>(1, soundCurrent[i]);
-                adpcmData = adpcmToggle[i] ? ((adpcmData & 0xF0) >> 4) : (adpcmData & 0x0F);
+    // Skip mixing in turbo mode, unless sound capture needs the mixer output
+    if (core->turbo.isActive() && !((sndCapCnt[0] | sndCapCnt[1]) & BIT(7)))
+        return skipSamples(count);
 
-                // Calculate the sample difference
-                int32_t diff = adpcmTable[adpcmIndex[i]] / 8;
-                if (adpcmData & BIT(0)) diff += adpcmTable[adpcmIndex[i]] / 4;
-                if (adpcmData & BIT(1)) diff += adpcmTable[adpcmIndex[i]] / 2;
-                if (adpcmData & BIT(2)) diff += adpcmTable[adpcmIndex[i]] / 1;
+    // Mix the sound channels, generating a batch of samples for each channel at a time
+    int32_t mixerLeft[batchSize] = {}, mixerRight[batchSize] = {};
+    int32_t channelsLeft[2][batchSize] = {}, channelsRight[2][batchSize] = {};
+    int32_t dataLeft[batchSize], dataRight[batchSize];
+    for (int i = 0; enabled >> i; i++) {
+        // Skip disabled channels
+        if (!(enabled & BIT(i))) continue;
+        uint8_t format = (soundCnt[i] >> 29) & 0x3;
 
-                // Apply the sample difference to the sample
-                if (adpcmData & BIT(3)) {
-                    adpcmValue[i] += diff;
-                    if (adpcmValue[i] > 0x7FFF) adpcmValue[i] = 0x7FFF;
-                }
-                else {
-                    adpcmValue[i] -= diff;
-                    if (adpcmValue[i] < -0x7FFF) adpcmValue[i] = -0x7FFF;
-                }
+        for (int j = 0; j < count; j++) {
+            // Output silence for the rest of the batch if a one-shot sound ended
+            if (!(enabled & BIT(i))) {
+                dataLeft[j] = dataRight[j] = 0;
+                continue;
+            }
+            int64_t data = 0;
 
-                // Calculate the next index
-                adpcmIndex[i] += indexTable[adpcmData & 0x7];
-                if (adpcmIndex[i] < 0) adpcmIndex[i] = 0;
-                if (adpcmIndex[i] > 88) adpcmIndex[i] = 88;
+            // Read the sample data
+            switch (format) {
+            case 0: // PCM8
+                data = (int8_t)core->memory.read<uint8_t>(1, soundCurrent[i]) << 8;
+                break;
 
-                // Move to the next 4-bit ADPCM data
-                adpcmToggle[i] = !adpcmToggle[i];
-                if (!adpcmToggle[i]) soundCurrent[i]++;
+            case 1: // PCM16
+                data = (int16_t)core->memory.read<uint16_t>(1, soundCurrent[i]);
+                break;
 
+            case 2: // ADPCM
+                data = adpcmValue[i];
                 break;
-            }
 
             case 3: // Pulse/Noise
                 if (i >= 8 && i <= 13) { // Pulse waves
-                    // Increment the duty cycle counter
-                    dutyCycles[i - 8] = (dutyCycles[i - 8] + 1) % 8;
+                    // Set the sample to low or high depending on the position in the duty cycle
+                    uint8_t duty = 7 - ((soundCnt[i] & 0x07000000) >> 24);
+                    data = (dutyCycles[i - 8] < duty) ? -0x7FFF : 0x7FFF;
                 }
                 else if (i >= 14) { // Noise
-                    // Clear the previous saved carry bit
-                    noiseValues[i - 14] &= ~BIT(15);
-
-                    // Advance the random generator and save the carry bit to bit 15
-                    if (noiseValues[i - 14] & BIT(0))
-                        noiseValues[i - 14] = BIT(15) | ((noiseValues[i - 14] >> 1) ^ 0x6000);
-                    else
-                        noiseValues[i - 14] >>= 1;
+                    // Set the sample to low or high depending on the carry bit (saved as bit 15)
+                    data = (noiseValues[i - 14] & BIT(15)) ? -0x7FFF : 0x7FFF;
                 }
                 break;
             }
 
-            // Repeat or end the sound if the end of the data is reached
-            if (format != 3 && soundCurrent[i] >= soundSad[i] + (soundPnt[i] + soundLen[i]) * 4) {
-                if ((soundCnt[i] & 0x18000000) >> 27 == 1) { // Loop infinite
-                    soundCurrent[i] = soundSad[i] + soundPnt[i] * 4;
-
-                    // Restore the ADPCM values from the loop position
-                    if (format == 2) {
-                        adpcmValue[i] = adpcmLoopValue[i];
-                        adpcmIndex[i] = adpcmLoopIndex[i];
-                        adpcmToggle[i] = false;
-                    }
-                }
-                else { // One-shot
-                    soundCnt[i] &= ~BIT(31);
-                    enabled &= ~BIT(i);
-                    break;
-                }
-            }
+            // Advance the channel by a sample
+            stepChannel(i, format);
+
+            // Apply the volume divider
+            // The sample now has 4 fractional bits
+            int divShift = (soundCnt[i] & 0x00000300) >> 8;
+            if (divShift == 3) divShift++;
+            data <<= 4 - divShift;
+
+            // Apply the volume factor
+            // The sample now has 11 fractional bits
+            int mulFactor = (soundCnt[i] & 0x0000007F);
+            if (mulFactor == 127) mulFactor++;
+            data = (data << 7) * mulFactor / 128;
+
+            // Apply panning
+            // The samples are now rounded to 8 fractional bits
+            int panValue = (soundCnt[i] & 0x007F0000) >> 16;
+            if (panValue == 127) panValue++;
+            dataLeft[j] = (data * (128 - panValue) / 128) >> 3;
+            dataRight[j] = (data * panValue / 128) >> 3;
         }
 
-        // Apply the volume divider
-        // The sample now has 4 fractional bits
-        int divShift = (soundCnt[i] & 0x00000300) >> 8;
-        if (divShift == 3) divShift++;
-        data <<= 4 - divShift;
-
-        // Apply the volume factor
-        // The sample now has 11 fractional bits
-        int mulFactor = (soundCnt[i] & 0x0000007F);
-        if (mulFactor == 127) mulFactor++;
-        data = (data << 7) * mulFactor / 128;
-
-        // Apply panning
-        // The samples are now rounded to 8 fractional bits
-        int panValue = (soundCnt[i] & 0x007F0000) >> 16;
-        if (panValue == 127) panValue++;
-        int64_t dataLeft = (data * (128 - panValue) / 128) >> 3;
-        int64_t dataRight = (data * panValue / 128) >> 3;
-
         // Redirect channels 1 and 3 if enabled
         if (i == 1 || i == 3) {
-            channelsLeft[i >> 1] = dataLeft;
-            channelsRight[i >> 1] = dataRight;
+            memcpy(channelsLeft[i >> 1], dataLeft, count * sizeof(int32_t));
+            memcpy(channelsRight[i >> 1], dataRight, count * sizeof(int32_t));
             if (mainSoundCnt & BIT(12 + (i >> 1)))
                 continue;
         }
 
         // Add the channel to the mixer
-        mixerLeft += dataLeft;
-        mixerRight += dataRight;
+        accumulate(mixerLeft, dataLeft, count);
+        accumulate(mixerRight, dataRight, count);
     }
 
-    // Capture sound
-    for (int i = 0; i < 2; i++) {
-        // Skip disabled capture channels
-        if (!(sndCapCnt[i] & BIT(7)))
-            continue;
-
-        // Increment the timer for the length of a sample
-        sndCapTimers[i] += 512;
-        bool overflow = (sndCapTimers[i] < 512);
-
-        // Handle timer overflow
-        while (overflow) {
-            // Reload the timer
-            sndCapTimers[i] += soundTmr[1 + (i << 1)];
-            overflow = (sndCapTimers[i] < soundTmr[1 + (i << 1)]);
-
-            // Get a sample from the mixer, clamped to be within range
-            int64_t sample = ((i == 0) ? mixerLeft : mixerRight);
-            if (sample > 0x7FFFFF) sample = 0x7FFFFF;
-            if (sample < -0x800000) sample = -0x800000;
-
-            // Write a sample to the buffer
-            if (sndCapCnt[i] & BIT(3)) { // PCM8
-                core->memory.write<uint8_t>(1, sndCapCurrent[i], sample >> 16);
-                sndCapCurrent[i]++;
-            }
-            else { // PCM16
-                core->memory.write<uint16_t>(1, sndCapCurrent[i], sample >> 8);
-                sndCapCurrent[i] += 2;
-            }
+    // Capture and output each sample in the batch
+    for (int j = 0; j < count; j++) {
+        // Capture sound
+        for (int i = 0; i < 2; i++) {
+            // Skip disabled capture channels
+            if (!(sndCapCnt[i] & BIT(7)))
+                continue;
 
-            // Repeat or end the capture if the end of the buffer is reached
-            if (sndCapCurrent[i] >= sndCapDad[i] + sndCapLen[i] * 4) {
-                if (sndCapCnt[i] & BIT(2)) { // One-shot
-                    sndCapCnt[i] &= ~BIT(7);
-                    continue;
+            // Increment the timer for the length of a sample
+            sndCapTimers[i] += 512;
+            bool overflow = (sndCapTimers[i] < 512);
+
+            // Handle timer overflow
+            while (overflow) {
+                // Reload the timer
+                sndCapTimers[i] += soundTmr[1 + (i << 1)];
+                overflow = (sndCapTimers[i] < soundTmr[1 + (i << 1)]);
+
+                // Get a sample from the mixer, clamped to be within range
+                int64_t sample = ((i == 0) ? mixerLeft[j] : mixerRight[j]);
+                if (sample > 0x7FFFFF) sample = 0x7FFFFF;
+                if (sample < -0x800000) sample = -0x800000;
+
+                // Write a sample to the buffer
+                if (sndCapCnt[i] & BIT(3)) { // PCM8
+                    core->memory.write<uint8_t>(1, sndCapCurrent[i], sample >> 16);
+                    sndCapCurrent[i]++;
+                }
+                else { // PCM16
+                    core->memory.write<uint16_t>(1, sndCapCurrent[i], sample >> 8);
+                    sndCapCurrent[i] += 2;
                 }
-                else { // Loop
-                    sndCapCurrent[i] = sndCapDad[i];
+
+                // Repeat or end the capture if the end of the buffer is reached
+                if (sndCapCurrent[i] >= sndCapDad[i] + sndCapLen[i] * 4) {
+                    if (sndCapCnt[i] & BIT(2)) { // One-shot
+                        sndCapCnt[i] &= ~BIT(7);
+                        continue;
+                    }
+                    else { // Loop
+                        sndCapCurrent[i] = sndCapDad[i];
+                    }
                 }
             }
         }
-    }
 
-    // Get the left output sample
-    int64_t sampleLeft;
-    switch ((mainSoundCnt & 0x0300) >> 8) { // Left output selection
-        case 0: sampleLeft = mixerLeft; break; // Mixer
-        case 1: sampleLeft = channelsLeft[0]; break; // Channel 1
-        case 2: sampleLeft = channelsLeft[1]; break; // Channel 3
-        case 3: sampleLeft = channelsLeft[0] + channelsLeft[1]; break; // Channel 1 + 3
-    }
+        // Get the left output sample
+        int64_t sampleLeft;
+        switch ((mainSoundCnt & 0x0300) >> 8) { // Left output selection
+            case 0: sampleLeft = mixerLeft[j]; break; // Mixer
+            case 1: sampleLeft = channelsLeft[0][j]; break; // Channel 1
+            case 2: sampleLeft = channelsLeft[1][j]; break; // Channel 3
+            case 3: sampleLeft = channelsLeft[0][j] + channelsLeft[1][j]; break; // Channel 1 + 3
+        }
 
-    // Get the right output sample
-    int64_t sampleRight;
-    switch ((mainSoundCnt & 0x0C00) >> 10) { // Right output selection
-        case 0: sampleRight = mixerRight; break; // Mixer
-        case 1: sampleRight = channelsRight[0]; break; // Channel 1
-        case 2: sampleRight = channelsRight[1]; break; // Channel 3
-        case 3: sampleRight = channelsRight[0] + channelsRight[1]; break; // Channel 1 + 3
-    }
+        // Get the right output sample
+        int64_t sampleRight;
+        switch ((mainSoundCnt & 0x0C00) >> 10) { // Right output selection
+            case 0: sampleRight = mixerRight[j]; break; // Mixer
+            case 1: sampleRight = channelsRight[0][j]; break; // Channel 1
+            case 2: sampleRight = channelsRight[1][j]; break; // Channel 3
+            case 3: sampleRight = channelsRight[0][j] + channelsRight[1][j]; break; // Channel 1 + 3
+        }
 
-    // Apply the master volume
-    // The samples are now rounded to no fractional bits
-    int masterVol = (mainSoundCnt & 0x007F);
-    if (masterVol == 127) masterVol++;
-    sampleLeft = (sampleLeft * masterVol / 128) >> 8;
-    sampleRight = (sampleRight * masterVol / 128) >> 8;
-
-    // Process samples depending on audio settings
-    if (Settings::audio16Bit) {
-        // Apply sound bias and clipping, and convert to signed 16-bit
-        sampleLeft = (std::max(0, std::min<int32_t>(0xFFFF, sampleLeft + (soundBias << 6))) - 0x8000);
-        sampleRight = (std::max(0, std::min<int32_t>(0xFFFF, sampleRight + (soundBias << 6))) - 0x8000);
-    }
-    else {
-        // Convert to 10-bit, apply sound bias and clipping, and expand to signed 16-bit
-        sampleLeft = (std::max(0, std::min<int32_t>(0x3FF, (sampleLeft >> 6) + soundBias)) - 0x200) << 6;
-        sampleRight = (std::max(0, std::min<int32_t>(0x3FF, (sampleRight >> 6) + soundBias)) - 0x200) << 6;
+        // Apply the master volume
+        // The samples are now rounded to no fractional bits
+        int masterVol = (mainSoundCnt & 0x007F);
+        if (masterVol == 127) masterVol++;
+        sampleLeft = (sampleLeft * masterVol / 128) >> 8;
+        sampleRight = (sampleRight * masterVol / 128) >> 8;
+
+        // Process samples depending on audio settings
+        if (core->config.audio16Bit) {
+            // Apply sound bias and clipping, and convert to signed 16-bit
+            sampleLeft = (std::max(0, std::min<int32_t>(0xFFFF, sampleLeft + (soundBias << 6))) - 0x8000);
+            sampleRight = (std::max(0, std::min<int32_t>(0xFFFF, sampleRight + (soundBias << 6))) - 0x8000);
+        }
+        else {
+            // Convert to 10-bit, apply sound bias and clipping, and expand to signed 16-bit
+            sampleLeft = (std::max(0, std::min<int32_t>(0x3FF, (sampleLeft >> 6) + soundBias)) - 0x200) << 6;
+            sampleRight = (std::max(0, std::min<int32_t>(0x3FF, (sampleRight >> 6) + soundBias)) - 0x200) << 6;
+        }
+        pushSample(sampleLeft, sampleRight);
     }
-    pushSample(sampleLeft, sampleRight);
 }
 
 void Spu::pushSample(int16_t sampleLeft, int16_t sampleRight) {
-    // Write the samples to the buffer
-    if (!bufferSize) return;
-    bufferIn[bufferPointer++] = (sampleRight << 16) | (sampleLeft & 0xFFFF);
-    if (bufferPointer != bufferSize) return;
-
-    // Wait until the buffer has been played, keeping the emulator throttled to 60 FPS
+    // Wait until there's room in the buffer, keeping the emulator throttled to 60 FPS
     // Synchronizing to the audio eliminites the potential for nasty audio crackles
-    if (Settings::fpsLimiter == 2) { // Accurate
+    // Nothing waits until the frontend starts reading, and the audio thread never waits on this side
+    uint32_t write = ringWrite.load(std::memory_order_relaxed);
+    uint32_t limit = ringLimit.load(std::memory_order_relaxed);
+    if (core->config.fpsLimiter && limit && write - ringRead.load(std::memory_order_acquire) >= limit) {
         std::chrono::steady_clock::time_point waitTime = std::chrono::steady_clock::now();
-        while (ready.load() && std::chrono::steady_clock::now() - waitTime <= std::chrono::microseconds(1000000));
-    }
-    else if (Settings::fpsLimiter == 1) { // Light
-        std::unique_lock<std::mutex> lock(mutex1);
-        cond1.wait_for(lock, std::chrono::microseconds(1000000), [&]{ return !ready.load(); });
+        while (write - ringRead.load(std::memory_order_acquire) >= limit &&
+            std::chrono::steady_clock::now() - waitTime <= std::chrono::microseconds(1000000)) {
+            // Sleep between checks in light mode to save CPU cycles
+            if (core->config.fpsLimiter == 1)
+                std::this_thread::sleep_for(std::chrono::microseconds(500));
+        }
     }
 
-    // Swap the buffers
-    SWAP(bufferOut, bufferIn);
+    // Hash the output if requested, including samples that end up dropped
+    uint32_t sample = (sampleRight << 16) | (sampleLeft & 0xFFFF);
+    if (hashing)
+        sampleHash = (sampleHash ^ sample) * 0x01000193;
 
-    { // Signal that the buffer is ready to play
-        std::lock_guard<std::mutex> guard(mutex2);
-        ready.store(true);
-        cond2.notify_one();
-    }
-
-    // Reset the buffer pointer
-    bufferPointer = 0;
+    // Write the samples to the buffer, dropping them if it's full
+    if (write - ringRead.load(std::memory_order_acquire) >= ringSize) return;
+    ring[write & (ringSize - 1)] = sample;
+    ringWrite.store(write + 1, std::memory_order_release);
 }
 
 void Spu::startChannel(int channel) {
@@ -735,6 +893,9 @@ void Spu::startChannel(int channel) {
 }
 
 void Spu::gbaFifoTimer(int timer) {
+    // Mix pending samples with the current FIFO values before they change
+    catchUp();
+
     if (((gbaMainSoundCntH & BIT(10)) >> 10) == timer) { // FIFO A
         // Get a new sample
         if (!gbaFifos[0].empty()) {
@@ -761,6 +922,9 @@ void Spu::gbaFifoTimer(int timer) {
 }
 
 void Spu::writeGbaSoundCntL(int channel, uint8_t value) {
+    // Mix pending samples so the write takes effect at the right time
+    catchUp();
+
     // Write to one of the GBA SOUNDCNT_L registers
     if (!(gbaMainSoundCntX & BIT(7))) return;
     uint8_t mask = (channel == 0) ? 0x7F : 0xE0;
@@ -768,6 +932,9 @@ void Spu::writeGbaSoundCntL(int channel, uint8_t value) {
 }
 
 void Spu::writeGbaSoundCntH(int channel, uint16_t mask, uint16_t value) {
+    // Mix pending samples so the write takes effect at the right time
+    catchUp();
+
     // Write to one of the GBA SOUNDCNT_H registers
     if (!(gbaMainSoundCntX & BIT(7))) return;
     switch (channel) {
@@ -778,13 +945,16 @@ void Spu::writeGbaSoundCntH(int channel, uint16_t mask, uint16_t value) {
 }
 
 void Spu::writeGbaSoundCntX(int channel, uint16_t mask, uint16_t value) {
+    // Mix pending samples so the write takes effect at the right time
+    catchUp();
+
     // Write to one of the GBA SOUNDCNT_X registers
     if (!(gbaMainSoundCntX & BIT(7))) return;
     mask &= (channel == 3) ? 0x40FF : 0x47FF;
     gbaSoundCntX[channel] = (gbaSoundCntX[channel] & ~mask) | (value & mask);
 
     // Restart the channel if audio emulation is enabled
-    if (!Settings::emulateAudio || !(value & BIT(15))) return;
+    if (!core->config.emulateAudio || !(value & BIT(15))) return;
     gbaMainSoundCntX |= BIT(channel);
     if (channel < 2) { // Tone
         if (channel == 0) gbaSweepTimer = (gbaSoundCntL[0] & 0x70) >> 4;
@@ -808,6 +978,9 @@ void Spu::writeGbaSoundCntX(int channel, uint16_t mask, uint16_t value) {
 }
 
 void Spu::writeGbaMainSoundCntL(uint16_t mask, uint16_t value) {
+    // Mix pending samples so the write takes effect at the right time
+    catchUp();
+
     // Write to the main GBA SOUNDCNT_L register
     if (!(gbaMainSoundCntX & BIT(7))) return;
     mask &= 0xFF77;
@@ -815,6 +988,9 @@ void Spu::writeGbaMainSoundCntL(uint16_t mask, uint16_t value) {
 }
 
 void Spu::writeGbaMainSoundCntH(uint16_t mask, uint16_t value) {
+    // Mix pending samples so the write takes effect at the right time
+    catchUp();
+
     // Write to the main GBA SOUNDCNT_H register
     mask &= 0x770F;
     gbaMainSoundCntH = (gbaMainSoundCntH & ~mask) | (value & mask);
@@ -833,6 +1009,9 @@ void Spu::writeGbaMainSoundCntH(uint16_t mask, uint16_t value) {
 }
 
 void Spu::writeGbaMainSoundCntX(uint8_t value) {
+    // Mix pending samples so the write takes effect at the right time
+    catchUp();
+
     // Write to the main GBA SOUNDCNT_X register
     gbaMainSoundCntX = (gbaMainSoundCntX & ~0x80) | (value & 0x80);
 
@@ -850,12 +1029,18 @@ void Spu::writeGbaMainSoundCntX(uint8_t value) {
 }
 
 void Spu::writeGbaSoundBias(uint16_t mask, uint16_t value) {
+    // Mix pending samples so the write takes effect at the right time
+    catchUp();
+
     // Write to the GBA SOUNDBIAS register
     mask &= 0xC3FE;
     gbaSoundBias = (gbaSoundBias & ~mask) | (value & mask);
 }
 
 void Spu::writeGbaWaveRam(int index, uint8_t value) {
+    // Mix pending samples so the write takes effect at the right time
+    catchUp();
+
     // Write to the currently inactive GBA wave RAM bank
     gbaWaveRam[!(gbaSoundCntL[1] & BIT(6))][index] = value;
 }
@@ -875,8 +1060,11 @@ void Spu::writeGbaFifoB(uint32_t mask, uint32_t value) {
 }
 
 void Spu::writeSoundCnt(int channel, uint32_t mask, uint32_t value) {
+    // Mix pending samples so the write takes effect at the right time
+    catchUp();
+
     // Prevent channels from starting if audio emulation is disabled
-    if (!Settings::emulateAudio) value &= ~BIT(31);
+    if (!core->config.emulateAudio) value &= ~BIT(31);
     bool enable = (!(soundCnt[channel] & BIT(31)) && (value & mask & BIT(31)));
 
     // Write to one of the SOUNDCNT registers
@@ -891,6 +1079,9 @@ void Spu::writeSoundCnt(int channel, uint32_t mask, uint32_t value) {
 }
 
 void Spu::writeSoundSad(int channel, uint32_t mask, uint32_t value) {
+    // Mix pending samples so the write takes effect at the right time
+    catchUp();
+
     // Write to one of the SOUNDSAD registers
     mask &= 0x07FFFFFC;
     soundSad[channel] = (soundSad[channel] & ~mask) | (value & mask);
@@ -905,22 +1096,34 @@ void Spu::writeSoundSad(int channel, uint32_t mask, uint32_t value) {
 }
 
 void Spu::writeSoundTmr(int channel, uint16_t mask, uint16_t value) {
+    // Mix pending samples so the write takes effect at the right time
+    catchUp();
+
     // Write to one of the SOUNDTMR registers
     soundTmr[channel] = (soundTmr[channel] & ~mask) | (value & mask);
 }
 
 void Spu::writeSoundPnt(int channel, uint16_t mask, uint16_t value) {
+    // Mix pending samples so the write takes effect at the right time
+    catchUp();
+
     // Write to one of the SOUNDPNT registers
     soundPnt[channel] = (soundPnt[channel] & ~mask) | (value & mask);
 }
 
 void Spu::writeSoundLen(int channel, uint32_t mask, uint32_t value) {
+    // Mix pending samples so the write takes effect at the right time
+    catchUp();
+
     // Write to one of the SOUNDLEN registers
     mask &= 0x003FFFFF;
     soundLen[channel] = (soundLen[channel] & ~mask) | (value & mask);
 }
 
 void Spu::writeMainSoundCnt(uint16_t mask, uint16_t value) {
+    // Mix pending samples so the write takes effect at the right time
+    catchUp();
+
     // Write to the main SOUNDCNT register
     bool enable = (!(mainSoundCnt & BIT(15)) && (value & BIT(15)));
     mask &= 0xBF7F;
@@ -940,12 +1143,18 @@ void Spu::writeMainSoundCnt(uint16_t mask, uint16_t value) {
 }
 
 void Spu::writeSoundBias(uint16_t mask, uint16_t value) {
+    // Mix pending samples so the write takes effect at the right time
+    catchUp();
+
     // Write to the SOUNDBIAS register
     mask &= 0x03FF;
     soundBias = (soundBias & ~mask) | (value & mask);
 }
 
 void Spu::writeSndCapCnt(int channel, uint8_t value) {
+    // Mix pending samples so the write takes effect at the right time
+    catchUp();
+
     // Start the capture if the enable bit changes from 0 to 1
     if (!(sndCapCnt[channel] & BIT(7)) && (value & BIT(7))) {
         sndCapCurrent[channel] = sndCapDad[channel];
@@ -954,9 +1163,19 @@ void Spu::writeSndCapCnt(int channel, uint8_t value) {
 
     // Write to one of the SNDCAPCNT registers
     sndCapCnt[channel] = (value & 0x8F);
+
+    // Switch to mixing one sample at a time if a capture starts during a batch or in lazy mode
+    if ((sndCapCnt[channel] & BIT(7)) && (!scheduled || endCycles - lastCycles > 512 * 2)) {
+        endCycles = lastCycles + 512 * 2;
+        scheduled = true;
+        core->schedule(NDS_SPU_SAMPLE, endCycles - core->globalCycles);
+    }
 }
 
 void Spu::writeSndCapDad(int channel, uint32_t mask, uint32_t value) {
+    // Mix pending samples so the write takes effect at the right time
+    catchUp();
+
     // Write to one of the SNDCAPDAD registers
     mask &= 0x07FFFFFC;
     sndCapDad[channel] = (sndCapDad[channel] & ~mask) | (value & mask);
@@ -967,23 +1186,35 @@ void Spu::writeSndCapDad(int channel, uint32_t mask, uint32_t value) {
 }
 
 void Spu::writeSndCapLen(int channel, uint16_t mask, uint16_t value) {
+    // Mix pending samples so the write takes effect at the right time
+    catchUp();
+
     // Write to one of the SNDCAPLEN registers
     sndCapLen[channel] = (sndCapLen[channel] & ~mask) | (value & mask);
 }
 
 uint8_t Spu::readGbaSoundCntL(int channel) {
+    // Mix pending samples so channel state is up to date
+    catchUp();
+
     // Read from one of the GBA SOUNDCNT_L registers
     // There are only two of these, on channels 0 and 2
     return gbaSoundCntL[channel / 2];
 }
 
 uint16_t Spu::readGbaSoundCntH(int channel) {
+    // Mix pending samples so channel state is up to date
+    catchUp();
+
     // Read from one of the GBA SOUNDCNT_H registers
     // The sound length is write-only, so mask it out
     return gbaSoundCntH[channel] & ~((channel == 2) ? 0x00FF : 0x003F);
 
 }
 uint16_t Spu::readGbaSoundCntX(int channel) {
+    // Mix pending samples so channel state is up to date
+    catchUp();
+
     // Read from one of the GBA SOUNDCNT_X registers
     // The frequency is write-only, so mask it out
     return gbaSoundCntX[channel] & ~((channel == 3) ? 0x0000 : 0x07FF);
@@ -20,25 +20,33 @@
 #pragma once
 
 #include <atomic>
-#include <condition_variable>
 #include <cstdint>
 #include <cstdio>
 #include <queue>
-#include <mutex>
+
+#include "resampler.h"
 
 class Core;
+class StateBuffer;
 
 class Spu {
 public:
     Spu(Core *core);
-    ~Spu();
-
-    void saveState(FILE *file);
-    void loadState(FILE *file);
 
-    uint32_t *getSamples(int count);
+    void saveState(StateBuffer *buffer);
+    void loadState(StateBuffer *buffer);
+
+    int readSamples(int16_t *dst, int count);
+    int readSamples(int16_t *dst, int count, int rate);
+    uint32_t getUnderruns() { return underruns.load(); }
+    int getAvailable() { return ringWrite.load(std::memory_order_acquire) - ringRead.load(std::memory_order_relaxed); }
+    void setHashing(bool value) { hashing = value; sampleHash = 0x811C9DC5; }
+    uint32_t takeHash() { uint32_t hash = sampleHash; sampleHash = 0x811C9DC5; return hash; }
+    void scheduleInit();
+    void endFrame();
     void runGbaSample();
     void runSample();
+    void resetCycles();
     void gbaFifoTimer(int timer);
 
     uint8_t readGbaSoundCntL(int channel);
@@ -46,14 +54,14 @@ public:
     uint16_t readGbaSoundCntX(int channel);
     uint16_t readGbaMainSoundCntL() { return gbaMainSoundCntL; }
     uint16_t readGbaMainSoundCntH() { return gbaMainSoundCntH; }
-    uint8_t readGbaMainSoundCntX() { return gbaMainSoundCntX; }
+    uint8_t readGbaMainSoundCntX() { catchUp(); return gbaMainSoundCntX; }
     uint16_t readGbaSoundBias() { return gbaSoundBias; }
     uint8_t readGbaWaveRam(int index);
 
-    uint32_t readSoundCnt(int channel) { return soundCnt[channel]; }
+    uint32_t readSoundCnt(int channel) { catchUp(); return soundCnt[channel]; }
     uint16_t readMainSoundCnt() { return mainSoundCnt; }
     uint16_t readSoundBias() { return soundBias; }
-    uint8_t readSndCapCnt(int channel) { return sndCapCnt[channel]; }
+    uint8_t readSndCapCnt(int channel) { catchUp(); return sndCapCnt[channel]; }
     uint32_t readSndCapDad(int channel) { return sndCapDad[channel]; }
 
     void writeGbaSoundCntL(int channel, uint8_t value);
@@ -81,12 +89,17 @@ public:
 private:
     Core *core;
 
-    uint32_t *bufferIn = nullptr, *bufferOut = nullptr;
-    uint32_t bufferSize = 0, bufferPointer = 0;
-
-    std::condition_variable cond1, cond2;
-    std::mutex mutex1, mutex2;
-    std::atomic<bool> ready;
+    static const uint32_t ringSize = 0x1000;
+    uint32_t ring[ringSize] = {};
+    uint32_t lastSample = 0;
+    Resampler resampler;
+    int resampleRate = 0;
+    uint32_t resamplePos = 0;
+    std::atomic<uint32_t> ringRead, ringWrite;
+    std::atomic<uint32_t> ringLimit;
+    std::atomic<uint32_t> underruns;
+    uint32_t sampleHash = 0;
+    bool hashing = false;
 
     int16_t gbaFrameSequencer = 0;
     int32_t gbaSoundTimers[4] = {};
@@ -100,6 +113,11 @@ private:
     std::deque<int8_t> gbaFifos[2];
     int8_t gbaSampleA = 0, gbaSampleB = 0;
 
+    static const int batchSize = 16;
+    uint32_t lastCycles = 0;
+    uint32_t endCycles = 0;
+    bool scheduled = false;
+
     uint16_t enabled = 0;
 
     static const int indexTable[8];
@@ -135,6 +153,12 @@ private:
     uint32_t sndCapDad[2] = {};
     uint16_t sndCapLen[2] = {};
 
+    void scheduleNext();
+    void catchUp();
+    void mixGbaSample();
+    void stepChannel(int channel, int format);
+    void skipSamples(int count);
+    void mixSamples(int count);
     void pushSample(int16_t sampleLeft, int16_t sampleRight);
     void startChannel(int channel);
 };
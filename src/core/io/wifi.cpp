@@ -29,100 +29,100 @@ Wifi::Wifi(Core *core): core(core) {
     bbRegisters[0x64] = 0xFF;
 }
 
-void Wifi::saveState(FILE *file) {
-    // Write state data to the file
-    fwrite(&scheduled, sizeof(scheduled), 1, file);
-    fwrite(&wModeWep, sizeof(wModeWep), 1, file);
-    fwrite(&wTxstatCnt, sizeof(wTxstatCnt), 1, file);
-    fwrite(&wIrf, sizeof(wIrf), 1, file);
-    fwrite(&wIe, sizeof(wIe), 1, file);
-    fwrite(wMacaddr, 2, sizeof(wMacaddr) / 2, file);
-    fwrite(wBssid, 2, sizeof(wBssid) / 2, file);
-    fwrite(&wAidFull, sizeof(wAidFull), 1, file);
-    fwrite(&wRxcnt, sizeof(wRxcnt), 1, file);
-    fwrite(&wPowerstate, sizeof(wPowerstate), 1, file);
-    fwrite(&wPowerforce, sizeof(wPowerforce), 1, file);
-    fwrite(&wRxbufBegin, sizeof(wRxbufBegin), 1, file);
-    fwrite(&wRxbufEnd, sizeof(wRxbufEnd), 1, file);
-    fwrite(&wRxbufWrcsr, sizeof(wRxbufWrcsr), 1, file);
-    fwrite(&wRxbufWrAddr, sizeof(wRxbufWrAddr), 1, file);
-    fwrite(&wRxbufRdAddr, sizeof(wRxbufRdAddr), 1, file);
-    fwrite(&wRxbufReadcsr, sizeof(wRxbufReadcsr), 1, file);
-    fwrite(&wRxbufGap, sizeof(wRxbufGap), 1, file);
-    fwrite(&wRxbufGapdisp, sizeof(wRxbufGapdisp), 1, file);
-    fwrite(wTxbufLoc, 2, sizeof(wTxbufLoc) / 2, file);
-    fwrite(&wBeaconInt, sizeof(wBeaconInt), 1, file);
-    fwrite(&wTxbufReply1, sizeof(wTxbufReply1), 1, file);
-    fwrite(&wTxbufReply2, sizeof(wTxbufReply2), 1, file);
-    fwrite(&wTxreqRead, sizeof(wTxreqRead), 1, file);
-    fwrite(&wTxstat, sizeof(wTxstat), 1, file);
-    fwrite(&wUsCountcnt, sizeof(wUsCountcnt), 1, file);
-    fwrite(&wUsComparecnt, sizeof(wUsComparecnt), 1, file);
-    fwrite(&wCmdCountcnt, sizeof(wCmdCountcnt), 1, file);
-    fwrite(&wUsCompare, sizeof(wUsCompare), 1, file);
-    fwrite(&wUsCount, sizeof(wUsCount), 1, file);
-    fwrite(&wPreBeacon, sizeof(wPreBeacon), 1, file);
-    fwrite(&wCmdCount, sizeof(wCmdCount), 1, file);
-    fwrite(&wBeaconCount, sizeof(wBeaconCount), 1, file);
-    fwrite(&wRxbufCount, sizeof(wRxbufCount), 1, file);
-    fwrite(&wTxbufWrAddr, sizeof(wTxbufWrAddr), 1, file);
-    fwrite(&wTxbufCount, sizeof(wTxbufCount), 1, file);
-    fwrite(&wTxbufGap, sizeof(wTxbufGap), 1, file);
-    fwrite(&wTxbufGapdisp, sizeof(wTxbufGapdisp), 1, file);
-    fwrite(&wPostBeacon, sizeof(wPostBeacon), 1, file);
-    fwrite(&wBbWrite, sizeof(wBbWrite), 1, file);
-    fwrite(&wBbRead, sizeof(wBbRead), 1, file);
-    fwrite(&wTxSeqno, sizeof(wTxSeqno), 1, file);
-    fwrite(bbRegisters, 1, sizeof(bbRegisters), file);
-    fwrite(wConfig, 2, sizeof(wConfig) / 2, file);
-}
-
-void Wifi::loadState(FILE *file) {
-    // Read state data from the file
-    fread(&scheduled, sizeof(scheduled), 1, file);
-    fread(&wModeWep, sizeof(wModeWep), 1, file);
-    fread(&wTxstatCnt, sizeof(wTxstatCnt), 1, file);
-    fread(&wIrf, sizeof(wIrf), 1, file);
-    fread(&wIe, sizeof(wIe), 1, file);
-    fread(wMacaddr, 2, sizeof(wMacaddr) / 2, file);
-    fread(wBssid, 2, sizeof(wBssid) / 2, file);
-    fread(&wAidFull, sizeof(wAidFull), 1, file);
-    fread(&wRxcnt, sizeof(wRxcnt), 1, file);
-    fread(&wPowerstate, sizeof(wPowerstate), 1, file);
-    fread(&wPowerforce, sizeof(wPowerforce), 1, file);
-    fread(&wRxbufBegin, sizeof(wRxbufBegin), 1, file);
-    fread(&wRxbufEnd, sizeof(wRxbufEnd), 1, file);
-    fread(&wRxbufWrcsr, sizeof(wRxbufWrcsr), 1, file);
-    fread(&wRxbufWrAddr, sizeof(wRxbufWrAddr), 1, file);
-    fread(&wRxbufRdAddr, sizeof(wRxbufRdAddr), 1, file);
-    fread(&wRxbufReadcsr, sizeof(wRxbufReadcsr), 1, file);
-    fread(&wRxbufGap, sizeof(wRxbufGap), 1, file);
-    fread(&wRxbufGapdisp, sizeof(wRxbufGapdisp), 1, file);
-    fread(wTxbufLoc, 2, sizeof(wTxbufLoc) / 2, file);
-    fread(&wBeaconInt, sizeof(wBeaconInt), 1, file);
-    fread(&wTxbufReply1, sizeof(wTxbufReply1), 1, file);
-    fread(&wTxbufReply2, sizeof(wTxbufReply2), 1, file);
-    fread(&wTxreqRead, sizeof(wTxreqRead), 1, file);
-    fread(&wTxstat, sizeof(wTxstat), 1, file);
-    fread(&wUsCountcnt, sizeof(wUsCountcnt), 1, file);
-    fread(&wUsComparecnt, sizeof(wUsComparecnt), 1, file);
-    fread(&wCmdCountcnt, sizeof(wCmdCountcnt), 1, file);
-    fread(&wUsCompare, sizeof(wUsCompare), 1, file);
-    fread(&wUsCount, sizeof(wUsCount), 1, file);
-    fread(&wPreBeacon, sizeof(wPreBeacon), 1, file);
-    fread(&wCmdCount, sizeof(wCmdCount), 1, file);
-    fread(&wBeaconCount, sizeof(wBeaconCount), 1, file);
-    fread(&wRxbufCount, sizeof(wRxbufCount), 1, file);
-    fread(&wTxbufWrAddr, sizeof(wTxbufWrAddr), 1, file);
-    fread(&wTxbufCount, sizeof(wTxbufCount), 1, file);
-    fread(&wTxbufGap, sizeof(wTxbufGap), 1, file);
-    fread(&wTxbufGapdisp, sizeof(wTxbufGapdisp), 1, file);
-    fread(&wPostBeacon, sizeof(wPostBeacon), 1, file);
-    fread(&wBbWrite, sizeof(wBbWrite), 1, file);
-    fread(&wBbRead, sizeof(wBbRead), 1, file);
-    fread(&wTxSeqno, sizeof(wTxSeqno), 1, file);
-    fread(bbRegisters, 1, sizeof(bbRegisters), file);
-    fread(wConfig, 2, sizeof(wConfig) / 2, file);
+void Wifi::saveState(StateBuffer *buffer) {
+    // Write state data to the buffer
+    buffer->write(&scheduled, sizeof(scheduled), 1);
+    buffer->write(&wModeWep, sizeof(wModeWep), 1);
+    buffer->write(&wTxstatCnt, sizeof(wTxstatCnt), 1);
+    buffer->write(&wIrf, sizeof(wIrf), 1);
+    buffer->write(&wIe, sizeof(wIe), 1);
+    buffer->write(wMacaddr, 2, sizeof(wMacaddr) / 2);
+    buffer->write(wBssid, 2, sizeof(wBssid) / 2);
+    buffer->write(&wAidFull, sizeof(wAidFull), 1);
+    buffer->write(&wRxcnt, sizeof(wRxcnt), 1);
+    buffer->write(&wPowerstate, sizeof(wPowerstate), 1);
+    buffer->write(&wPowerforce, sizeof(wPowerforce), 1);
+    buffer->write(&wRxbufBegin, sizeof(wRxbufBegin), 1);
+    buffer->write(&wRxbufEnd, sizeof(wRxbufEnd), 1);
+    buffer->write(&wRxbufWrcsr, sizeof(wRxbufWrcsr), 1);
+    buffer->write(&wRxbufWrAddr, sizeof(wRxbufWrAddr), 1);
+    buffer->write(&wRxbufRdAddr, sizeof(wRxbufRdAddr), 1);
+    buffer->write(&wRxbufReadcsr, sizeof(wRxbufReadcsr), 1);
+    buffer->write(&wRxbufGap, sizeof(wRxbufGap), 1);
+    buffer->write(&wRxbufGapdisp, sizeof(wRxbufGapdisp), 1);
+    buffer->write(wTxbufLoc, 2, sizeof(wTxbufLoc) / 2);
+    buffer->write(&wBeaconInt, sizeof(wBeaconInt), 1);
+    buffer->write(&wTxbufReply1, sizeof(wTxbufReply1), 1);
+    buffer->write(&wTxbufReply2, sizeof(wTxbufReply2), 1);
+    buffer->write(&wTxreqRead, sizeof(wTxreqRead), 1);
+    buffer->write(&wTxstat, sizeof(wTxstat), 1);
+    buffer->write(&wUsCountcnt, sizeof(wUsCountcnt), 1);
+    buffer->write(&wUsComparecnt, sizeof(wUsComparecnt), 1);
+    buffer->write(&wCmdCountcnt, sizeof(wCmdCountcnt), 1);
+    buffer->write(&wUsCompare, sizeof(wUsCompare), 1);
+    buffer->write(&wUsCount, sizeof(wUsCount), 1);
+    buffer->write(&wPreBeacon, sizeof(wPreBeacon), 1);
+    buffer->write(&wCmdCount, sizeof(wCmdCount), 1);
+    buffer->write(&wBeaconCount, sizeof(wBeaconCount), 1);
+    buffer->write(&wRxbufCount, sizeof(wRxbufCount), 1);
+    buffer->write(&wTxbufWrAddr, sizeof(wTxbufWrAddr), 1);
+    buffer->write(&wTxbufCount, sizeof(wTxbufCount), 1);
+    buffer->write(&wTxbufGap, sizeof(wTxbufGap), 1);
+    buffer->write(&wTxbufGapdisp, sizeof(wTxbufGapdisp), 1);
+    buffer->write(&wPostBeacon, sizeof(wPostBeacon), 1);
+    buffer->write(&wBbWrite, sizeof(wBbWrite), 1);
+    buffer->write(&wBbRead, sizeof(wBbRead), 1);
+    buffer->write(&wTxSeqno, sizeof(wTxSeqno), 1);
+    buffer->write(bbRegisters, 1, sizeof(bbRegisters));
+    buffer->write(wConfig, 2, sizeof(wConfig) / 2);
+}
+
+void Wifi::loadState(StateBuffer *buffer) {
+    // Read state data from the buffer
+    buffer->read(&scheduled, sizeof(scheduled), 1);
+    buffer->read(&wModeWep, sizeof(wModeWep), 1);
+    buffer->read(&wTxstatCnt, sizeof(wTxstatCnt), 1);
+    buffer->read(&wIrf, sizeof(wIrf), 1);
+    buffer->read(&wIe, sizeof(wIe), 1);
+    buffer->read(wMacaddr, 2, sizeof(wMacaddr) / 2);
+    buffer->read(wBssid, 2, sizeof(wBssid) / 2);
+    buffer->read(&wAidFull, sizeof(wAidFull), 1);
+    buffer->read(&wRxcnt, sizeof(wRxcnt), 1);
+    buffer->read(&wPowerstate, sizeof(wPowerstate), 1);
+    buffer->read(&wPowerforce, sizeof(wPowerforce), 1);
+    buffer->read(&wRxbufBegin, sizeof(wRxbufBegin), 1);
+    buffer->read(&wRxbufEnd, sizeof(wRxbufEnd), 1);
+    buffer->read(&wRxbufWrcsr, sizeof(wRxbufWrcsr), 1);
+    buffer->read(&wRxbufWrAddr, sizeof(wRxbufWrAddr), 1);
+    buffer->read(&wRxbufRdAddr, sizeof(wRxbufRdAddr), 1);
+    buffer->read(&wRxbufReadcsr, sizeof(wRxbufReadcsr), 1);
+    buffer->read(&wRxbufGap, sizeof(wRxbufGap), 1);
+    buffer->read(&wRxbufGapdisp, sizeof(wRxbufGapdisp), 1);
+    buffer->read(wTxbufLoc, 2, sizeof(wTxbufLoc) / 2);
+    buffer->read(&wBeaconInt, sizeof(wBeaconInt), 1);
+    buffer->read(&wTxbufReply1, sizeof(wTxbufReply1), 1);
+    buffer->read(&wTxbufReply2, sizeof(wTxbufReply2), 1);
+    buffer->read(&wTxreqRead, sizeof(wTxreqRead), 1);
+    buffer->read(&wTxstat, sizeof(wTxstat), 1);
+    buffer->read(&wUsCountcnt, sizeof(wUsCountcnt), 1);
+    buffer->read(&wUsComparecnt, sizeof(wUsComparecnt), 1);
+    buffer->read(&wCmdCountcnt, sizeof(wCmdCountcnt), 1);
+    buffer->read(&wUsCompare, sizeof(wUsCompare), 1);
+    buffer->read(&wUsCount, sizeof(wUsCount), 1);
+    buffer->read(&wPreBeacon, sizeof(wPreBeacon), 1);
+    buffer->read(&wCmdCount, sizeof(wCmdCount), 1);
+    buffer->read(&wBeaconCount, sizeof(wBeaconCount), 1);
+    buffer->read(&wRxbufCount, sizeof(wRxbufCount), 1);
+    buffer->read(&wTxbufWrAddr, sizeof(wTxbufWrAddr), 1);
+    buffer->read(&wTxbufCount, sizeof(wTxbufCount), 1);
+    buffer->read(&wTxbufGap, sizeof(wTxbufGap), 1);
+    buffer->read(&wTxbufGapdisp, sizeof(wTxbufGapdisp), 1);
+    buffer->read(&wPostBeacon, sizeof(wPostBeacon), 1);
+    buffer->read(&wBbWrite, sizeof(wBbWrite), 1);
+    buffer->read(&wBbRead, sizeof(wBbRead), 1);
+    buffer->read(&wTxSeqno, sizeof(wTxSeqno), 1);
+    buffer->read(bbRegisters, 1, sizeof(bbRegisters));
+    buffer->read(wConfig, 2, sizeof(wConfig) / 2);
 }
 
 void Wifi::addConnection(Core *core) {
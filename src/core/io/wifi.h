@@ -25,6 +25,7 @@
 #include <vector>
 
 class Core;
+class StateBuffer;
 
 enum PacketType {
     LOC1_FRAME,
@@ -39,8 +40,8 @@ enum PacketType {
 class Wifi {
 public:
     Wifi(Core *core);
-    void saveState(FILE *file);
-    void loadState(FILE *file);
+    void saveState(StateBuffer *buffer);
+    void loadState(StateBuffer *buffer);
 
     void addConnection(Core *core);
     void remConnection(Core *core);
@@ -0,0 +1,154 @@
+/*
+    Copyright 2019-2026 Hydr8gon
+
+    This file is part of NooDS.
+
+    NooDS is free software: you can redistribute it and/or modify it
+    under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    NooDS is distributed in the hope that it will be useful, but
+    WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+    General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with NooDS. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <cstring>
+
+#include "lz4.h"
+#include "defines.h"
+
+static FORCE_INLINE uint32_t read32(const uint8_t *data) {
+    // Load a word from a possibly unaligned address
+    uint32_t value;
+    memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+static FORCE_INLINE uint8_t *writeLength(uint8_t *op, size_t length) {
+    // Write the part of a length that doesn't fit in a token nibble
+    for (; length >= 0xFF; length -= 0xFF)
+        *op++ = 0xFF;
+    *op++ = length;
+    return op;
+}
+
+size_t Lz4::compress(const uint8_t *src, size_t size, uint8_t *dst, size_t capacity) {
+    // Compress data into a single LZ4 block, returning 0 if it doesn't fit
+    const uint8_t *ip = src, *anchor = src, *end = src + size;
+    uint8_t *op = dst, *opEnd = dst + capacity;
+    uint32_t table[1 << hashBits];
+    memset(table, 0, sizeof(table));
+
+    // Look for matches until too close to the end, where the format requires literals
+    if (size > matchLimit) {
+        const uint8_t *mfLimit = end - matchLimit;
+        const uint8_t *matchEnd = end - lastLiterals;
+        while (ip < mfLimit) {
+            // Check the last position with the same 4-byte hash for a match
+            uint32_t sequence = read32(ip);
+            uint32_t hash = (sequence * 2654435761U) >> (32 - hashBits);
+            const uint8_t *ref = src + table[hash];
+            table[hash] = ip - src;
+            if (ref >= ip || ip - ref > 0xFFFF || read32(ref) != sequence) {
+                // Skip ahead faster the longer it's been since the last match
+                ip += 1 + ((ip - anchor) >> 6);
+                continue;
+            }
+
+            // Extend the match backwards and forwards as far as possible
+            while (ip > anchor && ref > src && ip[-1] == ref[-1])
+                ip--, ref--;
+            const uint8_t *mp = ip + minMatch, *rp = ref + minMatch;
+            while (mp < matchEnd && *mp == *rp)
+                mp++, rp++;
+
+            // Make sure the sequence will fit in the output
+            size_t litLength = ip - anchor;
+            size_t matchLength = mp - ip - minMatch;
+            if (op + litLength + litLength / 0xFF + matchLength / 0xFF + 5 > opEnd)
+                return 0;
+
+            // Write the token, literals, match offset, and extra match length
+            uint8_t *token = op++;
+            *token = (std::min<size_t>(litLength, 15) << 4) | std::min<size_t>(matchLength, 15);
+            if (litLength >= 15) op = writeLength(op, litLength - 15);
+            memcpy(op, anchor, litLength);
+            op += litLength;
+            *op++ = (ip - ref) >> 0;
+            *op++ = (ip - ref) >> 8;
+            if (matchLength >= 15) op = writeLength(op, matchLength - 15);
+            ip = anchor = mp;
+        }
+    }
+
+    // Write the remaining data as a final literal-only sequence
+    size_t litLength = end - anchor;
+    if (op + litLength + litLength / 0xFF + 2 > opEnd)
+        return 0;
+    *op++ = std::min<size_t>(litLength, 15) << 4;
+    if (litLength >= 15) op = writeLength(op, litLength - 15);
+    memcpy(op, anchor, litLength);
+    return op + litLength - dst;
+}
+
+bool Lz4::decompress(const uint8_t *src, size_t size, uint8_t *dst, size_t dstSize) {
+    // Decompress an LZ4 block, failing if it doesn't produce exactly the expected size
+    const uint8_t *ip = src, *ipEnd = src + size;
+    uint8_t *op = dst, *opEnd = dst + dstSize;
+    while (ip < ipEnd) {
+        // Read the literal length, including any extra bytes
+        uint8_t token = *ip++;
+        size_t length = token >> 4;
+        if (length == 15) {
+            uint8_t value;
+            do {
+                if (ip >= ipEnd) return false;
+                length += (value = *ip++);
+            }
+            while (value == 0xFF);
+        }
+
+        // Copy the literals, stopping if they end the block
+        if (length > size_t(ipEnd - ip) || length > size_t(opEnd - op)) return false;
+        memcpy(op, ip, length);
+        ip += length;
+        op += length;
+        if (ip == ipEnd) break;
+
+        // Read the match offset and make sure it points to written data
+        if (ipEnd - ip < 2) return false;
+        size_t offset = ip[0] | (ip[1] << 8);
+        ip += 2;
+        if (offset == 0 || offset > size_t(op - dst)) return false;
+
+        // Read the match length, including any extra bytes
+        length = (token & 0xF) + minMatch;
+        if ((token & 0xF) == 15) {
+            uint8_t value;
+            do {
+                if (ip >= ipEnd) return false;
+                length += (value = *ip++);
+            }
+            while (value == 0xFF);
+        }
+
+        // Copy the match, byte by byte if it overlaps itself
+        if (length > size_t(opEnd - op)) return false;
+        const uint8_t *ref = op - offset;
+        if (offset >= length) {
+            memcpy(op, ref, length);
+            op += length;
+        }
+        else {
+            for (size_t i = 0; i < length; i++)
+                *op++ = *ref++;
+        }
+    }
+    return op == opEnd;
+}
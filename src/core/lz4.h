@@ -0,0 +1,41 @@
+/*
+    Copyright 2019-2026 Hydr8gon
+
+    This file is part of NooDS.
+
+    NooDS is free software: you can redistribute it and/or modify it
+    under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    NooDS is distributed in the hope that it will be useful, but
+    WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+    General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with NooDS. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// A small codec for the LZ4 block format, used to compress save states
+// Decompression is bounds-checked, so corrupt data fails instead of overrunning buffers
+class Lz4 {
+public:
+    static size_t maxSize(size_t size) { return size + size / 255 + 16; }
+    static uint64_t maxExpanded(size_t size) { return uint64_t(size) * 255; }
+    static size_t compress(const uint8_t *src, size_t size, uint8_t *dst, size_t capacity);
+    static bool decompress(const uint8_t *src, size_t size, uint8_t *dst, size_t dstSize);
+
+private:
+    static const int hashBits = 14;
+    static const int minMatch = 4;
+    static const int lastLiterals = 5;
+    static const int matchLimit = 12;
+
+    Lz4() {} // Private to prevent instantiation
+};
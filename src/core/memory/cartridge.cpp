@@ -17,16 +17,18 @@
     along with NooDS. If not, see <https://www.gnu.org/licenses/>.
 */
 
+#include <algorithm>
 #include <cstring>
+#include "../asset_cache.h"
 #include "../core.h"
 
 Cartridge::~Cartridge() {
     // Update the save file before exiting
     writeSave();
 
-    // Free the ROM and save memory
+    // Free the save memory; ROM memory is freed once no forks share it
+    romCache.close();
     if (romFile) fclose(romFile);
-    if (rom) delete[] rom;
     if (save) delete[] save;
 }
 
@@ -38,12 +40,12 @@ bool Cartridge::setRom(std::string romPath, int romFd, int saveFd, int stateFd,
     std::string cheatPath = basePath + ".cht";
 
     // Relocate files to separate folders if enabled
-    if (Settings::savesFolder)
-        savePath = Settings::basePath + "/saves" + savePath.substr(savePath.find_last_of("/\\"));
-    if (Settings::statesFolder)
-        statePath = Settings::basePath + "/states" + statePath.substr(statePath.find_last_of("/\\"));
-    if (Settings::cheatsFolder)
-        cheatPath = Settings::basePath + "/cheats" + cheatPath.substr(cheatPath.find_last_of("/\\"));
+    if (core->config.savesFolder)
+        savePath = core->config.basePath + "/saves" + savePath.substr(savePath.find_last_of("/\\"));
+    if (core->config.statesFolder)
+        statePath = core->config.basePath + "/states" + statePath.substr(statePath.find_last_of("/\\"));
+    if (core->config.cheatsFolder)
+        cheatPath = core->config.basePath + "/cheats" + cheatPath.substr(cheatPath.find_last_of("/\\"));
 
     // Load files using paths or descriptors if provided
     bool gba = (this == &core->cartridgeGba);
@@ -79,12 +81,76 @@ bool Cartridge::loadRom() {
     return true;
 }
 
+void Cartridge::inherit(Cartridge &parent) {
+    // Share the parent's ROM data, but open the file separately since its position isn't thread-safe
+    romPath = parent.romPath;
+    romFd = parent.romFd;
+    romData = parent.romData;
+    rom = parent.rom;
+    romSize = parent.romSize;
+    romMask = parent.romMask;
+    saveSizes = parent.saveSizes;
+    if (parent.romFile)
+        romFile = (romFd == -1) ? fopen(romPath.c_str(), "rb") : fdopen(dup(romFd), "rb");
+    if (romFile && parent.romCache.isOpen())
+        romCache.open(romFile, romSize);
+
+    // Copy the save without a path, so a fork can write to it without touching the parent's file
+    parent.mutex.lock();
+    if ((saveSize = parent.saveSize) > 0) {
+        save = new uint8_t[saveSize];
+        memcpy(save, parent.save, saveSize * sizeof(uint8_t));
+    }
+    parent.mutex.unlock();
+}
+
+bool Cartridge::mapRom() {
+#ifdef NO_MMAP
+    return false;
+#else
+    // Map the whole ROM file privately; pages are shared with the page cache until written, like by DLDI patches
+    if (romSize <= 0) return false;
+    void *data = mmap(nullptr, romSize, PROT_READ | PROT_WRITE, MAP_PRIVATE, fileno(romFile), 0);
+    if (data == MAP_FAILED) return false;
+
+    // Let the mapping be shared with forks and unmapped once none are using it
+    size_t size = romSize;
+    rom = (uint8_t*)data;
+    romData.reset(rom, [size](uint8_t *data) { munmap(data, size); });
+    LOG_INFO("Mapped ROM file into memory\n");
+    return true;
+#endif
+}
+
+bool Cartridge::shareRom() {
+    // Load the whole ROM through the asset cache, so cores running the same file share one copy
+    if (romFd != -1) return false;
+    Asset asset = AssetCache::load(romPath);
+    if (!asset.data || asset.size != size_t(romSize)) return false;
+    romData = asset.data;
+    rom = romData.get();
+
+    // Give this core a private copy of the ROM if it has a DLDI driver to patch
+    if (!core->dsiMode && Dldi::findDriver(rom, romSize)) {
+        rom = new uint8_t[romSize];
+        memcpy(rom, romData.get(), romSize);
+        romData.reset(rom, std::default_delete<uint8_t[]>());
+        core->dldi.patchRom(rom, 0, romSize);
+    }
+    return true;
+}
+
 void Cartridge::loadRomSection(size_t offset, size_t size) {
-    // Load a section of the current ROM file into memory
-    if (rom) delete[] rom;
+    // Load a section of the current ROM file into memory, through the block cache if it's open
     rom = new uint8_t[size];
-    fseek(romFile, offset, SEEK_SET);
-    fread(rom, sizeof(uint8_t), size, romFile);
+    romData.reset(rom, std::default_delete<uint8_t[]>());
+    if (romCache.isOpen()) {
+        romCache.read(rom, offset, size);
+    }
+    else {
+        fseek(romFile, offset, SEEK_SET);
+        fread(rom, sizeof(uint8_t), size, romFile);
+    }
     if (!core->dsiMode) core->dldi.patchRom(rom, offset, size);
 }
 
@@ -116,20 +182,39 @@ void Cartridge::trimRom() {
             break;
     }
 
+    // A ROM from a file descriptor can only be truncated in place, so leave it if other cores may have it mapped
+    if (romFd != -1 && romData.use_count() > 1)
+        return;
+
     if (newSize < romSize) {
         // Update the ROM in memory
         romSize = newSize;
         uint8_t *newRom = new uint8_t[newSize];
         memcpy(newRom, rom, newSize * sizeof(uint8_t));
-        delete[] rom;
+        romData.reset(newRom, std::default_delete<uint8_t[]>());
         rom = newRom;
 
-        // Update the ROM file
-        FILE *romFile = (romFd == -1) ? fopen(romPath.c_str(), "wb") : fdopen(dup(romFd), "wb");
-        if (romFile) {
+        // Update the ROM file from a descriptor in place
+        if (romFd != -1) {
+            if (FILE *romFile = fdopen(dup(romFd), "wb")) {
+                if (newSize > 0)
+                    fwrite(rom, sizeof(uint8_t), newSize, romFile);
+                fclose(romFile);
+            }
+            return;
+        }
+
+        // Update the ROM file from a path by replacing it, so cores that mapped the old file can still read it
+        std::string tempPath = romPath + ".trim";
+        if (FILE *romFile = fopen(tempPath.c_str(), "wb")) {
             if (newSize > 0)
                 fwrite(rom, sizeof(uint8_t), newSize, romFile);
             fclose(romFile);
+#ifdef WINDOWS
+            remove(romPath.c_str());
+#endif
+            if (rename(tempPath.c_str(), romPath.c_str()))
+                remove(tempPath.c_str());
         }
     }
 }
@@ -158,53 +243,60 @@ void Cartridge::resizeSave(int newSize, bool dirty) {
     mutex.unlock();
 }
 
-void CartridgeNds::saveState(FILE *file) {
-    // Write state data to the file
-    fwrite(&saveSize, sizeof(saveSize), 1, file);
-    if (saveSize > 0) fwrite(save, 1, saveSize, file);
-    fwrite(&cmdMode, sizeof(cmdMode), 1, file);
-    fwrite(encTable, 4, sizeof(encTable) / 4, file);
-    fwrite(encCode, 4, sizeof(encCode) / 4, file);
-    fwrite(romAddrReal, 4, sizeof(romAddrReal) / 4, file);
-    fwrite(romAddrVirt, 4, sizeof(romAddrVirt) / 4, file);
-    fwrite(blockSize, 2, sizeof(blockSize) / 2, file);
-    fwrite(readCount, 2, sizeof(readCount) / 2, file);
-    fwrite(wordCycles, 4, sizeof(wordCycles) / 4, file);
-    fwrite(encrypted, sizeof(bool), sizeof(encrypted) / sizeof(bool), file);
-    fwrite(auxCommand, 1, sizeof(auxCommand), file);
-    fwrite(auxAddress, 4, sizeof(auxAddress) / 4, file);
-    fwrite(auxWriteCount, 4, sizeof(auxWriteCount) / 4, file);
-    fwrite(auxSpiCnt, 2, sizeof(auxSpiCnt) / 2, file);
-    fwrite(auxSpiData, 1, sizeof(auxSpiData), file);
-    fwrite(romCtrl, 4, sizeof(romCtrl) / 4, file);
-    fwrite(romCmdOut, 8, sizeof(romCmdOut) / 8, file);
+void CartridgeNds::saveState(StateBuffer *buffer) {
+    // Write state data to the buffer
+    buffer->write(&saveSize, sizeof(saveSize), 1);
+    if (saveSize > 0) buffer->write(save, 1, saveSize);
+    buffer->write(&cmdMode, sizeof(cmdMode), 1);
+    buffer->write(encTable, 4, sizeof(encTable) / 4);
+    buffer->write(encCode, 4, sizeof(encCode) / 4);
+    buffer->write(romAddrReal, 4, sizeof(romAddrReal) / 4);
+    buffer->write(romAddrVirt, 4, sizeof(romAddrVirt) / 4);
+    buffer->write(blockSize, 2, sizeof(blockSize) / 2);
+    buffer->write(readCount, 2, sizeof(readCount) / 2);
+    buffer->write(wordCycles, 4, sizeof(wordCycles) / 4);
+    buffer->write(encrypted, sizeof(bool), sizeof(encrypted) / sizeof(bool));
+    buffer->write(auxCommand, 1, sizeof(auxCommand));
+    buffer->write(auxAddress, 4, sizeof(auxAddress) / 4);
+    buffer->write(auxWriteCount, 4, sizeof(auxWriteCount) / 4);
+    buffer->write(auxSpiCnt, 2, sizeof(auxSpiCnt) / 2);
+    buffer->write(auxSpiData, 1, sizeof(auxSpiData));
+    buffer->write(romCtrl, 4, sizeof(romCtrl) / 4);
+    buffer->write(romCmdOut, 8, sizeof(romCmdOut) / 8);
 }
 
-void CartridgeNds::loadState(FILE *file) {
-    // Read state data from the file
-    fread(&saveSize, sizeof(saveSize), 1, file);
-    if (saveSize > 0) fread(save, 1, saveSize, file);
-    fread(&cmdMode, sizeof(cmdMode), 1, file);
-    fread(encTable, 4, sizeof(encTable) / 4, file);
-    fread(encCode, 4, sizeof(encCode) / 4, file);
-    fread(romAddrReal, 4, sizeof(romAddrReal) / 4, file);
-    fread(romAddrVirt, 4, sizeof(romAddrVirt) / 4, file);
-    fread(blockSize, 2, sizeof(blockSize) / 2, file);
-    fread(readCount, 2, sizeof(readCount) / 2, file);
-    fread(wordCycles, 4, sizeof(wordCycles) / 4, file);
-    fread(encrypted, sizeof(bool), sizeof(encrypted) / sizeof(bool), file);
-    fread(auxCommand, 1, sizeof(auxCommand), file);
-    fread(auxAddress, 4, sizeof(auxAddress) / 4, file);
-    fread(auxWriteCount, 4, sizeof(auxWriteCount) / 4, file);
-    fread(auxSpiCnt, 2, sizeof(auxSpiCnt) / 2, file);
-    fread(auxSpiData, 1, sizeof(auxSpiData), file);
-    fread(romCtrl, 4, sizeof(romCtrl) / 4, file);
-    fread(romCmdOut, 8, sizeof(romCmdOut) / 8, file);
+void CartridgeNds::loadState(StateBuffer *buffer) {
+    // Read state data from the buffer
+    buffer->read(&saveSize, sizeof(saveSize), 1);
+    if (saveSize > 0) buffer->read(save, 1, saveSize);
+    buffer->read(&cmdMode, sizeof(cmdMode), 1);
+    buffer->read(encTable, 4, sizeof(encTable) / 4);
+    buffer->read(encCode, 4, sizeof(encCode) / 4);
+    buffer->read(romAddrReal, 4, sizeof(romAddrReal) / 4);
+    buffer->read(romAddrVirt, 4, sizeof(romAddrVirt) / 4);
+    buffer->read(blockSize, 2, sizeof(blockSize) / 2);
+    buffer->read(readCount, 2, sizeof(readCount) / 2);
+    buffer->read(wordCycles, 4, sizeof(wordCycles) / 4);
+    buffer->read(encrypted, sizeof(bool), sizeof(encrypted) / sizeof(bool));
+    buffer->read(auxCommand, 1, sizeof(auxCommand));
+    buffer->read(auxAddress, 4, sizeof(auxAddress) / 4);
+    buffer->read(auxWriteCount, 4, sizeof(auxWriteCount) / 4);
+    buffer->read(auxSpiCnt, 2, sizeof(auxSpiCnt) / 2);
+    buffer->read(auxSpiData, 1, sizeof(auxSpiData));
+    buffer->read(romCtrl, 4, sizeof(romCtrl) / 4);
+    buffer->read(romCmdOut, 8, sizeof(romCmdOut) / 8);
 
     // Don't overwrite the save file right away; wait until it's modified
     saveDirty = false;
 }
 
+void CartridgeNds::inherit(CartridgeNds &parent) {
+    // Inherit the parent's ROM along with values detected when it was loaded
+    Cartridge::inherit(parent);
+    romCode = parent.romCode;
+    romEncrypted = parent.romEncrypted;
+}
+
 bool CartridgeNds::loadRom() {
     // Set the valid NDS save sizes
     if (saveSizes.empty()) {
@@ -220,21 +312,30 @@ bool CartridgeNds::loadRom() {
         saveSizes.push_back(0x800000); // FLASH 8192KB
     }
 
-    // Try to load the ROM into RAM if enabled; otherwise fall back to file-based loading
+    // Try to map the ROM file, then to load the ROM into RAM (shared between cores) if enabled; otherwise fall back to file-based loading
     if (!Cartridge::loadRom()) {
         return false;
     }
-    else if (Settings::romInRam) {
+    else if (mapRom()) {
+        // Scan the whole ROM for DLDI drivers like the other loading paths; only patched pages get copied
+        if (!core->dsiMode) core->dldi.patchRom(rom, 0, romSize);
+        fclose(romFile);
+        romFile = nullptr;
+    }
+    else if (core->config.romInRam) {
         try {
-            loadRomSection(0, romSize);
+            if (!shareRom()) loadRomSection(0, romSize);
             fclose(romFile);
             romFile = nullptr;
         }
         catch (std::bad_alloc &ba) {
+            romCache.open(romFile, romSize);
             loadRomSection(0, 0x5000);
         }
     }
     else {
+        // Stream the ROM through a block cache, loading just the start for now
+        romCache.open(romFile, romSize);
         loadRomSection(0, 0x5000);
     }
 
@@ -784,6 +885,11 @@ void CartridgeNds::writeRomCtrl(bool cpu, uint32_t mask, uint32_t value) {
                     loadRomSection(romAddrReal[cpu], blockSize[cpu]);
                     romAddrVirt[cpu] = 0;
                 }
+
+                // Prefetch what comes next if this continues the previous read
+                if (romAddrReal[cpu] == readaheadAddr)
+                    romCache.prefetch(romAddrReal[cpu] + blockSize[cpu]);
+                readaheadAddr = romAddrReal[cpu] + blockSize[cpu];
             }
             else {
                 romAddrVirt[cpu] = romAddrReal[cpu];
@@ -879,30 +985,30 @@ uint32_t CartridgeNds::readRomDataIn(bool cpu) {
     return 0xFFFFFFFF;
 }
 
-void CartridgeGba::saveState(FILE *file) {
-    // Write state data to the file
-    fwrite(&saveSize, sizeof(saveSize), 1, file);
-    if (saveSize > 0) fwrite(save, 1, saveSize, file);
-    fwrite(&eepromCount, sizeof(eepromCount), 1, file);
-    fwrite(&eepromCmd, sizeof(eepromCmd), 1, file);
-    fwrite(&eepromData, sizeof(eepromData), 1, file);
-    fwrite(&eepromDone, sizeof(eepromDone), 1, file);
-    fwrite(&flashCmd, sizeof(flashCmd), 1, file);
-    fwrite(&bankSwap, sizeof(bankSwap), 1, file);
-    fwrite(&flashErase, sizeof(flashErase), 1, file);
+void CartridgeGba::saveState(StateBuffer *buffer) {
+    // Write state data to the buffer
+    buffer->write(&saveSize, sizeof(saveSize), 1);
+    if (saveSize > 0) buffer->write(save, 1, saveSize);
+    buffer->write(&eepromCount, sizeof(eepromCount), 1);
+    buffer->write(&eepromCmd, sizeof(eepromCmd), 1);
+    buffer->write(&eepromData, sizeof(eepromData), 1);
+    buffer->write(&eepromDone, sizeof(eepromDone), 1);
+    buffer->write(&flashCmd, sizeof(flashCmd), 1);
+    buffer->write(&bankSwap, sizeof(bankSwap), 1);
+    buffer->write(&flashErase, sizeof(flashErase), 1);
 }
 
-void CartridgeGba::loadState(FILE *file) {
-    // Read state data from the file
-    fread(&saveSize, sizeof(saveSize), 1, file);
-    if (saveSize > 0) fread(save, 1, saveSize, file);
-    fread(&eepromCount, sizeof(eepromCount), 1, file);
-    fread(&eepromCmd, sizeof(eepromCmd), 1, file);
-    fread(&eepromData, sizeof(eepromData), 1, file);
-    fread(&eepromDone, sizeof(eepromDone), 1, file);
-    fread(&flashCmd, sizeof(flashCmd), 1, file);
-    fread(&bankSwap, sizeof(bankSwap), 1, file);
-    fread(&flashErase, sizeof(flashErase), 1, file);
+void CartridgeGba::loadState(StateBuffer *buffer) {
+    // Read state data from the buffer
+    buffer->read(&saveSize, sizeof(saveSize), 1);
+    if (saveSize > 0) buffer->read(save, 1, saveSize);
+    buffer->read(&eepromCount, sizeof(eepromCount), 1);
+    buffer->read(&eepromCmd, sizeof(eepromCmd), 1);
+    buffer->read(&eepromData, sizeof(eepromData), 1);
+    buffer->read(&eepromDone, sizeof(eepromDone), 1);
+    buffer->read(&flashCmd, sizeof(flashCmd), 1);
+    buffer->read(&bankSwap, sizeof(bankSwap), 1);
+    buffer->read(&flashErase, sizeof(flashErase), 1);
 
     // Don't overwrite the save file right away; wait until it's modified
     saveDirty = false;
@@ -938,9 +1044,9 @@ bool CartridgeGba::loadRom() {
         saveSizes.push_back(0x20000); // FLASH 128KB
     }
 
-    // Load the ROM into memory
+    // Map, share, or load the ROM into memory
     if (!Cartridge::loadRom()) return false;
-    loadRomSection(0, romSize);
+    if (!mapRom() && !shareRom()) loadRomSection(0, romSize);
     fclose(romFile);
     romFile = nullptr;
 
@@ -20,13 +20,16 @@
 #pragma once
 
 #include <cstdint>
+#include <memory>
 #include <mutex>
 #include <string>
 #include <vector>
 
+#include "rom_cache.h"
 #include "../defines.h"
 
 class Core;
+class StateBuffer;
 
 enum NdsCmdMode {
     CMD_NONE = 0,
@@ -42,6 +45,7 @@ public:
     ~Cartridge();
 
     bool setRom(std::string romPath, int romFd = -1, int saveFd = -1, int stateFd = -1, int cheatFd = -1);
+    void inherit(Cartridge &parent);
     void writeSave();
 
     void trimRom();
@@ -49,12 +53,15 @@ public:
 
     int getRomSize() { return romSize; }
     int getSaveSize() { return saveSize; }
+    RomCacheStats getCacheStats() { return romCache.getStats(); }
 
 protected:
     Core *core;
 
     FILE *romFile = nullptr;
     uint8_t *rom = nullptr, *save = nullptr;
+    std::shared_ptr<uint8_t> romData;
+    RomCache romCache;
     int romSize = 0, saveSize = -1;
     bool saveDirty = false;
     std::mutex mutex;
@@ -63,6 +70,8 @@ protected:
     uint32_t romMask = 0;
 
     virtual bool loadRom();
+    bool mapRom();
+    bool shareRom();
     void loadRomSection(size_t offset, size_t size);
 
 private:
@@ -73,8 +82,9 @@ private:
 class CartridgeNds: public Cartridge {
 public:
     CartridgeNds(Core *core): Cartridge(core) {}
-    void saveState(FILE *file);
-    void loadState(FILE *file);
+    void saveState(StateBuffer *buffer);
+    void loadState(StateBuffer *buffer);
+    void inherit(CartridgeNds &parent);
 
     void directBoot();
     void wordReady(bool cpu);
@@ -99,6 +109,7 @@ private:
     uint32_t encCode[3] = {};
 
     uint32_t romAddrReal[2] = {}, romAddrVirt[2] = {};
+    uint32_t readaheadAddr = 0;
     uint16_t blockSize[2] = {}, readCount[2] = {};
     uint32_t wordCycles[2] = {};
     bool encrypted[2] = {};
@@ -125,8 +136,8 @@ private:
 class CartridgeGba: public Cartridge {
 public:
     CartridgeGba(Core *core): Cartridge(core) {}
-    void saveState(FILE *file);
-    void loadState(FILE *file);
+    void saveState(StateBuffer *buffer);
+    void loadState(StateBuffer *buffer);
 
     uint8_t *getRom(uint32_t address);
     bool isEeprom(uint32_t address);
@@ -19,24 +19,24 @@
 
 #include "../core.h"
 
-void Dma::saveState(FILE *file) {
-    // Write state data to the file
-    fwrite(srcAddrs, 4, sizeof(srcAddrs) / 4, file);
-    fwrite(dstAddrs, 4, sizeof(dstAddrs) / 4, file);
-    fwrite(wordCounts, 4, sizeof(wordCounts) / 4, file);
-    fwrite(dmaSad, 4, sizeof(dmaSad) / 4, file);
-    fwrite(dmaDad, 4, sizeof(dmaDad) / 4, file);
-    fwrite(dmaCnt, 4, sizeof(dmaCnt) / 4, file);
+void Dma::saveState(StateBuffer *buffer) {
+    // Write state data to the buffer
+    buffer->write(srcAddrs, 4, sizeof(srcAddrs) / 4);
+    buffer->write(dstAddrs, 4, sizeof(dstAddrs) / 4);
+    buffer->write(wordCounts, 4, sizeof(wordCounts) / 4);
+    buffer->write(dmaSad, 4, sizeof(dmaSad) / 4);
+    buffer->write(dmaDad, 4, sizeof(dmaDad) / 4);
+    buffer->write(dmaCnt, 4, sizeof(dmaCnt) / 4);
 }
 
-void Dma::loadState(FILE *file) {
-    // Read state data from the file
-    fread(srcAddrs, 4, sizeof(srcAddrs) / 4, file);
-    fread(dstAddrs, 4, sizeof(dstAddrs) / 4, file);
-    fread(wordCounts, 4, sizeof(wordCounts) / 4, file);
-    fread(dmaSad, 4, sizeof(dmaSad) / 4, file);
-    fread(dmaDad, 4, sizeof(dmaDad) / 4, file);
-    fread(dmaCnt, 4, sizeof(dmaCnt) / 4, file);
+void Dma::loadState(StateBuffer *buffer) {
+    // Read state data from the buffer
+    buffer->read(srcAddrs, 4, sizeof(srcAddrs) / 4);
+    buffer->read(dstAddrs, 4, sizeof(dstAddrs) / 4);
+    buffer->read(wordCounts, 4, sizeof(wordCounts) / 4);
+    buffer->read(dmaSad, 4, sizeof(dmaSad) / 4);
+    buffer->read(dmaDad, 4, sizeof(dmaDad) / 4);
+    buffer->read(dmaCnt, 4, sizeof(dmaCnt) / 4);
 }
 
 void Dma::transfer(int channel) {
@@ -44,6 +44,7 @@ void Dma::transfer(int channel) {
     int srcAddrCnt = (dmaCnt[channel] & 0x01800000) >> 23;
     int mode = (dmaCnt[channel] & 0x38000000) >> 27;
     int gxFifoCount = 0;
+    core->perfTimers.enter(PERF_DMA);
 
     // Perform the transfer
     if (core->gbaMode && mode == 6 && (channel == 1 || channel == 2)) { // GBA sound DMA
@@ -54,6 +55,7 @@ void Dma::transfer(int channel) {
             // GBA sound DMAs always transfer 4 words and never adjust the destination address
             uint32_t value = core->memory.read<uint32_t>(cpu, srcAddrs[channel], false);
             core->memory.write<uint32_t>(cpu, dstAddrs[channel], value, false);
+            core->metrics.dmaWords++;
 
             // Adjust the source address
             if (srcAddrCnt == 0) // Increment
@@ -69,6 +71,7 @@ void Dma::transfer(int channel) {
             // Transfer a word
             uint32_t value = core->memory.read<uint32_t>(cpu, srcAddrs[channel], false);
             core->memory.write<uint32_t>(cpu, dstAddrs[channel], value, false);
+            core->metrics.dmaWords++;
 
             // Adjust the source address
             if (srcAddrCnt == 0) // Increment
@@ -94,6 +97,7 @@ void Dma::transfer(int channel) {
             // Transfer a half-word
             uint16_t value = core->memory.read<uint16_t>(cpu, srcAddrs[channel], false);
             core->memory.write<uint16_t>(cpu, dstAddrs[channel], value, false);
+            core->metrics.dmaWords++;
 
             // Adjust the source address
             if (srcAddrCnt == 0) // Increment
@@ -120,6 +124,7 @@ void Dma::transfer(int channel) {
             // Schedule another transfer immediately if the FIFO is still half empty
             if (core->gpu3D.readGxStat() & BIT(25))
                 core->schedule(SchedTask(DMA9_TRANSFER0 + (cpu << 2) + channel), 1);
+            core->perfTimers.leave();
             return;
         }
     }
@@ -142,6 +147,7 @@ void Dma::transfer(int channel) {
     // Trigger an end of transfer IRQ if enabled
     if (dmaCnt[channel] & BIT(30))
         core->interpreter[cpu].sendInterrupt(8 + channel);
+    core->perfTimers.leave();
 }
 
 void Dma::trigger(int mode, uint8_t channels) {
@@ -23,12 +23,13 @@
 #include <cstdio>
 
 class Core;
+class StateBuffer;
 
 class Dma {
 public:
     Dma(Core *core, bool cpu): core(core), cpu(cpu) {}
-    void saveState(FILE *file);
-    void loadState(FILE *file);
+    void saveState(StateBuffer *buffer);
+    void loadState(StateBuffer *buffer);
 
     void transfer(int channel);
     void trigger(int mode, uint8_t channels = 0xF);
@@ -18,6 +18,7 @@
 */
 
 #include <cstring>
+#include "../asset_cache.h"
 #include "../core.h"
 
 // Defines an 8-bit register in an I/O switch statement
@@ -70,134 +71,235 @@ template <typename T> void VramMapping::write(uint32_t address, T value) {
             mappings[m][address + i] = value >> (i * 8);
 }
 
-void Memory::saveState(FILE *file) {
-    // Write DS state data to the file
-    fwrite(ram, 1, core->dsiMode ? 0x1000000 : 0x400000, file);
-    fwrite(wram, 1, sizeof(wram), file);
-    fwrite(instrTcm, 1, sizeof(instrTcm), file);
-    fwrite(dataTcm, 1, sizeof(dataTcm), file);
-    fwrite(wram7, 1, sizeof(wram7), file);
-    fwrite(wifiRam, 1, sizeof(wifiRam), file);
-    fwrite(palette, 1, sizeof(palette), file);
-    fwrite(vramA, 1, sizeof(vramA), file);
-    fwrite(vramB, 1, sizeof(vramB), file);
-    fwrite(vramC, 1, sizeof(vramC), file);
-    fwrite(vramD, 1, sizeof(vramD), file);
-    fwrite(vramE, 1, sizeof(vramE), file);
-    fwrite(vramF, 1, sizeof(vramF), file);
-    fwrite(vramG, 1, sizeof(vramG), file);
-    fwrite(vramH, 1, sizeof(vramH), file);
-    fwrite(vramI, 1, sizeof(vramI), file);
-    fwrite(oam, 1, sizeof(oam), file);
-    fwrite(&gbaBiosAddr, sizeof(gbaBiosAddr), 1, file);
-    fwrite(dmaFill, 4, sizeof(dmaFill) / 4, file);
-    fwrite(vramCnt, 1, sizeof(vramCnt), file);
-    fwrite(&wramCnt, sizeof(wramCnt), 1, file);
-    fwrite(&haltCnt, sizeof(haltCnt), 1, file);
-
-    // Write DSi state data to the file
+void Memory::saveState(StateBuffer *buffer) {
+    // Write DS state data to the buffer
+    buffer->write(ram, 1, core->dsiMode ? 0x1000000 : 0x400000);
+    buffer->write(wram, 1, sizeof(wram));
+    buffer->write(instrTcm, 1, sizeof(instrTcm));
+    buffer->write(dataTcm, 1, sizeof(dataTcm));
+    buffer->write(wram7, 1, sizeof(wram7));
+    buffer->write(wifiRam, 1, sizeof(wifiRam));
+    buffer->write(palette, 1, sizeof(palette));
+    buffer->write(vramA, 1, sizeof(vramA));
+    buffer->write(vramB, 1, sizeof(vramB));
+    buffer->write(vramC, 1, sizeof(vramC));
+    buffer->write(vramD, 1, sizeof(vramD));
+    buffer->write(vramE, 1, sizeof(vramE));
+    buffer->write(vramF, 1, sizeof(vramF));
+    buffer->write(vramG, 1, sizeof(vramG));
+    buffer->write(vramH, 1, sizeof(vramH));
+    buffer->write(vramI, 1, sizeof(vramI));
+    buffer->write(oam, 1, sizeof(oam));
+    buffer->write(&gbaBiosAddr, sizeof(gbaBiosAddr), 1);
+    buffer->write(dmaFill, 4, sizeof(dmaFill) / 4);
+    buffer->write(vramCnt, 1, sizeof(vramCnt));
+    buffer->write(&wramCnt, sizeof(wramCnt), 1);
+    buffer->write(&haltCnt, sizeof(haltCnt), 1);
+
+    // Write DSi state data to the buffer
     if (core->dsiMode) {
-        fwrite(nwramA, 1, sizeof(nwramA), file);
-        fwrite(nwramB, 1, sizeof(nwramB), file);
-        fwrite(nwramC, 1, sizeof(nwramC), file);
-        fwrite(mbk1, 1, sizeof(mbk1), file);
-        fwrite(mbk23, 1, sizeof(mbk23), file);
-        fwrite(mbk45, 1, sizeof(mbk45), file);
-        fwrite(mbk6, 4, sizeof(mbk6) / 4, file);
-        fwrite(mbk7, 4, sizeof(mbk7) / 4, file);
-        fwrite(mbk8, 4, sizeof(mbk8) / 4, file);
+        buffer->write(nwramA, 1, sizeof(nwramA));
+        buffer->write(nwramB, 1, sizeof(nwramB));
+        buffer->write(nwramC, 1, sizeof(nwramC));
+        buffer->write(mbk1, 1, sizeof(mbk1));
+        buffer->write(mbk23, 1, sizeof(mbk23));
+        buffer->write(mbk45, 1, sizeof(mbk45));
+        buffer->write(mbk6, 4, sizeof(mbk6) / 4);
+        buffer->write(mbk7, 4, sizeof(mbk7) / 4);
+        buffer->write(mbk8, 4, sizeof(mbk8) / 4);
     }
 }
 
-void Memory::loadState(FILE *file) {
-    // Read DS state data from the file
-    fread(ram, 1, core->dsiMode ? 0x1000000 : 0x400000, file);
-    fread(wram, 1, sizeof(wram), file);
-    fread(instrTcm, 1, sizeof(instrTcm), file);
-    fread(dataTcm, 1, sizeof(dataTcm), file);
-    fread(wram7, 1, sizeof(wram7), file);
-    fread(wifiRam, 1, sizeof(wifiRam), file);
-    fread(palette, 1, sizeof(palette), file);
-    fread(vramA, 1, sizeof(vramA), file);
-    fread(vramB, 1, sizeof(vramB), file);
-    fread(vramC, 1, sizeof(vramC), file);
-    fread(vramD, 1, sizeof(vramD), file);
-    fread(vramE, 1, sizeof(vramE), file);
-    fread(vramF, 1, sizeof(vramF), file);
-    fread(vramG, 1, sizeof(vramG), file);
-    fread(vramH, 1, sizeof(vramH), file);
-    fread(vramI, 1, sizeof(vramI), file);
-    fread(oam, 1, sizeof(oam), file);
-    fread(&gbaBiosAddr, sizeof(gbaBiosAddr), 1, file);
-    fread(dmaFill, 4, sizeof(dmaFill) / 4, file);
-    fread(vramCnt, 1, sizeof(vramCnt), file);
-    fread(&wramCnt, sizeof(wramCnt), 1, file);
-    fread(&haltCnt, sizeof(haltCnt), 1, file);
-
-    // Read DSi state data from the file
+void Memory::loadState(StateBuffer *buffer) {
+    // Keep the current mapping registers so only the regions they control have to be remapped
+    uint8_t wramOld[21], vramOld[9];
+    uint32_t mbkOld[6];
+    wramOld[0] = wramCnt;
+    memcpy(&wramOld[1], mbk1, sizeof(mbk1));
+    memcpy(&wramOld[5], mbk23, sizeof(mbk23));
+    memcpy(&wramOld[13], mbk45, sizeof(mbk45));
+    memcpy(vramOld, vramCnt, sizeof(vramCnt));
+    memcpy(&mbkOld[0], mbk6, sizeof(mbk6));
+    memcpy(&mbkOld[2], mbk7, sizeof(mbk7));
+    memcpy(&mbkOld[4], mbk8, sizeof(mbk8));
+
+    // Read DS state data from the buffer
+    buffer->read(ram, 1, core->dsiMode ? 0x1000000 : 0x400000);
+    buffer->read(wram, 1, sizeof(wram));
+    buffer->read(instrTcm, 1, sizeof(instrTcm));
+    buffer->read(dataTcm, 1, sizeof(dataTcm));
+    buffer->read(wram7, 1, sizeof(wram7));
+    buffer->read(wifiRam, 1, sizeof(wifiRam));
+    buffer->read(palette, 1, sizeof(palette));
+    buffer->read(vramA, 1, sizeof(vramA));
+    buffer->read(vramB, 1, sizeof(vramB));
+    buffer->read(vramC, 1, sizeof(vramC));
+    buffer->read(vramD, 1, sizeof(vramD));
+    buffer->read(vramE, 1, sizeof(vramE));
+    buffer->read(vramF, 1, sizeof(vramF));
+    buffer->read(vramG, 1, sizeof(vramG));
+    buffer->read(vramH, 1, sizeof(vramH));
+    buffer->read(vramI, 1, sizeof(vramI));
+    buffer->read(oam, 1, sizeof(oam));
+    buffer->read(&gbaBiosAddr, sizeof(gbaBiosAddr), 1);
+    buffer->read(dmaFill, 4, sizeof(dmaFill) / 4);
+    buffer->read(vramCnt, 1, sizeof(vramCnt));
+    buffer->read(&wramCnt, sizeof(wramCnt), 1);
+    buffer->read(&haltCnt, sizeof(haltCnt), 1);
+
+    // Read DSi state data from the buffer
     if (core->dsiMode) {
-        fread(nwramA, 1, sizeof(nwramA), file);
-        fread(nwramB, 1, sizeof(nwramB), file);
-        fread(nwramC, 1, sizeof(nwramC), file);
-        fread(mbk1, 1, sizeof(mbk1), file);
-        fread(mbk23, 1, sizeof(mbk23), file);
-        fread(mbk45, 1, sizeof(mbk45), file);
-        fread(mbk6, 4, sizeof(mbk6) / 4, file);
-        fread(mbk7, 4, sizeof(mbk7) / 4, file);
-        fread(mbk8, 4, sizeof(mbk8) / 4, file);
+        buffer->read(nwramA, 1, sizeof(nwramA));
+        buffer->read(nwramB, 1, sizeof(nwramB));
+        buffer->read(nwramC, 1, sizeof(nwramC));
+        buffer->read(mbk1, 1, sizeof(mbk1));
+        buffer->read(mbk23, 1, sizeof(mbk23));
+        buffer->read(mbk45, 1, sizeof(mbk45));
+        buffer->read(mbk6, 4, sizeof(mbk6) / 4);
+        buffer->read(mbk7, 4, sizeof(mbk7) / 4);
+        buffer->read(mbk8, 4, sizeof(mbk8) / 4);
     }
 
-    // Update mapped memory
-    updateMap9(0x00000000, 0xFFFFFFFF);
-    updateMap7(0x00000000, 0xFFFFFFFF);
-    updateVram();
+    // Update all mapped memory if the maps were invalidated
+    if (remapAll) {
+        remapAll = false;
+        updateMap9(0x00000000, 0xFFFFFFFF);
+        updateMap7(0x00000000, 0xFFFFFFFF);
+        updateVram();
+    }
+    else {
+        // Update VRAM mappings if any VRAMCNT registers changed, or just refresh 3D otherwise
+        if (memcmp(vramOld, vramCnt, sizeof(vramCnt)))
+            updateVram();
+        else
+            core->gpu.invalidate3D();
+
+        // Update shared WRAM mappings for each CPU if WRAMCNT or its MBK registers changed
+        bool wram = (wramOld[0] != wramCnt || memcmp(&wramOld[1], mbk1, sizeof(mbk1)) ||
+            memcmp(&wramOld[5], mbk23, sizeof(mbk23)) || memcmp(&wramOld[13], mbk45, sizeof(mbk45)));
+        if (wram || mbkOld[0] != mbk6[0] || mbkOld[2] != mbk7[0] || mbkOld[4] != mbk8[0])
+            updateMap9(0x3000000, 0x4000000);
+        if (wram || mbkOld[1] != mbk6[1] || mbkOld[3] != mbk7[1] || mbkOld[5] != mbk8[1])
+            updateMap7(0x3000000, 0x3800000);
+    }
+
+    // Consider all tracked memory changed after loading
+    memset(dirty, 1, dirtyLimit);
 }
 
-bool Memory::loadBios9() {
-    // Load the ARM9 BIOS if the file is found
-    std::string &path = core->dsiMode ? Settings::dsiBios9Path : Settings::ndsBios9Path;
-    if (FILE *file = fopen(path.c_str(), "rb")) {
-        fread(bios9, sizeof(uint8_t), 0x10000, file);
-        fclose(file);
+void Memory::setDirtyTracking(bool enabled) {
+    // Enable or disable dirty page tracking, starting with everything marked as changed
+    dirtyLimit = enabled ? dirtyPages : 0;
+    memset(dirty, 1, sizeof(dirty));
+}
+
+void Memory::getRegion(DirtyRegion region, uint8_t *&data, uint32_t &size) {
+    // Get the data and size of a dirty tracking region
+    switch (region) {
+        case DIRTY_RAM: data = ram; size = sizeof(ram); return;
+        case DIRTY_WRAM: data = wram; size = sizeof(wram); return;
+        case DIRTY_INSTR_TCM: data = instrTcm; size = sizeof(instrTcm); return;
+        case DIRTY_DATA_TCM: data = dataTcm; size = sizeof(dataTcm); return;
+        case DIRTY_WRAM7: data = wram7; size = sizeof(wram7); return;
+        case DIRTY_WIFI_RAM: data = wifiRam; size = sizeof(wifiRam); return;
+        case DIRTY_VRAM_A: data = vramA; size = sizeof(vramA); return;
+        case DIRTY_VRAM_B: data = vramB; size = sizeof(vramB); return;
+        case DIRTY_VRAM_C: data = vramC; size = sizeof(vramC); return;
+        case DIRTY_VRAM_D: data = vramD; size = sizeof(vramD); return;
+        case DIRTY_VRAM_E: data = vramE; size = sizeof(vramE); return;
+        case DIRTY_VRAM_F: data = vramF; size = sizeof(vramF); return;
+        case DIRTY_VRAM_G: data = vramG; size = sizeof(vramG); return;
+        case DIRTY_VRAM_H: data = vramH; size = sizeof(vramH); return;
+        case DIRTY_VRAM_I: data = vramI; size = sizeof(vramI); return;
+        case DIRTY_NWRAM_A: data = nwramA; size = sizeof(nwramA); return;
+        case DIRTY_NWRAM_B: data = nwramB; size = sizeof(nwramB); return;
+        case DIRTY_NWRAM_C: data = nwramC; size = sizeof(nwramC); return;
+        default: data = ram; size = dirtyPages << 12; return;
+    }
+}
+
+bool Memory::isDirty(DirtyRegion region, uint32_t offset) {
+    // Check if the page containing an offset in a region has changed since last cleared
+    uint8_t *data;
+    uint32_t size;
+    getRegion(region, data, size);
+    if (offset >= size) return false;
+    return dirty[(data - ram + offset) >> 12];
+}
+
+uint32_t Memory::countDirty(DirtyRegion region) {
+    // Count the pages in a region that have changed since last cleared
+    uint8_t *data;
+    uint32_t size, count = 0;
+    getRegion(region, data, size);
+    for (uint32_t i = (data - ram) >> 12; i < ((data - ram + size) >> 12); i++)
+        count += dirty[i];
+    return count;
+}
+
+void Memory::clearDirty(DirtyRegion region) {
+    // Reset the dirty flags for all pages in a region
+    uint8_t *data;
+    uint32_t size;
+    getRegion(region, data, size);
+    memset(&dirty[(data - ram) >> 12], 0, size >> 12);
+}
+
+void Memory::markDirty(VramMapping *mapping, uint32_t address) {
+    // Flag the page of every VRAM block an overlapping write went to
+    for (uint8_t m = 0; m < mapping->count; m++)
+        markDirty(&mapping->mappings[m][address]);
+}
+
+void Memory::inherit(Memory &parent) {
+    // Share the parent's BIOS data, which is never written once loaded
+    bios9Data = parent.bios9Data;
+    bios7Data = parent.bios7Data;
+    gbaBiosData = parent.gbaBiosData;
+    bios9 = bios9Data.get();
+    bios7 = bios7Data.get();
+    gbaBios = gbaBiosData.get();
+}
+
+bool Memory::loadBios(std::string &path, std::shared_ptr<uint8_t> &data, uint8_t *&bios, size_t size) {
+    // Load a BIOS through the asset cache if the file is found, so other cores can share it
+    Asset asset = AssetCache::load(path, size);
+    if (asset.data) {
+        data = asset.data;
+        bios = data.get();
         return true;
     }
 
     // Prepare HLE BIOS with a special opcode for interrupt return
-    bios9[3] = 0xFF;
+    bios = new uint8_t[size]();
+    data.reset(bios, std::default_delete<uint8_t[]>());
+    bios[3] = 0xFF;
+    return false;
+}
+
+bool Memory::loadBios9() {
+    // Load the ARM9 BIOS, or fall back to HLE if the file isn't found
+    std::string &path = core->dsiMode ? core->config.dsiBios9Path : core->config.ndsBios9Path;
+    if (loadBios(path, bios9Data, bios9, 0x10000)) return true;
     core->interpreter[0].bios = &core->hleBios[0];
     return false;
 }
 
 bool Memory::loadBios7() {
-    // Load the ARM7 BIOS if the file is found
-    std::string &path = core->dsiMode ? Settings::dsiBios7Path : Settings::ndsBios7Path;
-    if (FILE *file = fopen(path.c_str(), "rb")) {
-        fread(bios7, sizeof(uint8_t), 0x10000, file);
-        fclose(file);
-        return true;
-    }
-
-    // Prepare HLE BIOS with a special opcode for interrupt return
-    bios7[3] = 0xFF;
+    // Load the ARM7 BIOS, or fall back to HLE if the file isn't found
+    std::string &path = core->dsiMode ? core->config.dsiBios7Path : core->config.ndsBios7Path;
+    if (loadBios(path, bios7Data, bios7, 0x10000)) return true;
     core->interpreter[1].bios = &core->hleBios[1];
     return false;
 }
 
 bool Memory::loadGbaBios() {
-    // Load the GBA BIOS if the file is found
-    if (FILE *file = fopen(Settings::gbaBiosPath.c_str(), "rb")) {
-        fread(gbaBios, sizeof(uint8_t), 0x4000, file);
-        fclose(file);
-        return true;
-    }
-
-    // Prepare HLE BIOS with a special opcode for interrupt return
-    gbaBios[3] = 0xFF;
-    return false;
+    // Load the GBA BIOS, or fall back to HLE if the file isn't found
+    return loadBios(core->config.gbaBiosPath, gbaBiosData, gbaBios, 0x4000);
 }
 
 void Memory::copyBiosLogo(uint8_t *logo) {
-    // Copy logo data to HLE BIOS so GBA ROMs can be verified
+    // Copy logo data to HLE BIOS so GBA ROMs can be verified; this is never a shared asset
     if (bios9[3] == 0xFF)
         memcpy(&bios9[0x20], logo, 0x9C);
 }
@@ -697,6 +799,9 @@ template <typename T> T Memory::readFallback(bool arm7, uint32_t address) {
     // Align the address
     address &= ~(sizeof(T) - 1);
     uint8_t *data = nullptr;
+#ifdef PROFILER
+    core->profiler.countFallback(arm7, false, address);
+#endif
 
     // Handle special memory reads such as I/O registers, overlapping VRAM, or areas smaller than 4KB
     if (!arm7) { // ARM9
@@ -809,6 +914,9 @@ template <typename T> void Memory::writeFallback(bool arm7, uint32_t address, T
     // Align the address
     address &= ~(sizeof(T) - 1);
     uint8_t *data = nullptr;
+#ifdef PROFILER
+    core->profiler.countFallback(arm7, true, address);
+#endif
 
     // Handle special memory writes such as I/O registers, overlapping VRAM, or areas smaller than 4KB
     if (!arm7) { // ARM9
@@ -832,6 +940,7 @@ template <typename T> void Memory::writeFallback(bool arm7, uint32_t address, T
             }
             if (mapping->count == 0) break;
             mapping->write<T>(address & 0x3FFF, value);
+            markDirty(mapping, address & 0x3FFF);
             return;
         }
 
@@ -883,6 +992,7 @@ template <typename T> void Memory::writeFallback(bool arm7, uint32_t address, T
             VramMapping *mapping = &vram7[(address & 0x3FFFF) >> 17];
             if (mapping->count == 0) break;
             mapping->write<T>(address & 0x1FFFF, value);
+            markDirty(mapping, address & 0x1FFFF);
             return;
         }
 
@@ -896,6 +1006,7 @@ template <typename T> void Memory::writeFallback(bool arm7, uint32_t address, T
     if (data) {
         for (uint32_t i = 0; i < sizeof(T); i++)
             data[i] = value >> (i * 8);
+        markDirty(data);
         return;
     }
 
@@ -20,9 +20,35 @@
 #pragma once
 
 #include <cstdint>
+#include <memory>
+#include <string>
+
 #include "../defines.h"
 
 class Core;
+class StateBuffer;
+
+enum DirtyRegion {
+    DIRTY_RAM,
+    DIRTY_WRAM,
+    DIRTY_INSTR_TCM,
+    DIRTY_DATA_TCM,
+    DIRTY_WRAM7,
+    DIRTY_WIFI_RAM,
+    DIRTY_VRAM_A,
+    DIRTY_VRAM_B,
+    DIRTY_VRAM_C,
+    DIRTY_VRAM_D,
+    DIRTY_VRAM_E,
+    DIRTY_VRAM_F,
+    DIRTY_VRAM_G,
+    DIRTY_VRAM_H,
+    DIRTY_VRAM_I,
+    DIRTY_NWRAM_A,
+    DIRTY_NWRAM_B,
+    DIRTY_NWRAM_C,
+    DIRTY_ALL
+};
 
 struct VramMapping {
     uint8_t *mappings[7] = {};
@@ -51,9 +77,10 @@ public:
     uint8_t *pal3D[6] = {};
 
     Memory(Core *core): core(core) {};
-    void saveState(FILE *file);
-    void loadState(FILE *file);
+    void saveState(StateBuffer *buffer);
+    void loadState(StateBuffer *buffer);
 
+    void inherit(Memory &parent);
     bool loadBios9();
     bool loadBios7();
     bool loadGbaBios();
@@ -62,10 +89,17 @@ public:
     void updateMap9(uint32_t start, uint32_t end, bool tcm = false);
     void updateMap7(uint32_t start, uint32_t end);
     void updateVram();
+    void invalidateMaps() { remapAll = true; }
+    const uint8_t *getRam() { return ram; }
 
     template <typename T> T read(bool arm7, uint32_t address, bool tcm = true);
     template <typename T> void write(bool arm7, uint32_t address, T value, bool tcm = true);
 
+    void setDirtyTracking(bool enabled);
+    bool isDirty(DirtyRegion region, uint32_t offset);
+    uint32_t countDirty(DirtyRegion region = DIRTY_ALL);
+    void clearDirty(DirtyRegion region = DIRTY_ALL);
+
     uint32_t readDmaFill(int channel) { return dmaFill[channel]; }
     uint8_t readVramCnt(int block) { return vramCnt[block]; }
     uint8_t readVramStat() { return vramStat; }
@@ -96,9 +130,10 @@ private:
     Core *core;
     uint32_t gbaBiosAddr = 0;
 
-    uint8_t bios9[0x10000] = {}; // 64KB ARM9 BIOS
-    uint8_t bios7[0x10000] = {}; // 64KB ARM7 BIOS
-    uint8_t gbaBios[0x4000] = {}; // 16KB GBA BIOS
+    uint8_t *bios9 = nullptr; // 64KB ARM9 BIOS
+    uint8_t *bios7 = nullptr; // 64KB ARM7 BIOS
+    uint8_t *gbaBios = nullptr; // 16KB GBA BIOS
+    std::shared_ptr<uint8_t> bios9Data, bios7Data, gbaBiosData;
 
     uint8_t ram[0x1000000] = {}; // 16MB main RAM
     uint8_t wram[0x8000] = {}; // 32KB shared WRAM
@@ -121,6 +156,15 @@ private:
     uint8_t nwramB[0x40000] = {}; // 256KB NWRAM block B
     uint8_t nwramC[0x40000] = {}; // 256KB NWRAM block C
 
+    // Dirty flags for each 4KB page from main RAM to NWRAM, which are laid out contiguously
+    // Tracking is disabled by setting the limit to 0, which makes every page fail the range check
+    static const uint32_t dirtyPages = (sizeof(ram) + sizeof(wram) + sizeof(instrTcm) + sizeof(dataTcm) +
+        sizeof(wram7) + sizeof(wifiRam) + sizeof(vramA) + sizeof(vramB) + sizeof(vramC) + sizeof(vramD) +
+        sizeof(vramE) + sizeof(vramF) + sizeof(vramG) + sizeof(vramH) + sizeof(vramI) + sizeof(nwramA) +
+        sizeof(nwramB) + sizeof(nwramC)) >> 12;
+    uint8_t dirty[dirtyPages] = {};
+    uint32_t dirtyLimit = 0;
+
     VramMapping engABg[32];
     VramMapping engBBg[8];
     VramMapping engAObj[16];
@@ -140,6 +184,12 @@ private:
     uint32_t mbk6[2] = {};
     uint32_t mbk7[2] = {};
     uint32_t mbk8[2] = {};
+    bool remapAll = true;
+
+    void markDirty(uint8_t *data);
+    void markDirty(VramMapping *mapping, uint32_t address);
+    void getRegion(DirtyRegion region, uint8_t *&data, uint32_t &size);
+    bool loadBios(std::string &path, std::shared_ptr<uint8_t> &data, uint8_t *&bios, size_t size);
 
     template <typename T> T readFallback(bool arm7, uint32_t address);
     template <typename T> void writeFallback(bool arm7, uint32_t address, T value);
@@ -180,9 +230,16 @@ template <typename T> FORCE_INLINE void Memory::write(bool arm7, uint32_t addres
         data += address & (0x1000 - sizeof(T));
         for (uint32_t i = 0; i < sizeof(T); i++)
             data[i] = value >> (i * 8);
+        markDirty(data);
         return;
     }
 
     // Handle special write cases that can't be mapped
     return writeFallback<T>(arm7, address, value);
 }
+
+FORCE_INLINE void Memory::markDirty(uint8_t *data) {
+    // Flag the page containing a pointer if it's tracked, ignoring memory outside the range
+    uintptr_t page = (uintptr_t(data) - uintptr_t(ram)) >> 12;
+    if (page < dirtyLimit) dirty[page] = 1;
+}
@@ -19,34 +19,34 @@
 
 #include "../core.h"
 
-void Ndma::saveState(FILE *file) {
-    // Write DSi state data to the file
+void Ndma::saveState(StateBuffer *buffer) {
+    // Write DSi state data to the buffer
     if (!core->dsiMode) return;
-    fwrite(srcAddrs, 4, sizeof(srcAddrs) / 4, file);
-    fwrite(dstAddrs, 4, sizeof(dstAddrs) / 4, file);
-    fwrite(&drqMask, sizeof(drqMask), 1, file);
-    fwrite(&runMask, sizeof(runMask), 1, file);
-    fwrite(ndmaSad, 4, sizeof(ndmaSad) / 4, file);
-    fwrite(ndmaDad, 4, sizeof(ndmaDad) / 4, file);
-    fwrite(ndmaTcnt, 4, sizeof(ndmaTcnt) / 4, file);
-    fwrite(ndmaWcnt, 4, sizeof(ndmaWcnt) / 4, file);
-    fwrite(ndmaFdata, 4, sizeof(ndmaFdata) / 4, file);
-    fwrite(ndmaCnt, 4, sizeof(ndmaCnt) / 4, file);
+    buffer->write(srcAddrs, 4, sizeof(srcAddrs) / 4);
+    buffer->write(dstAddrs, 4, sizeof(dstAddrs) / 4);
+    buffer->write(&drqMask, sizeof(drqMask), 1);
+    buffer->write(&runMask, sizeof(runMask), 1);
+    buffer->write(ndmaSad, 4, sizeof(ndmaSad) / 4);
+    buffer->write(ndmaDad, 4, sizeof(ndmaDad) / 4);
+    buffer->write(ndmaTcnt, 4, sizeof(ndmaTcnt) / 4);
+    buffer->write(ndmaWcnt, 4, sizeof(ndmaWcnt) / 4);
+    buffer->write(ndmaFdata, 4, sizeof(ndmaFdata) / 4);
+    buffer->write(ndmaCnt, 4, sizeof(ndmaCnt) / 4);
 }
 
-void Ndma::loadState(FILE *file) {
-    // Read DSi state data from the file
+void Ndma::loadState(StateBuffer *buffer) {
+    // Read DSi state data from the buffer
     if (!core->dsiMode) return;
-    fread(srcAddrs, 4, sizeof(srcAddrs) / 4, file);
-    fread(dstAddrs, 4, sizeof(dstAddrs) / 4, file);
-    fread(&drqMask, sizeof(drqMask), 1, file);
-    fread(&runMask, sizeof(runMask), 1, file);
-    fread(ndmaSad, 4, sizeof(ndmaSad) / 4, file);
-    fread(ndmaDad, 4, sizeof(ndmaDad) / 4, file);
-    fread(ndmaTcnt, 4, sizeof(ndmaTcnt) / 4, file);
-    fread(ndmaWcnt, 4, sizeof(ndmaWcnt) / 4, file);
-    fread(ndmaFdata, 4, sizeof(ndmaFdata) / 4, file);
-    fread(ndmaCnt, 4, sizeof(ndmaCnt) / 4, file);
+    buffer->read(srcAddrs, 4, sizeof(srcAddrs) / 4);
+    buffer->read(dstAddrs, 4, sizeof(dstAddrs) / 4);
+    buffer->read(&drqMask, sizeof(drqMask), 1);
+    buffer->read(&runMask, sizeof(runMask), 1);
+    buffer->read(ndmaSad, 4, sizeof(ndmaSad) / 4);
+    buffer->read(ndmaDad, 4, sizeof(ndmaDad) / 4);
+    buffer->read(ndmaTcnt, 4, sizeof(ndmaTcnt) / 4);
+    buffer->read(ndmaWcnt, 4, sizeof(ndmaWcnt) / 4);
+    buffer->read(ndmaFdata, 4, sizeof(ndmaFdata) / 4);
+    buffer->read(ndmaCnt, 4, sizeof(ndmaCnt) / 4);
 }
 
 bool Ndma::shouldTransfer(int i, uint8_t type) {
@@ -74,11 +74,13 @@ void Ndma::clearDrq(uint8_t type) {
 
 void Ndma::update() {
     // Perform scheduled transfers and acknowledge them
+    core->perfTimers.enter(PERF_DMA);
     for (int i = 0; runMask >> i; i++) {
         if (~runMask & BIT(i)) continue;
         transferBlock(i);
     }
     runMask = 0;
+    core->perfTimers.leave();
 }
 
 void Ndma::transferBlock(int i) {
@@ -114,6 +116,7 @@ void Ndma::transferBlock(int i) {
         while (count--) {
             uint32_t value = core->memory.read<uint32_t>(arm7, srcAddrs[i], false);
             core->memory.write<uint32_t>(arm7, dstAddrs[i], value, false);
+            core->metrics.dmaWords++;
             srcAddrs[i] += srcStep;
             dstAddrs[i] += dstStep;
         }
@@ -129,6 +132,7 @@ void Ndma::transferBlock(int i) {
             // Transfer a word and adjust source and destination addresses
             uint32_t value = core->memory.read<uint32_t>(arm7, srcAddrs[i], false);
             core->memory.write<uint32_t>(arm7, dstAddrs[i], value, false);
+            core->metrics.dmaWords++;
             srcAddrs[i] += srcStep;
             dstAddrs[i] += dstStep;
 
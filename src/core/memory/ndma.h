@@ -22,12 +22,13 @@
 #include <cstdint>
 
 class Core;
+class StateBuffer;
 
 class Ndma {
 public:
     Ndma(Core *core, bool arm7): core(core), arm7(arm7) {}
-    void saveState(FILE *file);
-    void loadState(FILE *file);
+    void saveState(StateBuffer *buffer);
+    void loadState(StateBuffer *buffer);
 
     void setDrq(uint8_t type);
     void clearDrq(uint8_t type);
@@ -0,0 +1,160 @@
+/*
+    Copyright 2019-2026 Hydr8gon
+
+    This file is part of NooDS.
+
+    NooDS is free software: you can redistribute it and/or modify it
+    under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    NooDS is distributed in the hope that it will be useful, but
+    WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+    General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with NooDS. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <cstring>
+
+#include "rom_cache.h"
+
+void RomCache::open(FILE *file, size_t size) {
+    // Start caching a ROM file and prefetching from it on a separate thread
+    close();
+    this->file = file;
+    fileSize = size;
+    running = true;
+    thread = new std::thread(&RomCache::runPrefetch, this);
+}
+
+void RomCache::close() {
+    // Stop the prefetch thread if it's running
+    if (thread) {
+        mutex.lock();
+        running = false;
+        mutex.unlock();
+        cond.notify_all();
+        thread->join();
+        delete thread;
+        thread = nullptr;
+    }
+
+    // Forget the file and all cached blocks
+    file = nullptr;
+    queue.clear();
+    for (size_t i = 0; i < maxBlocks; i++)
+        blocks[i] = Block();
+}
+
+void RomCache::read(uint8_t *data, size_t offset, size_t size) {
+    // Copy data from each block in the range, loading blocks that aren't cached
+    while (size > 0) {
+        uint32_t index = offset / blockSize;
+        size_t start = offset % blockSize;
+        size_t count = std::min(size, blockSize - start);
+
+        // Wait for the block if it's being prefetched, and count whether it was ready
+        std::unique_lock<std::mutex> lock(mutex);
+        Block *block;
+        bool waited = false;
+        while ((block = findBlock(index)) && block->loading) {
+            cond.wait(lock);
+            waited = true;
+        }
+        (block && !waited) ? stats.hits++ : stats.misses++;
+
+        // Load the block on this thread if it isn't cached at all
+        if (!block) {
+            block = claimBlock(index);
+            lock.unlock();
+            loadBlock(block);
+            lock.lock();
+            block->loading = false;
+            cond.notify_all();
+        }
+
+        // Copy from the block and mark it as recently used
+        block->lastUse = ++useCount;
+        memcpy(data, &block->data[start], count);
+        data += count;
+        offset += count;
+        size -= count;
+    }
+}
+
+void RomCache::prefetch(size_t offset) {
+    // Queue blocks starting at an offset to be loaded in the background
+    mutex.lock();
+    for (size_t i = 0; i < readahead; i++) {
+        uint32_t index = offset / blockSize + i;
+        if (size_t(index) * blockSize >= fileSize) break;
+        if (!findBlock(index) && std::find(queue.begin(), queue.end(), index) == queue.end())
+            queue.push_back(index);
+    }
+    mutex.unlock();
+    cond.notify_all();
+}
+
+RomCacheStats RomCache::getStats() {
+    // Get a copy of the counters
+    mutex.lock();
+    RomCacheStats copy = stats;
+    mutex.unlock();
+    return copy;
+}
+
+RomCache::Block *RomCache::findBlock(uint32_t index) {
+    // Look for a block in the cache
+    for (size_t i = 0; i < maxBlocks; i++)
+        if (blocks[i].index == index)
+            return &blocks[i];
+    return nullptr;
+}
+
+RomCache::Block *RomCache::claimBlock(uint32_t index) {
+    // Take over the least recently used block that isn't loading, and mark it as loading a new index
+    Block *block = nullptr;
+    for (size_t i = 0; i < maxBlocks; i++) {
+        if (!blocks[i].loading && (!block || blocks[i].lastUse < block->lastUse))
+            block = &blocks[i];
+    }
+    block->index = index;
+    block->loading = true;
+    block->lastUse = ++useCount;
+    return block;
+}
+
+void RomCache::loadBlock(Block *block) {
+    // Read a block from the file, filling anything past the end with zeros
+    block->data.resize(blockSize);
+    fileMutex.lock();
+    fseek(file, size_t(block->index) * blockSize, SEEK_SET);
+    size_t count = fread(&block->data[0], sizeof(uint8_t), blockSize, file);
+    fileMutex.unlock();
+    memset(&block->data[count], 0, blockSize - count);
+}
+
+void RomCache::runPrefetch() {
+    // Load queued blocks until the cache is closed
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        cond.wait(lock, [this] { return !running || !queue.empty(); });
+        if (!running) return;
+        uint32_t index = queue.front();
+        queue.pop_front();
+        if (findBlock(index)) continue;
+
+        // Load the block without holding the lock, so cached reads can still be served
+        Block *block = claimBlock(index);
+        lock.unlock();
+        loadBlock(block);
+        lock.lock();
+        block->loading = false;
+        stats.prefetches++;
+        cond.notify_all();
+    }
+}
@@ -0,0 +1,80 @@
+/*
+    Copyright 2019-2026 Hydr8gon
+
+    This file is part of NooDS.
+
+    NooDS is free software: you can redistribute it and/or modify it
+    under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    NooDS is distributed in the hope that it will be useful, but
+    WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+    General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with NooDS. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct RomCacheStats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t prefetches = 0;
+};
+
+// Caches 64KB blocks of a streamed ROM file, evicting the least recently used block when full
+// Blocks can be prefetched on a background thread, so reads that hit never wait on the disk
+class RomCache {
+public:
+    ~RomCache() { close(); }
+
+    void open(FILE *file, size_t size);
+    void close();
+    bool isOpen() { return file != nullptr; }
+
+    void read(uint8_t *data, size_t offset, size_t size);
+    void prefetch(size_t offset);
+
+    RomCacheStats getStats();
+
+private:
+    static const size_t blockSize = 0x10000;
+    static const size_t maxBlocks = 64;
+    static const size_t readahead = 2;
+
+    struct Block {
+        std::vector<uint8_t> data;
+        uint32_t index = -1;
+        uint64_t lastUse = 0;
+        bool loading = false;
+    };
+
+    FILE *file = nullptr;
+    size_t fileSize = 0;
+    Block blocks[maxBlocks];
+    uint64_t useCount = 0;
+    RomCacheStats stats;
+
+    std::deque<uint32_t> queue;
+    std::thread *thread = nullptr;
+    std::mutex mutex;
+    std::mutex fileMutex;
+    std::condition_variable cond;
+    bool running = false;
+
+    Block *findBlock(uint32_t index);
+    Block *claimBlock(uint32_t index);
+    void loadBlock(Block *block);
+    void runPrefetch();
+};
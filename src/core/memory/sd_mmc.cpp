@@ -22,72 +22,72 @@
 
 SdMmc::~SdMmc() {
     // Close the NAND and SD files
-    fclose(nand);
-    fclose(sd);
+    if (nand) fclose(nand);
+    if (sd) fclose(sd);
 }
 
-void SdMmc::saveState(FILE *file) {
-    // Write DSi state data to the file
+void SdMmc::saveState(StateBuffer *buffer) {
+    // Write DSi state data to the buffer
     if (!core->dsiMode) return;
-    fread(&cardStatus, sizeof(cardStatus), 1, file);
-    fread(&opCond, sizeof(opCond), 1, file);
-    fread(&blockLen, sizeof(blockLen), 1, file);
-    fread(&curAddress, sizeof(curAddress), 1, file);
-    fread(&curBlock, sizeof(curBlock), 1, file);
-    fread(&sdCmd, sizeof(sdCmd), 1, file);
-    fread(&sdPortSelect, sizeof(sdPortSelect), 1, file);
-    fread(&sdCmdParam, sizeof(sdCmdParam), 1, file);
-    fread(&sdData16Blkcnt, sizeof(sdData16Blkcnt), 1, file);
-    fread(sdResponse, 4, sizeof(sdResponse) / 4, file);
-    fread(&sdIrqStatus, sizeof(sdIrqStatus), 1, file);
-    fread(&sdIrqMask, sizeof(sdIrqMask), 1, file);
-    fread(&sdData16Blklen, sizeof(sdData16Blklen), 1, file);
-    fread(&sdErrDetail, sizeof(sdErrDetail), 1, file);
-    fread(&sdData16Fifo, sizeof(sdData16Fifo), 1, file);
-    fread(&sdDataCtl, sizeof(sdDataCtl), 1, file);
-    fread(&sdData32Irq, sizeof(sdData32Irq), 1, file);
-    fread(&sdData32Blklen, sizeof(sdData32Blklen), 1, file);
-    fread(&sdData32Fifo, sizeof(sdData32Fifo), 1, file);
-    SaveStates::writeFifo(dataFifo16, file);
-    SaveStates::writeFifo(dataFifo32, file);
-}
-
-void SdMmc::loadState(FILE *file) {
-    // Read DSi state data from the file
+    buffer->write(&cardStatus, sizeof(cardStatus), 1);
+    buffer->write(&opCond, sizeof(opCond), 1);
+    buffer->write(&blockLen, sizeof(blockLen), 1);
+    buffer->write(&curAddress, sizeof(curAddress), 1);
+    buffer->write(&curBlock, sizeof(curBlock), 1);
+    buffer->write(&sdCmd, sizeof(sdCmd), 1);
+    buffer->write(&sdPortSelect, sizeof(sdPortSelect), 1);
+    buffer->write(&sdCmdParam, sizeof(sdCmdParam), 1);
+    buffer->write(&sdData16Blkcnt, sizeof(sdData16Blkcnt), 1);
+    buffer->write(sdResponse, 4, sizeof(sdResponse) / 4);
+    buffer->write(&sdIrqStatus, sizeof(sdIrqStatus), 1);
+    buffer->write(&sdIrqMask, sizeof(sdIrqMask), 1);
+    buffer->write(&sdData16Blklen, sizeof(sdData16Blklen), 1);
+    buffer->write(&sdErrDetail, sizeof(sdErrDetail), 1);
+    buffer->write(&sdData16Fifo, sizeof(sdData16Fifo), 1);
+    buffer->write(&sdDataCtl, sizeof(sdDataCtl), 1);
+    buffer->write(&sdData32Irq, sizeof(sdData32Irq), 1);
+    buffer->write(&sdData32Blklen, sizeof(sdData32Blklen), 1);
+    buffer->write(&sdData32Fifo, sizeof(sdData32Fifo), 1);
+    SaveStates::writeFifo(dataFifo16, buffer);
+    SaveStates::writeFifo(dataFifo32, buffer);
+}
+
+void SdMmc::loadState(StateBuffer *buffer) {
+    // Read DSi state data from the buffer
     if (!core->dsiMode) return;
-    fread(&cardStatus, sizeof(cardStatus), 1, file);
-    fread(&opCond, sizeof(opCond), 1, file);
-    fread(&blockLen, sizeof(blockLen), 1, file);
-    fread(&curAddress, sizeof(curAddress), 1, file);
-    fread(&curBlock, sizeof(curBlock), 1, file);
-    fread(&sdCmd, sizeof(sdCmd), 1, file);
-    fread(&sdPortSelect, sizeof(sdPortSelect), 1, file);
-    fread(&sdCmdParam, sizeof(sdCmdParam), 1, file);
-    fread(&sdData16Blkcnt, sizeof(sdData16Blkcnt), 1, file);
-    fread(sdResponse, 4, sizeof(sdResponse) / 4, file);
-    fread(&sdIrqStatus, sizeof(sdIrqStatus), 1, file);
-    fread(&sdIrqMask, sizeof(sdIrqMask), 1, file);
-    fread(&sdData16Blklen, sizeof(sdData16Blklen), 1, file);
-    fread(&sdErrDetail, sizeof(sdErrDetail), 1, file);
-    fread(&sdData16Fifo, sizeof(sdData16Fifo), 1, file);
-    fread(&sdDataCtl, sizeof(sdDataCtl), 1, file);
-    fread(&sdData32Irq, sizeof(sdData32Irq), 1, file);
-    fread(&sdData32Blklen, sizeof(sdData32Blklen), 1, file);
-    fread(&sdData32Fifo, sizeof(sdData32Fifo), 1, file);
-    SaveStates::readFifo(dataFifo16, file);
-    SaveStates::readFifo(dataFifo32, file);
+    buffer->read(&cardStatus, sizeof(cardStatus), 1);
+    buffer->read(&opCond, sizeof(opCond), 1);
+    buffer->read(&blockLen, sizeof(blockLen), 1);
+    buffer->read(&curAddress, sizeof(curAddress), 1);
+    buffer->read(&curBlock, sizeof(curBlock), 1);
+    buffer->read(&sdCmd, sizeof(sdCmd), 1);
+    buffer->read(&sdPortSelect, sizeof(sdPortSelect), 1);
+    buffer->read(&sdCmdParam, sizeof(sdCmdParam), 1);
+    buffer->read(&sdData16Blkcnt, sizeof(sdData16Blkcnt), 1);
+    buffer->read(sdResponse, 4, sizeof(sdResponse) / 4);
+    buffer->read(&sdIrqStatus, sizeof(sdIrqStatus), 1);
+    buffer->read(&sdIrqMask, sizeof(sdIrqMask), 1);
+    buffer->read(&sdData16Blklen, sizeof(sdData16Blklen), 1);
+    buffer->read(&sdErrDetail, sizeof(sdErrDetail), 1);
+    buffer->read(&sdData16Fifo, sizeof(sdData16Fifo), 1);
+    buffer->read(&sdDataCtl, sizeof(sdDataCtl), 1);
+    buffer->read(&sdData32Irq, sizeof(sdData32Irq), 1);
+    buffer->read(&sdData32Blklen, sizeof(sdData32Blklen), 1);
+    buffer->read(&sdData32Fifo, sizeof(sdData32Fifo), 1);
+    SaveStates::readFifo(dataFifo16, buffer);
+    SaveStates::readFifo(dataFifo32, buffer);
 }
 
 uint32_t *SdMmc::init() {
     // Check the SD's capacity so cards over 2GB can be handled differently
-    if (sd = fopen(Settings::sdImagePath.c_str(), "rb+")) {
+    if (sd = fopen(core->config.sdImagePath.c_str(), "rb+")) {
         fseek(sd, 0, SEEK_END);
         sdhc = (ftell(sd) > 0x40000000);
         LOG_INFO("SD card is being treated as %s-capacity\n", sdhc ? "high" : "standard");
     }
 
     // Try to open a NAND dump and load IDs from its nocash footer
-    if (!(nand = fopen(Settings::dsiNandPath.c_str(), "rb+"))) return nullptr;
+    if (!(nand = fopen(core->config.dsiNandPath.c_str(), "rb+"))) return nullptr;
     fseek(nand, -0x20, SEEK_END);
     fread(consoleId, sizeof(uint32_t), 2, nand);
     fseek(nand, -0x30, SEEK_END);
@@ -95,6 +95,15 @@ uint32_t *SdMmc::init() {
     return mmcCid;
 }
 
+void SdMmc::inherit(SdMmc &parent) {
+    // Open the parent's NAND and SD files read-only, so forks can't corrupt them with conflicting writes
+    if (parent.sd) sd = fopen(core->config.sdImagePath.c_str(), "rb");
+    if (parent.nand) nand = fopen(core->config.dsiNandPath.c_str(), "rb");
+    sdhc = parent.sdhc;
+    memcpy(consoleId, parent.consoleId, sizeof(consoleId));
+    memcpy(mmcCid, parent.mmcCid, sizeof(mmcCid));
+}
+
 void SdMmc::sendInterrupt(int bit) {
     // Set the interrupt's request bit
     sdIrqStatus |= BIT(bit);
@@ -23,15 +23,17 @@
 #include <deque>
 
 class Core;
+class StateBuffer;
 
 class SdMmc {
 public:
     SdMmc(Core *core): core(core) {}
     ~SdMmc();
-    void saveState(FILE *file);
-    void loadState(FILE *file);
+    void saveState(StateBuffer *buffer);
+    void loadState(StateBuffer *buffer);
 
     uint32_t *init();
+    void inherit(SdMmc &parent);
     void readBlock();
     void writeBlock();
 
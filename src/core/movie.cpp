@@ -0,0 +1,215 @@
+/*
+    Copyright 2019-2026 Hydr8gon
+
+    This file is part of NooDS.
+
+    NooDS is free software: you can redistribute it and/or modify it
+    under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    NooDS is distributed in the hope that it will be useful, but
+    WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+    General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with NooDS. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <cstring>
+#include <ctime>
+
+#include "core.h"
+
+enum MovieFlags {
+    MOVIE_STATE = BIT(0),
+    MOVIE_RAM = BIT(1),
+    MOVIE_GBA = BIT(2)
+};
+
+static const uint8_t movieTag[] = { 'N', 'M', 'O', 'V' };
+static const uint32_t movieVersion = 1;
+
+static bool readFrame(FILE *file, MovieFrame &entry) {
+    // Read a frame's input and hashes from a movie file
+    size_t count = fread(&entry.input.keyInput, sizeof(uint16_t), 1, file);
+    count += fread(&entry.input.extKeyIn, sizeof(uint16_t), 1, file);
+    count += fread(&entry.input.touchX, sizeof(uint16_t), 1, file);
+    count += fread(&entry.input.touchY, sizeof(uint16_t), 1, file);
+    count += fread(&entry.videoHash, sizeof(uint32_t), 1, file);
+    count += fread(&entry.audioHash, sizeof(uint32_t), 1, file);
+    count += fread(&entry.ramHash, sizeof(uint32_t), 1, file);
+    return count == 7;
+}
+
+static void writeFrame(FILE *file, MovieFrame &entry) {
+    // Write a frame's input and hashes to a movie file
+    fwrite(&entry.input.keyInput, sizeof(uint16_t), 1, file);
+    fwrite(&entry.input.extKeyIn, sizeof(uint16_t), 1, file);
+    fwrite(&entry.input.touchX, sizeof(uint16_t), 1, file);
+    fwrite(&entry.input.touchY, sizeof(uint16_t), 1, file);
+    fwrite(&entry.videoHash, sizeof(uint32_t), 1, file);
+    fwrite(&entry.audioHash, sizeof(uint32_t), 1, file);
+    fwrite(&entry.ramHash, sizeof(uint32_t), 1, file);
+}
+
+bool Movie::record(std::string path, bool fromState, bool hashRam) {
+    // Power-on movies have to start before the first frame, or they can't be replayed
+    stop();
+    if (!fromState && core->getMetrics().frame != 0)
+        return false;
+
+    // Take a state to start from, and restore it so recording starts the same way playback will
+    state.clear();
+    if (fromState && (!core->saveStates.snapshot(state) || core->saveStates.restore(state) != STATE_SUCCESS))
+        return false;
+
+    // Write the header, with the state embedded if there is one
+    file = fopen(path.c_str(), "wb");
+    if (!file) return false;
+    uint32_t flags = (fromState ? MOVIE_STATE : 0) | (hashRam ? MOVIE_RAM : 0) | (core->gbaMode ? MOVIE_GBA : 0);
+    uint32_t stateSize = state.getSize();
+    startTime = std::time(nullptr);
+    fwrite(movieTag, sizeof(uint8_t), 4, file);
+    fwrite(&movieVersion, sizeof(uint32_t), 1, file);
+    fwrite(&flags, sizeof(uint32_t), 1, file);
+    fwrite(&startTime, sizeof(int64_t), 1, file);
+    fwrite(&stateSize, sizeof(uint32_t), 1, file);
+    fwrite(state.getData(), sizeof(uint8_t), stateSize, file);
+
+    // Start recording with the frontend's current input
+    this->hashRam = hashRam;
+    stats = MovieStats();
+    stats.recording = true;
+    start();
+    input = core->input.getState();
+    return true;
+}
+
+bool Movie::play(std::string path) {
+    // Check the header of the movie file
+    stop();
+    FILE *in = fopen(path.c_str(), "rb");
+    if (!in) return false;
+    uint8_t tag[4];
+    uint32_t fileVersion, flags, stateSize;
+    int64_t time;
+    if (fread(tag, sizeof(uint8_t), 4, in) != 4 || memcmp(tag, movieTag, 4) ||
+            fread(&fileVersion, sizeof(uint32_t), 1, in) != 1 || fileVersion != movieVersion ||
+            fread(&flags, sizeof(uint32_t), 1, in) != 1 || bool(flags & MOVIE_GBA) != core->gbaMode ||
+            fread(&time, sizeof(int64_t), 1, in) != 1 || fread(&stateSize, sizeof(uint32_t), 1, in) != 1) {
+        fclose(in);
+        return false;
+    }
+
+    // Read the embedded state and every recorded frame
+    state.clear();
+    bool success = state.resize(stateSize) && fread(state.getData(), sizeof(uint8_t), stateSize, in) == stateSize;
+    MovieFrame entry;
+    while (success && readFrame(in, entry))
+        frames.push_back(entry);
+    fclose(in);
+
+    // Start from the embedded state, or make sure nothing has run yet for power-on movies
+    if (!success || frames.empty() || ((flags & MOVIE_STATE) ? (core->saveStates.restore(state) != STATE_SUCCESS) :
+            (core->getMetrics().frame != 0))) {
+        frames.clear();
+        return false;
+    }
+
+    // Start playing with the input of the first frame
+    hashRam = (flags & MOVIE_RAM);
+    startTime = time;
+    playing = true;
+    stats = MovieStats();
+    stats.playing = true;
+    start();
+    core->input.apply(frames[0].input);
+    return true;
+}
+
+void Movie::start() {
+    // Take control of everything that would otherwise depend on the host
+    frame = 0;
+    core->input.setLatched(true);
+    core->rtc.setFixedTime(startTime);
+    core->spu.setHashing(true);
+}
+
+void Movie::stop() {
+    // Finish the movie and give control back to the frontend
+    if (!isActive()) return;
+    if (file) {
+        fclose(file);
+        file = nullptr;
+    }
+    playing = false;
+    frames.clear();
+    stats.length = frame;
+    stats.recording = stats.playing = false;
+    core->input.setLatched(false);
+    core->rtc.clearFixedTime();
+    core->spu.setHashing(false);
+}
+
+void Movie::hashFrame(MovieFrame &entry) {
+    // Hash both framebuffers, the audio since the last frame, and optionally main RAM
+    uint32_t top = SaveStates::checksum((uint8_t*)core->gpu2D[0].getFramebuffer(), 256 * 192 * sizeof(uint32_t));
+    uint32_t bottom = SaveStates::checksum((uint8_t*)core->gpu2D[1].getFramebuffer(), 256 * 192 * sizeof(uint32_t));
+    entry.videoHash = (top * 0x9E3779B1) ^ bottom;
+    entry.audioHash = core->spu.takeHash();
+    entry.ramHash = hashRam ? SaveStates::checksum(core->memory.getRam(), core->dsiMode ? 0x1000000 : 0x400000) : 0;
+}
+
+void Movie::endFrame() {
+    // Hash the frame that just ended if a movie is active
+    if (!isActive()) return;
+    MovieFrame entry;
+    hashFrame(entry);
+
+    if (file) {
+        // Record the frame along with the input it ran with, and latch the frontend's input for the next one
+        entry.input = input;
+        writeFrame(file, entry);
+        frame++;
+        core->input.apply(core->input.getHostState());
+        input = core->input.getState();
+    }
+    else {
+        // Compare the frame with the recording, and report the first mismatch
+        MovieFrame &expected = frames[frame];
+        uint8_t flags = ((entry.videoHash != expected.videoHash) ? MISMATCH_VIDEO : 0) |
+            ((entry.audioHash != expected.audioHash) ? MISMATCH_AUDIO : 0) |
+            ((entry.ramHash != expected.ramHash) ? MISMATCH_RAM : 0);
+        if (flags) {
+            if (!stats.mismatches) {
+                LOG_WARN("Movie mismatch at frame %u (flags 0x%X)\n", frame, flags);
+                stats.firstMismatch = frame;
+            }
+            stats.mismatches++;
+            stats.mismatchFlags |= flags;
+        }
+
+        // Move to the input of the next frame, or finish playing once there are no more
+        if (++frame >= frames.size())
+            return stop();
+        core->input.apply(frames[frame].input);
+    }
+
+    // Advance the fixed RTC time along with the frames
+    core->rtc.setFixedTime(startTime + frame / 60);
+}
+
+MovieStats Movie::getStats() {
+    // Fill in the current position and return the stats
+    MovieStats copy = stats;
+    if (isActive()) {
+        copy.frame = frame;
+        copy.length = file ? frame : frames.size();
+    }
+    else {
+        copy.frame = copy.length;
+    }
+    return copy;
+}
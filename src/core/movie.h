@@ -0,0 +1,88 @@
+/*
+    Copyright 2019-2026 Hydr8gon
+
+    This file is part of NooDS.
+
+    NooDS is free software: you can redistribute it and/or modify it
+    under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    NooDS is distributed in the hope that it will be useful, but
+    WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+    General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with NooDS. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "save_states.h"
+#include "io/input.h"
+
+class Core;
+
+enum MovieMismatch {
+    MISMATCH_VIDEO = 1 << 0,
+    MISMATCH_AUDIO = 1 << 1,
+    MISMATCH_RAM = 1 << 2
+};
+
+struct MovieStats {
+    bool recording = false;
+    bool playing = false;
+    uint32_t frame = 0;
+    uint32_t length = 0;
+    uint32_t mismatches = 0;
+    int64_t firstMismatch = -1;
+    uint8_t mismatchFlags = 0;
+};
+
+struct MovieFrame {
+    InputState input;
+    uint32_t videoHash = 0;
+    uint32_t audioHash = 0;
+    uint32_t ramHash = 0;
+};
+
+// Records input for every frame, starting from power-on or an embedded state, and replays it deterministically
+// Each frame stores hashes of the framebuffers, audio, and optionally RAM, which are checked during replay
+// Input is latched while a movie is active, and the RTC runs from a fixed time stored in the movie
+// These functions should only be called while the core isn't running, like with save states
+class Movie {
+public:
+    Movie(Core *core): core(core) {}
+    ~Movie() { if (file) fclose(file); }
+
+    bool record(std::string path, bool fromState, bool hashRam = false);
+    bool play(std::string path);
+    void stop();
+
+    bool isActive() { return file || playing; }
+    void endFrame();
+    MovieStats getStats();
+
+private:
+    Core *core;
+
+    FILE *file = nullptr;
+    bool playing = false;
+    bool hashRam = false;
+    int64_t startTime = 0;
+    uint32_t frame = 0;
+
+    std::vector<MovieFrame> frames;
+    StateBuffer state;
+    InputState input;
+    MovieStats stats;
+
+    void start();
+    void hashFrame(MovieFrame &entry);
+};
@@ -0,0 +1,58 @@
+/*
+    Copyright 2019-2026 Hydr8gon
+
+    This file is part of NooDS.
+
+    NooDS is free software: you can redistribute it and/or modify it
+    under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    NooDS is distributed in the hope that it will be useful, but
+    WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+    General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with NooDS. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include "perf_timers.h"
+
+const char *PerfTimers::names[] = { "cpu", "scheduler", "gpu2d", "geometry3d", "raster3d", "spu", "dma" };
+const int PerfTimers::maxDepth;
+
+void PerfTimers::setEnabled(bool value) {
+    // Start timing zones entered from the calling thread, or stop timing
+    enabled = value;
+    owner = std::this_thread::get_id();
+    depth = 0;
+}
+
+void PerfTimers::reset() {
+    // Clear the accumulated times
+    for (int i = 0; i < PERF_MAX; i++)
+        nanos[i] = 0;
+}
+
+void PerfTimers::push(PerfZone zone) {
+    // Charge the time so far to the current zone and switch to the new one
+    if (std::this_thread::get_id() != owner) return;
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    if (depth > 0)
+        nanos[stack[std::min(depth, maxDepth) - 1]] += std::chrono::duration_cast<std::chrono::nanoseconds>(now - last).count();
+    if (depth < maxDepth)
+        stack[depth] = zone;
+    depth++;
+    last = now;
+}
+
+void PerfTimers::pop() {
+    // Charge the time so far to the current zone and return to the one it was entered from
+    if (std::this_thread::get_id() != owner || depth == 0) return;
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    nanos[stack[std::min(depth, maxDepth) - 1]] += std::chrono::duration_cast<std::chrono::nanoseconds>(now - last).count();
+    depth--;
+    last = now;
+}
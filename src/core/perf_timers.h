@@ -0,0 +1,64 @@
+/*
+    Copyright 2019-2026 Hydr8gon
+
+    This file is part of NooDS.
+
+    NooDS is free software: you can redistribute it and/or modify it
+    under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    NooDS is distributed in the hope that it will be useful, but
+    WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+    General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with NooDS. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <thread>
+
+enum PerfZone {
+    PERF_CPU = 0,
+    PERF_SCHED,
+    PERF_GPU2D,
+    PERF_GEOMETRY,
+    PERF_RASTER,
+    PERF_SPU,
+    PERF_DMA,
+    PERF_MAX
+};
+
+// Splits the emulation thread's host time between subsystems, for benchmarking
+// Zones nest, and time is only counted towards the innermost one; other threads are ignored
+class PerfTimers {
+public:
+    void setEnabled(bool value);
+    bool isEnabled() { return enabled; }
+    void reset();
+
+    uint64_t getNanos(PerfZone zone) { return nanos[zone]; }
+    static const char *getName(PerfZone zone) { return names[zone]; }
+
+    void enter(PerfZone zone) { if (enabled) push(zone); }
+    void leave() { if (enabled) pop(); }
+
+private:
+    static const char *names[PERF_MAX];
+    static const int maxDepth = 16;
+
+    bool enabled = false;
+    std::thread::id owner;
+    std::chrono::steady_clock::time_point last;
+    uint64_t nanos[PERF_MAX] = {};
+    PerfZone stack[maxDepth] = {};
+    int depth = 0;
+
+    void push(PerfZone zone);
+    void pop();
+};
@@ -0,0 +1,174 @@
+/*
+    Copyright 2019-2026 Hydr8gon
+
+    This file is part of NooDS.
+
+    NooDS is free software: you can redistribute it and/or modify it
+    under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    NooDS is distributed in the hope that it will be useful, but
+    WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+    General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with NooDS. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <cstring>
+
+#include "core.h"
+
+static FORCE_INLINE uint64_t load64(const uint8_t *data) {
+    // Load a word from a possibly unaligned address
+    uint64_t value;
+    memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+static void xorBytes(uint8_t *dst, const uint8_t *src, uint32_t size) {
+    // XOR data into a destination, a word at a time where possible
+    uint32_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        uint64_t value = load64(&dst[i]) ^ load64(&src[i]);
+        memcpy(&dst[i], &value, sizeof(value));
+    }
+    for (; i < size; i++)
+        dst[i] ^= src[i];
+}
+
+void Rewind::endFrame() {
+    // Mark a snapshot to be taken once the core stops running for the frame
+    if (core->config.rewindInterval > 0 && ++frameCount >= core->config.rewindInterval) {
+        frameCount = 0;
+        capturePending = true;
+    }
+}
+
+void Rewind::update() {
+    // Handle a rewind requested from another thread, or take a pending snapshot
+    // This happens between runs of the core, where it's safe to save and restore state
+    if (int frames = requested.exchange(0))
+        rewind(frames);
+    else if (capturePending)
+        capture();
+}
+
+void Rewind::capture() {
+    // Take a full snapshot of the current state
+    capturePending = false;
+    if (!core->saveStates.snapshot(scratch)) return;
+
+    // Store the previous snapshot as a delta against the new one, and make the new one the head
+    if (head.getSize()) {
+        encodeDelta(work, head, scratch);
+        deltas.emplace_back(work.begin(), work.end());
+        deltaBytes += work.size();
+    }
+    std::swap(head, scratch);
+
+    // Drop the oldest deltas until the history fits in the memory budget
+    size_t budget = size_t(core->config.rewindBudget) << 20;
+    while (!deltas.empty() && head.getSize() + deltaBytes > budget) {
+        deltaBytes -= deltas.front().size();
+        deltas.pop_front();
+    }
+}
+
+bool Rewind::rewind(int frames) {
+    // Walk back through the deltas to the snapshot nearest the requested frame, limited to what's stored
+    // The head is already some frames behind, which is a full interval if its successor hasn't been captured yet
+    if (!head.getSize() || frames < 0) return false;
+    int interval = std::max(1, core->config.rewindInterval);
+    int behind = frameCount + (capturePending ? interval : 0);
+    size_t steps = std::min<size_t>((std::max(0, frames - behind) + interval / 2) / interval, deltas.size());
+    for (size_t i = 0; i < steps; i++) {
+        applyDelta(deltas.back(), head);
+        deltaBytes -= deltas.back().size();
+        deltas.pop_back();
+    }
+
+    // Load the reconstructed state, and restart the interval from it
+    frameCount = 0;
+    capturePending = false;
+    return core->saveStates.restore(head) == STATE_SUCCESS;
+}
+
+void Rewind::clear() {
+    // Discard all stored history
+    deltas.clear();
+    deltaBytes = 0;
+    head.clear();
+    frameCount = 0;
+    capturePending = false;
+}
+
+RewindStats Rewind::getStats() {
+    // Report how much history is stored and what it costs
+    RewindStats stats;
+    stats.snapshots = deltas.size() + (head.getSize() ? 1 : 0);
+    stats.stateBytes = head.getSize();
+    stats.deltaBytes = deltaBytes;
+    stats.budgetBytes = size_t(core->config.rewindBudget) << 20;
+    int interval = std::max(1, core->config.rewindInterval);
+    stats.framesAvailable = deltas.size() * interval + frameCount + (capturePending ? interval : 0);
+    return stats;
+}
+
+void Rewind::encodeDelta(std::vector<uint8_t> &delta, StateBuffer &prev, StateBuffer &cur) {
+    // Start the delta with the previous size, so the state can be resized when it's applied
+    uint32_t size = prev.getSize();
+    uint32_t curSize = cur.getSize();
+    uint32_t common = std::min(size, curSize) & ~7;
+    const uint8_t *p = prev.getData(), *c = cur.getData();
+    delta.resize(sizeof(size));
+    memcpy(&delta[0], &size, sizeof(size));
+
+    // Encode the previous state as runs of unchanged bytes followed by runs of XORed bytes
+    // Words are compared 8 bytes at a time, and anything past the common size is stored whole
+    for (uint32_t i = 0; i < size;) {
+        uint32_t start = i;
+        while (i < common && load64(&p[i]) == load64(&c[i])) i += 8;
+        uint32_t skip = i - start;
+        start = i;
+        while (i < common && load64(&p[i]) != load64(&c[i])) i += 8;
+        if (i >= common) i = size;
+        uint32_t length = i - start;
+        if (!length) break;
+
+        // Append the run header and the XORed data
+        size_t offset = delta.size();
+        delta.resize(offset + 8 + length);
+        uint8_t *out = &delta[offset];
+        memcpy(&out[0], &skip, sizeof(skip));
+        memcpy(&out[4], &length, sizeof(length));
+        memcpy(&out[8], &p[start], length);
+        if (start < curSize)
+            xorBytes(&out[8], &c[start], std::min(length, curSize - start));
+    }
+}
+
+void Rewind::applyDelta(std::vector<uint8_t> &delta, StateBuffer &state) {
+    // Resize the state to the previous size, clearing any new space so it XORs correctly
+    uint32_t size, oldSize = state.getSize();
+    memcpy(&size, &delta[0], sizeof(size));
+    state.resize(size);
+    if (size > oldSize)
+        memset(&state.getData()[oldSize], 0, size - oldSize);
+
+    // Undo the XOR on each changed run, leaving unchanged runs in place
+    uint8_t *data = state.getData();
+    uint32_t position = 0;
+    for (size_t i = sizeof(size); i < delta.size();) {
+        uint32_t skip, length;
+        memcpy(&skip, &delta[i + 0], sizeof(skip));
+        memcpy(&length, &delta[i + 4], sizeof(length));
+        position += skip;
+        xorBytes(&data[position], &delta[i + 8], length);
+        position += length;
+        i += 8 + length;
+    }
+}
@@ -0,0 +1,70 @@
+/*
+    Copyright 2019-2026 Hydr8gon
+
+    This file is part of NooDS.
+
+    NooDS is free software: you can redistribute it and/or modify it
+    under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    NooDS is distributed in the hope that it will be useful, but
+    WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+    General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with NooDS. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+#include "save_states.h"
+
+class Core;
+
+struct RewindStats {
+    uint32_t snapshots = 0;
+    size_t stateBytes = 0;
+    size_t deltaBytes = 0;
+    size_t budgetBytes = 0;
+    uint32_t framesAvailable = 0;
+};
+
+// Keeps a bounded history of snapshots for rewinding, taken every few frames
+// The newest snapshot is stored in full, with older ones as reverse XOR deltas against their successors
+// Unchanged runs are skipped in the deltas, so mostly static memory like VRAM costs almost nothing
+class Rewind {
+public:
+    Rewind(Core *core): core(core), requested(0) {}
+
+    void endFrame();
+    bool isPending() { return capturePending || requested.load(std::memory_order_relaxed); }
+    void update();
+
+    void request(int frames) { requested.store(frames); }
+    bool rewind(int frames);
+    void clear();
+
+    RewindStats getStats();
+
+private:
+    Core *core;
+
+    StateBuffer head, scratch;
+    std::deque<std::vector<uint8_t>> deltas;
+    std::vector<uint8_t> work;
+    size_t deltaBytes = 0;
+    int frameCount = 0;
+    bool capturePending = false;
+    std::atomic<int> requested;
+
+    void capture();
+    void encodeDelta(std::vector<uint8_t> &delta, StateBuffer &prev, StateBuffer &cur);
+    void applyDelta(std::vector<uint8_t> &delta, StateBuffer &state);
+};
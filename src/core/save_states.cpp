@@ -17,10 +17,69 @@
     along with NooDS. If not, see <https://www.gnu.org/licenses/>.
 */
 
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
 #include "core.h"
+#include "lz4.h"
+
+enum SectionFlags {
+    SECTION_COMPRESSED = BIT(0),
+    SECTION_CHECKSUM = BIT(1)
+};
 
 const char *SaveStates::stateTag = "NOOD";
-const uint32_t SaveStates::stateVersion = 10;
+const uint32_t SaveStates::stateVersion = 13;
+const uint32_t SaveStates::headerSize;
+const uint32_t SaveStates::sectionHeaderSize;
+const uint32_t SaveStates::blockSize;
+
+// Define a section for a component, using its save and load functions
+#define SECTION(tag, comp) StateSection(tag, [=](StateBuffer *b) { comp.saveState(b); }, \
+    [=](StateBuffer *b) { comp.loadState(b); })
+
+SaveStates::SaveStates(Core *core): core(core), saving(false), savePending(false) {
+    // Set up the sections in the order components are saved and loaded
+    sections = {
+        SECTION("CORE", (*core)),
+        SECTION("AES ", core->aes),
+        SECTION("CGBA", core->cartridgeGba),
+        SECTION("CNDS", core->cartridgeNds),
+        SECTION("CP15", core->cp15),
+        SECTION("DVSQ", core->divSqrt),
+        SECTION("DMA9", core->dma[0]),
+        SECTION("DMA7", core->dma[1]),
+        SECTION("GPU ", core->gpu),
+        SECTION("G2DA", core->gpu2D[0]),
+        SECTION("G2DB", core->gpu2D[1]),
+        SECTION("G3D ", core->gpu3D),
+        SECTION("G3DR", core->gpu3DRenderer),
+        SECTION("HLE7", core->hleArm7),
+        SECTION("BIO9", core->hleBios[0]),
+        SECTION("BIO7", core->hleBios[1]),
+        SECTION("BIOG", core->hleBios[2]),
+        SECTION("I2C ", core->i2c),
+        SECTION("ARM9", core->interpreter[0]),
+        SECTION("ARM7", core->interpreter[1]),
+        SECTION("IPC ", core->ipc),
+        SECTION("MEM ", core->memory),
+        SECTION("NDM9", core->ndma[0]),
+        SECTION("NDM7", core->ndma[1]),
+        SECTION("RTC ", core->rtc),
+        SECTION("SDMC", core->sdMmc),
+        SECTION("SPI ", core->spi),
+        SECTION("SPU ", core->spu),
+        SECTION("TMR9", core->timers[0]),
+        SECTION("TMR7", core->timers[1]),
+        SECTION("WIFI", core->wifi)
+    };
+}
+
+SaveStates::~SaveStates() {
+    // Let any background save finish before the buffers go away
+    waitSave();
+}
 
 void SaveStates::setPath(std::string path, bool gba) {
     // Set the NDS or GBA state path
@@ -32,13 +91,13 @@ void SaveStates::setFd(int fd, bool gba) {
     (gba ? gbaFd : ndsFd) = fd;
 }
 
-FILE *SaveStates::openFile(const char *mode) {
+FILE *SaveStates::openFile(const char *mode, bool gba) {
     // Open the NDS or GBA state file based on what's running
-    if (gbaFd != -1 && (core->gbaMode || ndsFd == -1))
+    if (gbaFd != -1 && (gba || ndsFd == -1))
         return fdopen(dup(gbaFd), mode);
     else if (ndsFd != -1)
         return fdopen(dup(ndsFd), mode);
-    else if (gbaPath != "" && (core->gbaMode || ndsPath == ""))
+    else if (gbaPath != "" && (gba || ndsPath == ""))
         return fopen(gbaPath.c_str(), mode);
     else if (ndsPath != "")
         return fopen(ndsPath.c_str(), mode);
@@ -47,7 +106,7 @@ FILE *SaveStates::openFile(const char *mode) {
 
 StateResult SaveStates::checkState() {
     // Try to open the state file, if it exists
-    FILE *file = openFile("rb");
+    FILE *file = openFile("rb", core->gbaMode);
     if (!file) return STATE_FILE_FAIL;
     fseek(file, 0, SEEK_END);
     uint32_t size = ftell(file);
@@ -72,87 +131,369 @@ StateResult SaveStates::checkState() {
     return STATE_SUCCESS;
 }
 
-bool SaveStates::saveState() {
-    // Open the state file and write the header
-    FILE *file = openFile("wb");
+bool StateBuffer::reserve(size_t bytes) {
+    // Check if a caller-supplied span is large enough
+    if (bytes <= capacity) return true;
+    if (external) return false;
+
+    // Grow the arena geometrically to keep reallocations rare
+    arena.resize(std::max<size_t>(bytes, capacity * 2));
+    data = arena.data();
+    capacity = arena.size();
+    return true;
+}
+
+bool StateBuffer::resize(size_t bytes) {
+    // Set the amount of valid data, for when it's filled externally
+    if (!reserve(bytes)) return false;
+    size = bytes;
+    position = 0;
+    return true;
+}
+
+uint32_t SaveStates::checksum(const uint8_t *data, size_t size) {
+    // Hash data in 4 independent lanes, so it runs at close to memory speed
+    static const uint32_t prime1 = 0x9E3779B1, prime2 = 0x85EBCA77, prime3 = 0xC2B2AE3D;
+    uint32_t lanes[4] = { prime1 + prime2, prime2, 0, 0 - prime1 };
+    size_t i = 0;
+    for (; i + 16 <= size; i += 16) {
+        for (int j = 0; j < 4; j++) {
+            uint32_t value;
+            memcpy(&value, &data[i + j * 4], sizeof(value));
+            lanes[j] += value * prime2;
+            lanes[j] = ((lanes[j] << 13) | (lanes[j] >> 19)) * prime1;
+        }
+    }
+
+    // Combine the lanes and mix in any remaining bytes
+    uint32_t hash = ((lanes[0] << 1) | (lanes[0] >> 31)) + ((lanes[1] << 7) | (lanes[1] >> 25)) +
+        ((lanes[2] << 12) | (lanes[2] >> 20)) + ((lanes[3] << 18) | (lanes[3] >> 14)) + uint32_t(size);
+    for (; i < size; i++) {
+        hash += data[i] * prime3;
+        hash = ((hash << 11) | (hash >> 21)) * prime1;
+    }
+
+    // Avalanche the final bits
+    hash ^= hash >> 15;
+    hash *= prime2;
+    hash ^= hash >> 13;
+    hash *= prime3;
+    return hash ^ (hash >> 16);
+}
+
+void SaveStates::runParallel(size_t count, const std::function<void(size_t)> &job) {
+    // Spread jobs across a few threads, or run them inline if there's only one
+    size_t threads = std::min<size_t>(std::min<size_t>(count, 8), std::max(1U, std::thread::hardware_concurrency()));
+    std::atomic<size_t> next(0);
+    auto worker = [&]() {
+        for (size_t i; (i = next.fetch_add(1)) < count;)
+            job(i);
+    };
+
+    // Use the current thread as one of the workers
+    std::vector<std::thread> workers;
+    for (size_t i = 1; i < threads; i++)
+        workers.emplace_back(worker);
+    worker();
+    for (size_t i = 0; i < workers.size(); i++)
+        workers[i].join();
+}
+
+bool SaveStates::parseSections(StateBuffer &buffer, std::vector<SectionInfo> &infos) {
+    // Read section headers until the end of the state, making sure each one fits
+    infos.clear();
+    uint8_t *data = buffer.getData();
+    for (size_t offset = headerSize; offset < buffer.getSize();) {
+        if (buffer.getSize() - offset < sectionHeaderSize) return false;
+        SectionInfo info;
+        info.tag = &data[offset];
+        memcpy(&info.flags, &data[offset + 4], sizeof(uint32_t));
+        memcpy(&info.size, &data[offset + 8], sizeof(uint32_t));
+        memcpy(&info.storedSize, &data[offset + 12], sizeof(uint32_t));
+        memcpy(&info.checksum, &data[offset + 16], sizeof(uint32_t));
+        offset += sectionHeaderSize;
+        if (buffer.getSize() - offset < info.storedSize) return false;
+
+        // Point to the data directly if it isn't compressed
+        if (!(info.flags & SECTION_COMPRESSED) && info.size != info.storedSize) return false;
+        info.stored = &data[offset];
+        info.data = (info.flags & SECTION_COMPRESSED) ? nullptr : info.stored;
+        infos.push_back(info);
+        offset += info.storedSize;
+    }
+    return true;
+}
+
+bool SaveStates::unpackSections(std::vector<SectionInfo*> &infos) {
+    struct Block {
+        const uint8_t *src;
+        uint8_t *dst;
+        uint32_t srcSize, dstSize;
+        bool raw;
+    };
+
+    // Reserve space for all the compressed sections that will be loaded
+    // Sizes are checked against what the stored data could expand to first, so bad headers can't cause huge allocations
+    size_t total = 0;
+    for (size_t i = 0; i < infos.size(); i++) {
+        SectionInfo *info = infos[i];
+        if (!info || !(info->flags & SECTION_COMPRESSED)) continue;
+        uint64_t blocks = (uint64_t(info->size) + blockSize - 1) / blockSize;
+        if (info->size > Lz4::maxExpanded(info->storedSize) || blocks * 4 > info->storedSize) return false;
+        total += info->size;
+    }
+    if (!sectionBuffer.resize(total)) return false;
+
+    // Split each compressed section into its blocks, checking that they fit
+    std::vector<Block> blocks;
+    uint8_t *out = sectionBuffer.getData();
+    for (size_t i = 0; i < infos.size(); i++) {
+        SectionInfo *info = infos[i];
+        if (!info || !(info->flags & SECTION_COMPRESSED)) continue;
+        info->data = out;
+        const uint8_t *in = info->stored, *inEnd = in + info->storedSize;
+        for (uint32_t done = 0; done < info->size; done += blockSize) {
+            uint32_t header;
+            if (inEnd - in < 4) return false;
+            memcpy(&header, in, sizeof(header));
+            Block block = { in + 4, out, header & ~BIT(31), std::min(blockSize, info->size - done) };
+            block.raw = (header & BIT(31));
+            if (size_t(inEnd - block.src) < block.srcSize) return false;
+            blocks.push_back(block);
+            in = block.src + block.srcSize;
+            out += block.dstSize;
+        }
+    }
+
+    // Decompress the blocks in parallel, or copy them if they were stored raw
+    std::atomic<bool> success(true);
+    runParallel(blocks.size(), [&](size_t i) {
+        Block &block = blocks[i];
+        if (!block.raw && !Lz4::decompress(block.src, block.srcSize, block.dst, block.dstSize))
+            success.store(false);
+        else if (block.raw && block.srcSize != block.dstSize)
+            success.store(false);
+        else if (block.raw)
+            memcpy(block.dst, block.src, block.srcSize);
+    });
+    return success.load();
+}
+
+void SaveStates::packSections(StateBuffer &src, StateBuffer &dst) {
+    // Get the sections from an in-memory state, which are stored uncompressed
+    std::vector<SectionInfo> infos;
+    parseSections(src, infos);
+    std::vector<std::vector<uint8_t>> blocks;
+    std::vector<std::pair<size_t, size_t>> ranges;
+    for (size_t i = 0; i < infos.size(); i++) {
+        // Split sections into blocks for compression, if enabled
+        size_t count = core->config.compressStates ? (infos[i].size + blockSize - 1) / blockSize : 0;
+        ranges.push_back(std::make_pair(blocks.size(), count));
+        blocks.resize(blocks.size() + count);
+    }
+
+    // Calculate checksums and compress blocks in parallel, falling back to raw blocks if they don't shrink
+    runParallel(infos.size() + blocks.size(), [&](size_t i) {
+        if (i < infos.size()) {
+            infos[i].checksum = checksum(infos[i].data, infos[i].size);
+            return;
+        }
+        size_t index = i - infos.size(), section = 0;
+        while (index >= ranges[section].first + ranges[section].second) section++;
+        size_t offset = (index - ranges[section].first) * blockSize;
+        uint32_t size = std::min<size_t>(blockSize, infos[section].size - offset);
+        std::vector<uint8_t> &block = blocks[index];
+        block.resize(4 + Lz4::maxSize(size));
+        uint32_t header = Lz4::compress(&infos[section].data[offset], size, &block[4], size - 1);
+        if (!header) {
+            header = size | BIT(31);
+            memcpy(&block[4], &infos[section].data[offset], size);
+        }
+        memcpy(&block[0], &header, sizeof(header));
+        block.resize(4 + (header & ~BIT(31)));
+    });
+
+    // Write the state header and each section with its new header
+    dst.clear();
+    dst.write(src.getData(), sizeof(uint8_t), headerSize);
+    for (size_t i = 0; i < infos.size(); i++) {
+        SectionInfo &info = infos[i];
+        info.flags = SECTION_CHECKSUM | (ranges[i].second ? SECTION_COMPRESSED : 0);
+        info.storedSize = 0;
+        for (size_t j = 0; j < ranges[i].second; j++)
+            info.storedSize += blocks[ranges[i].first + j].size();
+        if (!ranges[i].second) info.storedSize = info.size;
+        dst.write(info.tag, sizeof(uint8_t), 4);
+        dst.write(&info.flags, sizeof(uint32_t), 1);
+        dst.write(&info.size, sizeof(uint32_t), 1);
+        dst.write(&info.storedSize, sizeof(uint32_t), 1);
+        dst.write(&info.checksum, sizeof(uint32_t), 1);
+        for (size_t j = 0; j < ranges[i].second; j++)
+            dst.write(blocks[ranges[i].first + j].data(), sizeof(uint8_t), blocks[ranges[i].first + j].size());
+        if (!ranges[i].second)
+            dst.write(info.data, sizeof(uint8_t), info.size);
+    }
+}
+
+bool SaveStates::snapshot(StateBuffer &buffer) {
+    // Reset the buffer and write the header
+    buffer.clear();
+    buffer.write(stateTag, sizeof(uint8_t), 4);
+    buffer.write(&stateVersion, sizeof(uint32_t), 1);
+
+    // Save the state of every component to its own section, uncompressed and without a checksum
+    for (size_t i = 0; i < sections.size(); i++) {
+        uint32_t header[4] = {};
+        size_t offset = buffer.getSize();
+        buffer.write(sections[i].tag, sizeof(uint8_t), 4);
+        buffer.write(header, sizeof(uint32_t), 4);
+        sections[i].save(&buffer);
+        if (buffer.hasFailed()) return false;
+
+        // Fill in the section sizes now that they're known
+        uint32_t size = buffer.getSize() - offset - sectionHeaderSize;
+        memcpy(&buffer.getData()[offset + 8], &size, sizeof(uint32_t));
+        memcpy(&buffer.getData()[offset + 12], &size, sizeof(uint32_t));
+    }
+    return true;
+}
+
+StateResult SaveStates::restore(StateBuffer &buffer) {
+    // Get header values from the buffer for comparison
+    uint8_t tag[4];
+    uint32_t version;
+    buffer.rewind();
+    buffer.read(tag, sizeof(uint8_t), 4);
+    buffer.read(&version, sizeof(uint32_t), 1);
+
+    // Check if the format tag and state version match
+    if (buffer.hasFailed() || memcmp(tag, stateTag, 4))
+        return STATE_FORMAT_FAIL;
+    if (version != stateVersion)
+        return STATE_VERSION_FAIL;
+
+    // Match each component to a section by tag, skipping any that are unknown
+    std::vector<SectionInfo> infos;
+    if (!parseSections(buffer, infos))
+        return STATE_FORMAT_FAIL;
+    std::vector<SectionInfo*> matches(sections.size(), nullptr);
+    for (size_t i = 0; i < sections.size(); i++) {
+        for (size_t j = 0; j < infos.size() && !matches[i]; j++)
+            if (!memcmp(infos[j].tag, sections[i].tag, 4))
+                matches[i] = &infos[j];
+    }
+
+    // Decompress and verify matched sections before loading, so a corrupt state changes nothing
+    if (!unpackSections(matches))
+        return STATE_FORMAT_FAIL;
+    for (size_t i = 0; i < matches.size(); i++) {
+        SectionInfo *info = matches[i];
+        if (info && (info->flags & SECTION_CHECKSUM) && checksum(info->data, info->size) != info->checksum)
+            return STATE_FORMAT_FAIL;
+    }
+
+    // Load the state of every component that has a section
+    for (size_t i = 0; i < sections.size(); i++) {
+        if (!matches[i]) {
+            LOG_WARN("State is missing section '%.4s', leaving it unchanged\n", sections[i].tag);
+            continue;
+        }
+        StateBuffer data(matches[i]->data, matches[i]->size, matches[i]->size);
+        sections[i].load(&data);
+    }
+    return STATE_SUCCESS;
+}
+
+bool SaveStates::writeState(StateBuffer &state, bool gba) {
+    // Pack a snapshot with checksums and compression
+    packSections(state, packBuffer);
+
+    // Write the packed state to the file in one go
+    FILE *file = openFile("wb", gba);
     if (!file) return false;
-    fwrite(stateTag, sizeof(uint8_t), 4, file);
-    fwrite(&stateVersion, sizeof(uint32_t), 1, file);
-
-    // Save the state of every component
-    core->saveState(file);
-    core->aes.saveState(file);
-    core->cartridgeGba.saveState(file);
-    core->cartridgeNds.saveState(file);
-    core->cp15.saveState(file);
-    core->divSqrt.saveState(file);
-    core->dma[0].saveState(file);
-    core->dma[1].saveState(file);
-    core->gpu.saveState(file);
-    core->gpu2D[0].saveState(file);
-    core->gpu2D[1].saveState(file);
-    core->gpu3D.saveState(file);
-    core->gpu3DRenderer.saveState(file);
-    core->hleArm7.saveState(file);
-    core->hleBios[0].saveState(file);
-    core->hleBios[1].saveState(file);
-    core->hleBios[2].saveState(file);
-    core->i2c.saveState(file);
-    core->interpreter[0].saveState(file);
-    core->interpreter[1].saveState(file);
-    core->ipc.saveState(file);
-    core->memory.saveState(file);
-    core->ndma[0].saveState(file);
-    core->ndma[1].saveState(file);
-    core->rtc.saveState(file);
-    core->sdMmc.saveState(file);
-    core->spi.saveState(file);
-    core->spu.saveState(file);
-    core->timers[0].saveState(file);
-    core->timers[1].saveState(file);
-    core->wifi.saveState(file);
+    bool success = (fwrite(packBuffer.getData(), sizeof(uint8_t), packBuffer.getSize(), file) == packBuffer.getSize());
     fclose(file);
+    return success;
+}
+
+bool SaveStates::saveState() {
+    // Snapshot the state and write it right away
+    waitSave();
+    if (!snapshot(fileBuffer)) return false;
+    return writeState(fileBuffer, core->gbaMode);
+}
+
+bool SaveStates::saveStateAsync(std::function<void(bool)> callback) {
+    // Wait for a previous save to finish, since its buffers are reused
+    // This must be called between runs of the core, like other state functions
+    waitSave();
+
+    // Snapshot the state, which is the only part that stalls emulation
+    bool gba = core->gbaMode;
+    if (!snapshot(fileBuffer)) {
+        if (callback) callback(false);
+        return false;
+    }
+
+    // Compress and write the snapshot on another thread, reporting the result when done
+    saving.store(true);
+    writer = new std::thread([this, gba, callback]() {
+        bool success = writeState(fileBuffer, gba);
+        saving.store(false);
+        if (callback) callback(success);
+    });
     return true;
 }
 
+void SaveStates::requestSave(std::function<void(bool)> callback) {
+    // Request an asynchronous save at the next break in emulation, from any thread
+    // This replaces any request that hasn't started yet
+    mutex.lock();
+    pendingCallback = callback;
+    savePending.store(true);
+    mutex.unlock();
+}
+
+void SaveStates::update() {
+    // Start a requested save now that the core is between runs
+    mutex.lock();
+    std::function<void(bool)> callback = pendingCallback;
+    pendingCallback = nullptr;
+    savePending.store(false);
+    mutex.unlock();
+    saveStateAsync(callback);
+}
+
+void SaveStates::waitSave() {
+    // Block until a background save is finished
+    if (!writer) return;
+    writer->join();
+    delete writer;
+    writer = nullptr;
+}
+
 bool SaveStates::loadState() {
-    // Open the state file and read past the header
-    FILE *file = openFile("rb");
+    // Make sure a background save isn't still writing the file
+    waitSave();
+
+    // Open the state file and get its size
+    FILE *file = openFile("rb", core->gbaMode);
     if (!file) return false;
-    fseek(file, 8, SEEK_SET);
-
-    // Load the state of every component
-    core->loadState(file);
-    core->aes.loadState(file);
-    core->cartridgeGba.loadState(file);
-    core->cartridgeNds.loadState(file);
-    core->cp15.loadState(file);
-    core->divSqrt.loadState(file);
-    core->dma[0].loadState(file);
-    core->dma[1].loadState(file);
-    core->gpu.loadState(file);
-    core->gpu2D[0].loadState(file);
-    core->gpu2D[1].loadState(file);
-    core->gpu3D.loadState(file);
-    core->gpu3DRenderer.loadState(file);
-    core->hleArm7.loadState(file);
-    core->hleBios[0].loadState(file);
-    core->hleBios[1].loadState(file);
-    core->hleBios[2].loadState(file);
-    core->i2c.loadState(file);
-    core->interpreter[0].loadState(file);
-    core->interpreter[1].loadState(file);
-    core->ipc.loadState(file);
-    core->memory.loadState(file);
-    core->ndma[0].loadState(file);
-    core->ndma[1].loadState(file);
-    core->rtc.loadState(file);
-    core->sdMmc.loadState(file);
-    core->spi.loadState(file);
-    core->spu.loadState(file);
-    core->timers[0].loadState(file);
-    core->timers[1].loadState(file);
-    core->wifi.loadState(file);
+    fseek(file, 0, SEEK_END);
+    size_t size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    // Read the whole file into memory and restore from there
+    if (!fileBuffer.resize(size)) {
+        fclose(file);
+        return false;
+    }
+    fileBuffer.resize(fread(fileBuffer.getData(), sizeof(uint8_t), size, file));
     fclose(file);
+    if (restore(fileBuffer) != STATE_SUCCESS)
+        return false;
+
+    // Drop rewind history, since it leads back to whatever was running before the state
+    core->rewind.clear();
     return true;
 }
@@ -19,9 +19,18 @@
 
 #pragma once
 
+#include <atomic>
 #include <cstdint>
+#include <cstdio>
+#include <cstring>
 #include <deque>
+#include <functional>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <vector>
+
+#include "defines.h"
 
 class Core;
 
@@ -32,9 +41,53 @@ enum StateResult {
     STATE_VERSION_FAIL
 };
 
+// Serializes state data to memory, either in an owned arena or a caller-supplied span
+// The arena keeps its capacity when cleared, so repeated snapshots don't need to allocate
+class StateBuffer {
+public:
+    StateBuffer() {}
+    StateBuffer(void *data, size_t capacity, size_t size = 0):
+        data((uint8_t*)data), capacity(capacity), size(size), external(true) {}
+
+    void clear() { size = position = 0; failed = false; }
+    void rewind() { position = 0; failed = false; }
+    bool reserve(size_t bytes);
+    bool resize(size_t bytes);
+
+    uint8_t *getData() { return data; }
+    size_t getSize() { return size; }
+    bool hasFailed() { return failed; }
+
+    void write(const void *src, size_t elemSize, size_t count);
+    void read(void *dst, size_t elemSize, size_t count);
+
+private:
+    std::vector<uint8_t> arena;
+    uint8_t *data = nullptr;
+    size_t capacity = 0;
+    size_t size = 0;
+    size_t position = 0;
+    bool external = false;
+    bool failed = false;
+};
+
+// A component's tagged section in a state, with functions to serialize it
+struct StateSection {
+    const char *tag;
+    std::function<void(StateBuffer*)> save;
+    std::function<void(StateBuffer*)> load;
+
+    StateSection(const char *tag, std::function<void(StateBuffer*)> save, std::function<void(StateBuffer*)> load):
+        tag(tag), save(save), load(load) {}
+};
+
+// States are made of sections, each with a header containing its tag, flags, sizes, and checksum
+// Sections are matched to components by tag, so unknown ones are skipped and missing ones are left alone
+// Reading past the end of a section gives zeros, so values added later default to zero in older states
 class SaveStates {
 public:
-    SaveStates(Core *core): core(core) {}
+    SaveStates(Core *core);
+    ~SaveStates();
     void setPath(std::string path, bool gba);
     void setFd(int fd, bool gba);
 
@@ -42,35 +95,96 @@ public:
     bool saveState();
     bool loadState();
 
-    template <typename T> static void writeFifo(std::deque<T> &fifo, FILE *file);
-    template <typename T> static void readFifo(std::deque<T> &fifo, FILE *file);
+    // Async save callbacks run on the writer thread once the file is written, or on the calling thread if the
+    // snapshot fails, so they should pass the result to the frontend's own thread instead of touching UI or the core
+    bool saveStateAsync(std::function<void(bool)> callback = nullptr);
+    void requestSave(std::function<void(bool)> callback = nullptr);
+    bool isSaving() { return saving.load(); }
+    void waitSave();
+
+    bool isPending() { return savePending.load(std::memory_order_relaxed); }
+    void update();
+
+    bool snapshot(StateBuffer &buffer);
+    StateResult restore(StateBuffer &buffer);
+
+    template <typename T> static void writeFifo(std::deque<T> &fifo, StateBuffer *buffer);
+    template <typename T> static void readFifo(std::deque<T> &fifo, StateBuffer *buffer);
+    static uint32_t checksum(const uint8_t *data, size_t size);
 
 private:
     Core *core;
     std::string ndsPath, gbaPath;
     int ndsFd = -1, gbaFd = -1;
+    StateBuffer fileBuffer, packBuffer, sectionBuffer;
+    std::vector<StateSection> sections;
+
+    std::thread *writer = nullptr;
+    std::atomic<bool> saving;
+    std::atomic<bool> savePending;
+    std::function<void(bool)> pendingCallback;
+    std::mutex mutex;
+
+    struct SectionInfo {
+        const uint8_t *tag;
+        uint32_t flags, size, storedSize, checksum;
+        uint8_t *stored, *data;
+    };
 
     static const char *stateTag;
     static const uint32_t stateVersion;
+    static const uint32_t headerSize = 8;
+    static const uint32_t sectionHeaderSize = 20;
+    static const uint32_t blockSize = 0x40000;
+
+    FILE *openFile(const char *mode, bool gba);
+    bool writeState(StateBuffer &state, bool gba);
+    bool parseSections(StateBuffer &buffer, std::vector<SectionInfo> &infos);
+    bool unpackSections(std::vector<SectionInfo*> &infos);
+    void packSections(StateBuffer &src, StateBuffer &dst);
 
-    FILE *openFile(const char *mode);
+    static void runParallel(size_t count, const std::function<void(size_t)> &job);
 };
 
-template <typename T> void SaveStates::writeFifo(std::deque<T> &fifo, FILE *file) {
+FORCE_INLINE void StateBuffer::write(const void *src, size_t elemSize, size_t count) {
+    // Append data to the buffer, growing it if needed
+    size_t bytes = elemSize * count;
+    if (size + bytes > capacity && !reserve(size + bytes)) {
+        failed = true;
+        return;
+    }
+    memcpy(&data[size], src, bytes);
+    size += bytes;
+}
+
+FORCE_INLINE void StateBuffer::read(void *dst, size_t elemSize, size_t count) {
+    // Copy data out of the buffer, or zero-fill and fail if it runs out
+    size_t bytes = elemSize * count;
+    if (position + bytes > size) {
+        memset(dst, 0, bytes);
+        position = size;
+        failed = true;
+        return;
+    }
+    memcpy(dst, &data[position], bytes);
+    position += bytes;
+}
+
+template <typename T> void SaveStates::writeFifo(std::deque<T> &fifo, StateBuffer *buffer) {
     // Parse a FIFO and save its values
     uint32_t count = fifo.size();
-    fwrite(&count, sizeof(count), 1, file);
+    buffer->write(&count, sizeof(count), 1);
     for (uint32_t i = 0; i < count; i++)
-        fwrite(&fifo[i], sizeof(fifo[i]), 1, file);
+        buffer->write(&fifo[i], sizeof(fifo[i]), 1);
 }
 
-template <typename T> void SaveStates::readFifo(std::deque<T> &fifo, FILE *file) {
+template <typename T> void SaveStates::readFifo(std::deque<T> &fifo, StateBuffer *buffer) {
     // Reset and reload a FIFO with saved values
     fifo.clear();
     uint32_t count; T value;
-    fread(&count, sizeof(count), 1, file);
-    for (uint32_t i = 0; i < count; i++) {
-        fread(&value, sizeof(value), 1, file);
+    buffer->read(&count, sizeof(count), 1);
+    for (uint32_t i = 0; i < count && !buffer->hasFailed(); i++) {
+        buffer->read(&value, sizeof(value), 1);
         fifo.push_back(value);
     }
 }
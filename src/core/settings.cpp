@@ -30,12 +30,18 @@ int Settings::highRes3D = 0;
 int Settings::screenGhost = 0;
 int Settings::emulateAudio = 1;
 int Settings::audio16Bit = 1;
+int Settings::lazyAudio = 0;
+int Settings::audioResample = 1;
 int Settings::savesFolder = 0;
 int Settings::statesFolder = 1;
 int Settings::cheatsFolder = 1;
 int Settings::screenFilter = 2;
 int Settings::dsiMode = 0;
 int Settings::arm7Hle = 0;
+int Settings::rewindInterval = 0;
+int Settings::rewindBudget = 64;
+int Settings::compressStates = 1;
+int Settings::turboSpeed = 0;
 
 std::string Settings::gbaBiosPath = "gba_bios.bin";
 std::string Settings::ndsBios9Path = "bios9.bin";
@@ -48,6 +54,41 @@ std::string Settings::dsiNandPath = "nand.bin";
 std::string Settings::sdImagePath = "sd.img";
 std::string Settings::basePath = ".";
 
+CoreConfig::CoreConfig():
+        gbaBiosPath(Settings::gbaBiosPath), ndsBios9Path(Settings::ndsBios9Path), ndsBios7Path(Settings::
+        ndsBios7Path), ndsFirmPath(Settings::ndsFirmPath), dsiBios9Path(Settings::dsiBios9Path), dsiBios7Path(
+        Settings::dsiBios7Path), dsiFirmPath(Settings::dsiFirmPath), dsiNandPath(Settings::dsiNandPath), sdImagePath(
+        Settings::sdImagePath), basePath(Settings::basePath) {
+    // Start with the current global options
+    update();
+}
+
+void CoreConfig::update() {
+    // Copy the global options, leaving paths as they are
+    directBoot = Settings::directBoot;
+    romInRam = Settings::romInRam;
+    fpsLimiter = Settings::fpsLimiter;
+    frameskip = Settings::frameskip;
+    threaded2D = Settings::threaded2D;
+    threaded3D = Settings::threaded3D;
+    highRes3D = Settings::highRes3D;
+    screenGhost = Settings::screenGhost;
+    emulateAudio = Settings::emulateAudio;
+    audio16Bit = Settings::audio16Bit;
+    lazyAudio = Settings::lazyAudio;
+    audioResample = Settings::audioResample;
+    savesFolder = Settings::savesFolder;
+    statesFolder = Settings::statesFolder;
+    cheatsFolder = Settings::cheatsFolder;
+    screenFilter = Settings::screenFilter;
+    dsiMode = Settings::dsiMode;
+    arm7Hle = Settings::arm7Hle;
+    rewindInterval = Settings::rewindInterval;
+    rewindBudget = Settings::rewindBudget;
+    compressStates = Settings::compressStates;
+    turboSpeed = Settings::turboSpeed;
+}
+
 std::vector<Setting> Settings::settings = {
     Setting("directBoot", &directBoot, false),
     Setting("romInRam", &romInRam, false),
@@ -59,12 +100,18 @@ std::vector<Setting> Settings::settings = {
     Setting("screenGhost", &screenGhost, false),
     Setting("emulateAudio", &emulateAudio, false),
     Setting("audio16Bit", &audio16Bit, false),
+    Setting("lazyAudio", &lazyAudio, false),
+    Setting("audioResample", &audioResample, false),
     Setting("savesFolder", &savesFolder, false),
     Setting("statesFolder", &statesFolder, false),
     Setting("cheatsFolder", &cheatsFolder, false),
     Setting("screenFilter", &screenFilter, false),
     Setting("dsiMode", &dsiMode, false),
     Setting("arm7Hle", &arm7Hle, false),
+    Setting("rewindInterval", &rewindInterval, false),
+    Setting("rewindBudget", &rewindBudget, false),
+    Setting("compressStates", &compressStates, false),
+    Setting("turboSpeed", &turboSpeed, false),
     Setting("gbaBiosPath", &gbaBiosPath, true),
     Setting("ndsBios9Path", &ndsBios9Path, true),
     Setting("ndsBios7Path", &ndsBios7Path, true),
@@ -31,6 +31,49 @@ struct Setting {
         name(name), value(value), isString(isString) {}
 };
 
+// Settings a core runs with, copied from the global settings when it's created
+// Cores that follow the globals pick up option changes at the end of each frame; paths are only used on creation
+struct CoreConfig {
+    int directBoot;
+    int romInRam;
+    int fpsLimiter;
+    int frameskip;
+    int threaded2D;
+    int threaded3D;
+    int highRes3D;
+    int screenGhost;
+    int emulateAudio;
+    int audio16Bit;
+    int lazyAudio;
+    int audioResample;
+    int savesFolder;
+    int statesFolder;
+    int cheatsFolder;
+    int screenFilter;
+    int dsiMode;
+    int arm7Hle;
+    int rewindInterval;
+    int rewindBudget;
+    int compressStates;
+    int turboSpeed;
+
+    std::string gbaBiosPath;
+    std::string ndsBios9Path;
+    std::string ndsBios7Path;
+    std::string ndsFirmPath;
+    std::string dsiBios9Path;
+    std::string dsiBios7Path;
+    std::string dsiFirmPath;
+    std::string dsiNandPath;
+    std::string sdImagePath;
+    std::string basePath;
+
+    bool followGlobals = true;
+
+    CoreConfig();
+    void update();
+};
+
 class Settings {
 public:
     static int directBoot;
@@ -43,12 +86,18 @@ public:
     static int screenGhost;
     static int emulateAudio;
     static int audio16Bit;
+    static int lazyAudio;
+    static int audioResample;
     static int savesFolder;
     static int statesFolder;
     static int cheatsFolder;
     static int screenFilter;
     static int dsiMode;
     static int arm7Hle;
+    static int rewindInterval;
+    static int rewindBudget;
+    static int compressStates;
+    static int turboSpeed;
 
     static std::string gbaBiosPath;
     static std::string ndsBios9Path;
@@ -0,0 +1,104 @@
+/*
+    Copyright 2019-2026 Hydr8gon
+
+    This file is part of NooDS.
+
+    NooDS is free software: you can redistribute it and/or modify it
+    under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    NooDS is distributed in the hope that it will be useful, but
+    WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+    General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with NooDS. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <cstdio>
+
+#include "tracer.h"
+#include "core.h"
+
+const char *Tracer::taskNames[] = {
+    "UPDATE_RUN", "RESET_CYCLES", "CART9_WORD_READY", "CART7_WORD_READY", "DMA9_TRANSFER0", "DMA9_TRANSFER1",
+    "DMA9_TRANSFER2", "DMA9_TRANSFER3", "DMA7_TRANSFER0", "DMA7_TRANSFER1", "DMA7_TRANSFER2", "DMA7_TRANSFER3",
+    "NDS_SCANLINE256", "NDS_SCANLINE355", "GBA_SCANLINE240", "GBA_SCANLINE308", "GPU3D_COMMANDS", "ARM9_INTERRUPT",
+    "ARM7_INTERRUPT", "NDS_SPU_SAMPLE", "GBA_SPU_SAMPLE", "TIMER9_OVERFLOW0", "TIMER9_OVERFLOW1", "TIMER9_OVERFLOW2",
+    "TIMER9_OVERFLOW3", "TIMER7_OVERFLOW0", "TIMER7_OVERFLOW1", "TIMER7_OVERFLOW2", "TIMER7_OVERFLOW3",
+    "WIFI_COUNT_MS", "WIFI_TRANS_REPLY", "WIFI_TRANS_ACK", "AES_UPDATE", "NDMA9_UPDATE", "NDMA7_UPDATE",
+    "SDMMC_READ_BLOCK", "SDMMC_WRITE_BLOCK"
+};
+
+void Tracer::setEnabled(bool value, uint32_t capacity) {
+    // Allocate the buffer the first time tracing starts, rounding its capacity up to a power of 2
+    // It's never reallocated after that, since renderer threads may still be recording into it
+    static_assert(sizeof(taskNames) / sizeof(const char*) == MAX_TASKS, "Task names are out of sync");
+    enabled.store(false);
+    if (value && events.empty()) {
+        uint32_t size = 1;
+        while (size < capacity) size <<= 1;
+        events.resize(size);
+        start = std::chrono::steady_clock::now();
+    }
+
+    // Start over with an empty buffer when re-enabled
+    if (value) head.store(0);
+    enabled.store(value);
+}
+
+void Tracer::record(char phase, const char *name, int track, uint32_t arg, const char *detail) {
+    // Claim the next slot in the ring buffer, overwriting the oldest event once full
+    // Cycles are only read on the emulation track, since renderer threads can't safely access them
+    TraceEvent &event = events[head.fetch_add(1) & (events.size() - 1)];
+    event.nanos = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+    event.cycles = (track == TRACK_EMU) ? core->globalCycles : 0;
+    event.name = name;
+    event.detail = detail;
+    event.arg = arg;
+    event.phase = phase;
+    event.track = track;
+}
+
+bool Tracer::exportChrome(std::string path) {
+    // Open the output file
+    if (events.empty()) return false;
+    FILE *file = fopen(path.c_str(), "w");
+    if (!file) return false;
+
+    // Name the tracks so they're recognizable in the viewer
+    fprintf(file, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+    fprintf(file, "{\"ph\":\"M\",\"name\":\"process_name\",\"pid\":%d,\"tid\":0,\"args\":{\"name\":\"Core %d\"}}",
+        core->id, core->id);
+    int maxTrack = 0;
+
+    // Write events from oldest to newest; begin and end events can be unmatched if the buffer wrapped
+    uint64_t last = head.load();
+    uint64_t first = (last > events.size()) ? (last - events.size()) : 0;
+    for (uint64_t i = first; i < last; i++) {
+        TraceEvent &event = events[i & (events.size() - 1)];
+        maxTrack = std::max<int>(maxTrack, event.track);
+        fprintf(file, ",\n{\"ph\":\"%c\",\"pid\":%d,\"tid\":%d,\"ts\":%llu.%03llu", event.phase, core->id, event.track,
+            (unsigned long long)(event.nanos / 1000), (unsigned long long)(event.nanos % 1000));
+        if (event.phase == 'i') fprintf(file, ",\"s\":\"t\"");
+        if (event.name) fprintf(file, ",\"name\":\"%s\"", event.name);
+        fprintf(file, ",\"args\":{");
+        if (event.track == TRACK_EMU) fprintf(file, "\"cycles\":%u%s", event.cycles, event.name ? "," : "");
+        if (event.name) fprintf(file, "\"arg\":%u", event.arg);
+        if (event.detail) fprintf(file, ",\"detail\":\"%s\"", event.detail);
+        fprintf(file, "}}");
+    }
+
+    for (int i = 0; i <= maxTrack; i++) {
+        std::string name = (i == TRACK_EMU) ? "Emulation" : (i == TRACK_GPU2D) ? "2D renderer" :
+            ("3D renderer " + std::to_string(i - TRACK_GPU3D));
+        fprintf(file, ",\n{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+            core->id, i, name.c_str());
+    }
+    fprintf(file, "\n]}\n");
+    fclose(file);
+    return true;
+}
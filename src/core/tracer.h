@@ -0,0 +1,76 @@
+/*
+    Copyright 2019-2026 Hydr8gon
+
+    This file is part of NooDS.
+
+    NooDS is free software: you can redistribute it and/or modify it
+    under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    NooDS is distributed in the hope that it will be useful, but
+    WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+    General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with NooDS. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class Core;
+
+enum TraceTrack {
+    TRACK_EMU = 0,
+    TRACK_GPU2D,
+    TRACK_GPU3D // Plus the renderer thread index
+};
+
+struct TraceEvent {
+    const char *name;
+    const char *detail;
+    uint64_t nanos;
+    uint32_t cycles;
+    uint32_t arg;
+    char phase;
+    uint8_t track;
+};
+
+// Records timelines of scheduler tasks and renderer threads into a ring buffer, for export as a Chrome trace
+// Events can be recorded from any thread, but should only be exported while the core isn't running
+// The buffer is allocated once on the first enable, so its capacity can't be changed afterwards
+// Guest cycle counts are only recorded on the emulation track; renderer tracks only have host time
+class Tracer {
+public:
+    Tracer(Core *core): core(core) {}
+
+    void setEnabled(bool value, uint32_t capacity = 1 << 18);
+    bool isEnabled() { return enabled; }
+    bool exportChrome(std::string path);
+
+    static const char *getTaskName(int task) { return taskNames[task]; }
+
+    void begin(const char *name, int track = TRACK_EMU, uint32_t arg = 0, const char *detail = nullptr)
+        { if (enabled) record('B', name, track, arg, detail); }
+    void end(int track = TRACK_EMU) { if (enabled) record('E', nullptr, track, 0, nullptr); }
+    void instant(const char *name, int track = TRACK_EMU, uint32_t arg = 0, const char *detail = nullptr)
+        { if (enabled) record('i', name, track, arg, detail); }
+
+private:
+    Core *core;
+    static const char *taskNames[];
+
+    std::atomic<bool> enabled{false};
+    std::atomic<uint64_t> head{0};
+    std::vector<TraceEvent> events;
+    std::chrono::steady_clock::time_point start;
+
+    void record(char phase, const char *name, int track, uint32_t arg, const char *detail);
+};
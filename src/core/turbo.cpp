@@ -0,0 +1,48 @@
+/*
+    Copyright 2019-2026 Hydr8gon
+
+    This file is part of NooDS.
+
+    NooDS is free software: you can redistribute it and/or modify it
+    under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    NooDS is distributed in the hope that it will be useful, but
+    WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+    General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with NooDS. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+
+#include "core.h"
+
+void Turbo::endFrame(uint64_t hostNanos) {
+    // Enable turbo when it has a target speed and the FPS limiter is off, starting over when it changes
+    bool enabled = core->config.turboSpeed > 0 && !core->config.fpsLimiter && !core->movie.isActive();
+    if (enabled != active) {
+        active = enabled;
+        interval = 1;
+        frameCount = 0;
+        windowNanos = 0;
+    }
+    if (!active) return;
+
+    // Measure the speed over a window of frames, relative to the length of a frame on real hardware
+    windowNanos += hostNanos;
+    if (++frameCount < windowFrames) return;
+    double frameNanos = core->gbaMode ? (280896 * 1e9 / 16777216) : (560190 * 1e9 / 33513982);
+    double speed = frameCount * frameNanos / std::max<uint64_t>(windowNanos, 1);
+    frameCount = 0;
+    windowNanos = 0;
+
+    // Render fewer frames if short of the target, or more if well past it
+    if (speed < core->config.turboSpeed && interval < maxInterval)
+        interval++;
+    else if (speed > core->config.turboSpeed * 1.25 && interval > 1)
+        interval--;
+}
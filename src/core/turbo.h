@@ -0,0 +1,47 @@
+/*
+    Copyright 2019-2026 Hydr8gon
+
+    This file is part of NooDS.
+
+    NooDS is free software: you can redistribute it and/or modify it
+    under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    NooDS is distributed in the hope that it will be useful, but
+    WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+    General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with NooDS. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <cstdint>
+
+class Core;
+
+// Speeds up emulation while the FPS limiter is off by only rendering every Nth frame and skipping audio mixing
+// N is tuned as it runs to reach the target speed multiplier, and emulated state is kept the same as without turbo
+// Turbo stays off while an input movie is active, since it changes the output that movies check
+class Turbo {
+public:
+    Turbo(Core *core): core(core) {}
+
+    void endFrame(uint64_t hostNanos);
+    bool isActive() { return active; }
+    int getInterval() { return active ? interval : 1; }
+
+private:
+    Core *core;
+
+    bool active = false;
+    int interval = 1;
+    int frameCount = 0;
+    uint64_t windowNanos = 0;
+
+    static const int maxInterval = 16;
+    static const int windowFrames = 30;
+};
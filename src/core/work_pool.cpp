@@ -0,0 +1,119 @@
+/*
+    Copyright 2019-2026 Hydr8gon
+
+    This file is part of NooDS.
+
+    NooDS is free software: you can redistribute it and/or modify it
+    under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    NooDS is distributed in the hope that it will be useful, but
+    WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+    General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with NooDS. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+
+#include "work_pool.h"
+
+static thread_local WorkPool *workerPool = nullptr;
+static thread_local int workerIndex = -1;
+
+WorkPool::WorkPool(int count) {
+    // Create a worker for each hardware thread if no count was given
+    if (count <= 0)
+        count = std::max(1U, std::thread::hardware_concurrency());
+    running.store(true);
+    queued.store(0);
+    nextWorker.store(0);
+    for (int i = 0; i < count; i++)
+        workers.push_back(new Worker());
+    for (int i = 0; i < count; i++)
+        workers[i]->thread = new std::thread(&WorkPool::runWorker, this, i);
+}
+
+WorkPool::~WorkPool() {
+    // Wake the workers so they can exit, and clean them up; jobs still queued are dropped
+    sleepMutex.lock();
+    running.store(false);
+    sleepCond.notify_all();
+    sleepMutex.unlock();
+    for (size_t i = 0; i < workers.size(); i++) {
+        workers[i]->thread->join();
+        delete workers[i]->thread;
+        delete workers[i];
+    }
+}
+
+void WorkPool::submit(std::function<void()> job, bool urgent) {
+    // Queue a job on the current worker, or spread jobs from outside the pool between workers
+    int index = (workerPool == this) ? workerIndex : (nextWorker.fetch_add(1) % workers.size());
+    Worker *worker = workers[index];
+    worker->mutex.lock();
+    worker->jobs[!urgent].push_back(job);
+    worker->mutex.unlock();
+
+    // Wake a sleeping worker to pick it up
+    sleepMutex.lock();
+    queued.fetch_add(1);
+    sleepMutex.unlock();
+    sleepCond.notify_one();
+}
+
+bool WorkPool::runUrgent() {
+    // Run an urgent job on the calling thread, if there are any queued
+    std::function<void()> job;
+    if (!takeJob((workerPool == this) ? workerIndex : 0, true, job))
+        return false;
+    job();
+    return true;
+}
+
+bool WorkPool::takeJob(int index, bool urgentOnly, std::function<void()> &job) {
+    // Take the oldest job, checking the given worker's queues first and then stealing from the others
+    for (int type = 0; type < (urgentOnly ? 1 : 2); type++) {
+        for (size_t i = 0; i < workers.size(); i++) {
+            Worker *worker = workers[(index + i) % workers.size()];
+            worker->mutex.lock();
+            std::deque<std::function<void()>> &jobs = worker->jobs[type];
+            if (!jobs.empty()) {
+                // Steal from the back so the owner keeps working through its queue in order
+                if (i == 0) {
+                    job = std::move(jobs.front());
+                    jobs.pop_front();
+                }
+                else {
+                    job = std::move(jobs.back());
+                    jobs.pop_back();
+                }
+                worker->mutex.unlock();
+                queued.fetch_sub(1);
+                return true;
+            }
+            worker->mutex.unlock();
+        }
+    }
+    return false;
+}
+
+void WorkPool::runWorker(int index) {
+    // Run jobs until the pool is destroyed, sleeping while there are none
+    workerPool = this;
+    workerIndex = index;
+    std::function<void()> job;
+    while (running.load()) {
+        if (takeJob(index, false, job)) {
+            job();
+            job = nullptr;
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        sleepCond.wait(lock, [this]() { return queued.load() > 0 || !running.load(); });
+    }
+}
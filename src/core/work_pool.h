@@ -0,0 +1,58 @@
+/*
+    Copyright 2019-2026 Hydr8gon
+
+    This file is part of NooDS.
+
+    NooDS is free software: you can redistribute it and/or modify it
+    under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    NooDS is distributed in the hope that it will be useful, but
+    WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+    General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with NooDS. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads that run queued jobs, sized to the machine by default
+// Each worker has its own queue and steals from the others when it runs dry
+// Urgent jobs run before normal ones, and threads waiting on them can help with runUrgent
+class WorkPool {
+public:
+    WorkPool(int count = 0);
+    ~WorkPool();
+
+    int getCount() { return workers.size(); }
+    void submit(std::function<void()> job, bool urgent = false);
+    bool runUrgent();
+
+private:
+    struct Worker {
+        std::mutex mutex;
+        std::deque<std::function<void()>> jobs[2];
+        std::thread *thread = nullptr;
+    };
+
+    std::vector<Worker*> workers;
+    std::atomic<bool> running;
+    std::atomic<int> queued;
+    std::atomic<unsigned int> nextWorker;
+    std::mutex sleepMutex;
+    std::condition_variable sleepCond;
+
+    bool takeJob(int index, bool urgentOnly, std::function<void()> &job);
+    void runWorker(int index);
+};
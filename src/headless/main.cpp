@@ -0,0 +1,318 @@
+/*
+    Copyright 2019-2026 Hydr8gon
+
+    This file is part of NooDS.
+
+    NooDS is free software: you can redistribute it and/or modify it
+    under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    NooDS is distributed in the hope that it will be useful, but
+    WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+    General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with NooDS. If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include "../bench/bench_common.h"
+
+// Runs a ROM without any display or audio device, for servers and CI
+// Frames can be written as raw RGBA video, audio as a WAV file, and states before and after running
+
+static const char *usage =
+    "Usage: %s [options] <rom>\n"
+    "  --frames N          Stop after N frames (default 600, 0 for no limit)\n"
+    "  --until ADDR=VALUE  Stop once the 32-bit word at ADDR equals VALUE\n"
+    "  --timeout SECONDS   Stop after this much wall time\n"
+    "  --config DIR        Load settings and system files from DIR\n"
+    "  --load-state FILE   Load a state before running\n"
+    "  --save-state FILE   Save a state after running\n"
+    "  --video FILE        Write frames to FILE as raw RGBA\n"
+    "  --audio FILE        Write audio to FILE as 32768Hz stereo WAV\n"
+    "  --trace FILE        Write a timeline of the last frames to FILE as a Chrome trace\n"
+    "  --metrics FILE      Write per-frame metrics to FILE as JSON lines\n"
+    "  --record FILE       Record an input movie to FILE, from the loaded state or power-on\n"
+    "  --replay FILE       Replay an input movie from FILE until it ends, checking its hashes\n"
+    "  --hash-ram 0|1      Also hash main RAM each frame when recording (default 0)\n"
+    "  --turbo SPEED       Skip rendering and audio mixing to run at SPEED times real time (default 0, off)\n";
+
+static int16_t samples[0x1000 * 2];
+
+struct Options {
+    std::string romPath, configDir;
+    std::string loadState, saveState;
+    std::string videoPath, audioPath;
+    std::string tracePath, metricsPath;
+    std::string recordPath, replayPath;
+    long frames = 600;
+    int turbo = -1;
+    bool hashRam = false;
+    double timeout = 0;
+    bool until = false;
+    uint32_t untilAddr = 0, untilValue = 0;
+};
+
+static bool parseArgs(int argc, char **argv, Options &opts) {
+    // Parse options that take a value, and treat the last argument as the ROM
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg[0] != '-') {
+            opts.romPath = arg;
+            continue;
+        }
+        if (i + 1 >= argc) return false;
+        const char *value = argv[++i];
+
+        if (arg == "--frames") {
+            opts.frames = strtol(value, nullptr, 0);
+        }
+        else if (arg == "--until") {
+            const char *split = strchr(value, '=');
+            if (!split) return false;
+            opts.until = true;
+            opts.untilAddr = strtoul(value, nullptr, 0);
+            opts.untilValue = strtoul(split + 1, nullptr, 0);
+        }
+        else if (arg == "--timeout") {
+            opts.timeout = atof(value);
+        }
+        else if (arg == "--config") {
+            opts.configDir = value;
+        }
+        else if (arg == "--load-state") {
+            opts.loadState = value;
+        }
+        else if (arg == "--save-state") {
+            opts.saveState = value;
+        }
+        else if (arg == "--video") {
+            opts.videoPath = value;
+        }
+        else if (arg == "--audio") {
+            opts.audioPath = value;
+        }
+        else if (arg == "--trace") {
+            opts.tracePath = value;
+        }
+        else if (arg == "--metrics") {
+            opts.metricsPath = value;
+        }
+        else if (arg == "--record") {
+            opts.recordPath = value;
+        }
+        else if (arg == "--replay") {
+            opts.replayPath = value;
+        }
+        else if (arg == "--hash-ram") {
+            opts.hashRam = strtol(value, nullptr, 0);
+        }
+        else if (arg == "--turbo") {
+            opts.turbo = strtol(value, nullptr, 0);
+        }
+        else {
+            return false;
+        }
+    }
+    return !opts.romPath.empty();
+}
+
+static void writeLe(uint8_t *data, uint32_t value, int size) {
+    // Store a value in little-endian byte order
+    for (int i = 0; i < size; i++)
+        data[i] = value >> (i * 8);
+}
+
+static void writeWavHeader(FILE *file, uint32_t count) {
+    // Write a header for 16-bit stereo samples at the native output rate
+    uint32_t dataSize = count * 4;
+    uint8_t header[44];
+    memcpy(&header[0], "RIFF", 4);
+    writeLe(&header[4], 36 + dataSize, 4);
+    memcpy(&header[8], "WAVEfmt ", 8);
+    writeLe(&header[16], 16, 4); // Format chunk size
+    writeLe(&header[20], 1, 2); // PCM format
+    writeLe(&header[22], 2, 2); // Channels
+    writeLe(&header[24], 32768, 4); // Sample rate
+    writeLe(&header[28], 32768 * 4, 4); // Byte rate
+    writeLe(&header[32], 4, 2); // Block alignment
+    writeLe(&header[34], 16, 2); // Bits per sample
+    memcpy(&header[36], "data", 4);
+    writeLe(&header[40], dataSize, 4);
+    fseek(file, 0, SEEK_SET);
+    fwrite(header, sizeof(uint8_t), sizeof(header), file);
+}
+
+static void writeMetrics(FILE *file, const FrameMetrics &metrics) {
+    // Write a frame's metrics as a single line of JSON, listing only the tasks that ran
+    fprintf(file, "{\"frame\":%llu,\"hostNanos\":%llu,\"opcodes9\":%u,\"opcodes7\":%u,\"tasks\":{",
+        (unsigned long long)metrics.frame, (unsigned long long)metrics.hostNanos, metrics.opcodes[0], metrics.opcodes[1]);
+    bool first = true;
+    for (int i = 0; i < MAX_TASKS; i++) {
+        if (!metrics.tasks[i]) continue;
+        fprintf(file, "%s\"%s\":%u", first ? "" : ",", Tracer::getTaskName(i), metrics.tasks[i]);
+        first = false;
+    }
+    fprintf(file, "},\"dmaWords\":%u,\"gxCommands\":%u,\"polygons\":%u,\"vertices\":%u,\"pixels3D\":%u,"
+        "\"audioUnderruns\":%u,\"droppedFrames\":%u}\n", metrics.dmaWords, metrics.gxCommands, metrics.polygons,
+        metrics.vertices, metrics.pixels3D, metrics.audioUnderruns, metrics.droppedFrames);
+}
+
+int main(int argc, char **argv) {
+    // Parse the command line
+    Options opts;
+    if (!parseArgs(argc, argv, opts)) {
+        printf(usage, argv[0]);
+        return 1;
+    }
+    bool gba = (opts.romPath.size() >= 4 && opts.romPath.compare(opts.romPath.size() - 4, 4, ".gba") == 0);
+
+    // Load settings if a folder was given, and always run uncapped since nothing plays the output
+    if (!opts.configDir.empty())
+        Settings::load(opts.configDir);
+    Settings::fpsLimiter = 0;
+    if (opts.turbo >= 0)
+        Settings::turboSpeed = opts.turbo;
+
+    // Boot the ROM
+    Core *core;
+    try {
+        core = gba ? new Core("", opts.romPath) : new Core(opts.romPath);
+    }
+    catch (CoreError e) {
+        fprintf(stderr, "Error: failed to boot the ROM (error %d)\n", e);
+        return 1;
+    }
+
+    // Load a state to start from if one was given
+    if (!opts.loadState.empty()) {
+        core->saveStates.setPath(opts.loadState, gba);
+        if (!core->saveStates.loadState()) {
+            fprintf(stderr, "Error: failed to load state from %s\n", opts.loadState.c_str());
+            return 1;
+        }
+    }
+
+    // Open the output files, leaving room for the WAV header until the sample count is known
+    FILE *video = opts.videoPath.empty() ? nullptr : fopen(opts.videoPath.c_str(), "wb");
+    FILE *audio = opts.audioPath.empty() ? nullptr : fopen(opts.audioPath.c_str(), "wb");
+    FILE *metrics = opts.metricsPath.empty() ? nullptr : fopen(opts.metricsPath.c_str(), "w");
+    if ((!opts.videoPath.empty() && !video) || (!opts.audioPath.empty() && !audio) ||
+            (!opts.metricsPath.empty() && !metrics)) {
+        fprintf(stderr, "Error: failed to open output files\n");
+        return 1;
+    }
+    if (audio) writeWavHeader(audio, 0);
+    if (!opts.tracePath.empty())
+        core->tracer.setEnabled(true);
+
+    // Start recording or replaying an input movie, with replays running until the movie ends
+    if (!opts.recordPath.empty() && !core->movie.record(opts.recordPath, !opts.loadState.empty(), opts.hashRam)) {
+        fprintf(stderr, "Error: failed to start recording to %s\n", opts.recordPath.c_str());
+        return 1;
+    }
+    if (!opts.replayPath.empty()) {
+        if (!core->movie.play(opts.replayPath)) {
+            fprintf(stderr, "Error: failed to replay %s\n", opts.replayPath.c_str());
+            return 1;
+        }
+        opts.frames = 0;
+    }
+
+    // Run until the frame limit, the timeout, the stop condition, or the end of a replayed movie is reached
+    auto start = std::chrono::steady_clock::now();
+    double minFrame = 1e9, maxFrame = 0;
+    long frames = 0;
+    uint32_t audioCount = 0;
+    bool reached = false;
+    while (opts.frames <= 0 || frames < opts.frames) {
+        // Run the core until a frame ends, draining audio as it's produced
+        // Frames can end without being output when they're skipped
+        auto frameStart = std::chrono::steady_clock::now();
+        bool ready = Bench::runFrame(core, [&]() {
+            if (int count = core->spu.getAvailable()) {
+                core->spu.readSamples(samples, count);
+                if (audio) fwrite(samples, sizeof(int16_t), count * 2, audio);
+                audioCount += count;
+            }
+        });
+        double frameTime = Bench::elapsed(frameStart);
+        minFrame = std::min(minFrame, frameTime);
+        maxFrame = std::max(maxFrame, frameTime);
+        frames++;
+
+        // Write the metrics of the frame that just ended
+        if (metrics) writeMetrics(metrics, core->getMetrics());
+
+        // Write the frame at the size the renderer output it
+        if (video && ready) {
+            int shift = (core->config.highRes3D || core->config.screenFilter == 1);
+            size_t pixels = (core->gbaMode ? (240 * 160) : (256 * 192 * 2)) << (shift * 2);
+            fwrite(Bench::getFramebuffer(), sizeof(uint32_t), pixels, video);
+        }
+
+        // Check the stop conditions
+        if (opts.until && core->memory.read<uint32_t>(core->gbaMode, opts.untilAddr) == opts.untilValue) {
+            reached = true;
+            break;
+        }
+        if (opts.timeout > 0 && Bench::elapsed(start) >= opts.timeout)
+            break;
+        if (!opts.replayPath.empty() && !core->movie.isActive())
+            break;
+    }
+    double total = Bench::elapsed(start);
+    MovieStats movie = core->movie.getStats();
+    core->movie.stop();
+
+    // Finish the output files
+    if (video) fclose(video);
+    if (metrics) fclose(metrics);
+    if (audio) {
+        writeWavHeader(audio, audioCount);
+        fclose(audio);
+    }
+
+    // Write the trace, which only holds the most recent events
+    if (!opts.tracePath.empty()) {
+        core->tracer.setEnabled(false);
+        if (!core->tracer.exportChrome(opts.tracePath))
+            fprintf(stderr, "Error: failed to write trace to %s\n", opts.tracePath.c_str());
+    }
+
+    // Save a state to continue from if requested
+    if (!opts.saveState.empty()) {
+        core->saveStates.setPath(opts.saveState, core->gbaMode);
+        if (!core->saveStates.saveState())
+            fprintf(stderr, "Error: failed to save state to %s\n", opts.saveState.c_str());
+    }
+
+    // Report the timing
+    printf("Ran %ld frames in %.3f s (%.1f FPS)\n", frames, total, frames / std::max(total, 1e-9));
+    printf("Frame time: min %.3f ms, avg %.3f ms, max %.3f ms\n",
+        minFrame * 1000, total * 1000 / std::max(frames, 1L), maxFrame * 1000);
+    if (opts.until)
+        printf("Stop condition %s\n", reached ? "reached" : "not reached");
+    if (core->turbo.isActive())
+        printf("Turbo rendered 1 in %d frames\n", core->turbo.getInterval());
+    if (!opts.recordPath.empty())
+        printf("Recorded %u movie frames\n", movie.frame);
+    if (!opts.replayPath.empty() && movie.mismatches)
+        printf("Movie mismatched on %u of %u frames, first at frame %lld (flags 0x%X)\n", movie.mismatches,
+            movie.length, (long long)movie.firstMismatch, movie.mismatchFlags);
+    else if (!opts.replayPath.empty())
+        printf("Movie matched on all %u frames\n", movie.frame);
+    delete core;
+    if (!opts.replayPath.empty() && (movie.mismatches || movie.frame < movie.length))
+        return 3;
+    return (opts.until && !reached) ? 2 : 0;
+}
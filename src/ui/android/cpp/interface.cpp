@@ -57,18 +57,9 @@ int16_t audioPlayerBuffer[1024 * 2];
 int16_t audioRecorderBuffer[1024];
 
 void audioPlayerCallback(SLAndroidSimpleBufferQueueItf bq, void *context) {
-    // Get 699 samples at 32768Hz, which is equal to approximately 1024 samples at 48000Hz
-    uint32_t *original = core->spu.getSamples(699);
-
-    // Stretch the 699 samples out to 1024 samples in the audio buffer
-    for (int i = 0; i < 1024; i++) {
-        uint32_t sample = original[i * 699 / 1024];
-        audioPlayerBuffer[i * 2 + 0] = sample >> 0;
-        audioPlayerBuffer[i * 2 + 1] = sample >> 16;
-    }
-
+    // Get 1024 samples from the core, resampled from 32768Hz to 48000Hz
+    core->spu.readSamples(audioPlayerBuffer, 1024, 48000);
     (*audioPlayerQueue)->Enqueue(audioPlayerQueue, audioPlayerBuffer, sizeof(audioPlayerBuffer));
-    delete[] original;
 }
 
 void audioRecorderCallback(SLAndroidSimpleBufferQueueItf bq, void *context) {
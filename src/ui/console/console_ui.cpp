@@ -111,13 +111,13 @@ void ConsoleUI::fillAudioBuffer(uint32_t *buffer, int count, int rate) {
         return;
     }
 
-    // Fill the buffer with resampled output from the core
-    int scaled = count * 32768 / rate;
-    uint32_t *original = core->spu.getSamples(scaled);
-    lastSample = original[scaled - 1];
-    for (int i = 0; i < 1024; i++)
-        buffer[i] = original[i * scaled / 1024];
-    delete[] original;
+    // Fill the buffer with output from the core, resampled to the requested rate
+    static int16_t samples[1024 * 2];
+    count = std::min(count, 1024);
+    core->spu.readSamples(samples, count, rate);
+    for (int i = 0; i < count; i++)
+        buffer[i] = (samples[i * 2 + 1] << 16) | (samples[i * 2 + 0] & 0xFFFF);
+    lastSample = buffer[count - 1];
 }
 
 uint32_t ConsoleUI::getInputPress() {
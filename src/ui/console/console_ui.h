@@ -19,6 +19,7 @@
 
 #pragma once
 
+#include <condition_variable>
 #include <cstdint>
 #include <string>
 #include <vector>
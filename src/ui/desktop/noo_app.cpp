@@ -186,32 +186,24 @@ int NooApp::audioCallback(const void *in, void *out, unsigned long count,
     const PaStreamCallbackTimeInfo *info, PaStreamCallbackFlags flags, void *data) {
     int16_t *buffer = (int16_t*)out;
     NooFrame **frames = (NooFrame**)data;
-    uint32_t *original = nullptr;
+    static int16_t discard[1024 * 2];
+    bool playing = false;
 
     // Get samples from each instance so frame limiting is enforced
     // Only the lowest instance ID's samples are played; the rest are discarded
+    // The core resamples its 32768Hz output to 48000Hz, since the native rate causes issues on some systems
     for (size_t i = 0; i < MAX_FRAMES; i++) {
         if (!frames[i]) continue;
         if (Core *core = frames[i]->core) {
-            uint32_t *samples = core->spu.getSamples(699);
-            if (!original)
-                original = samples;
+            if (!playing)
+                core->spu.readSamples(buffer, count, 48000);
             else
-                delete[] samples;
+                core->spu.readSamples(discard, std::min<int>(count, 1024), 48000);
+            playing = true;
         }
     }
 
-    if (original) {
-        // The NDS sample rate is 32768Hz, but it causes issues on some systems, so 48000Hz is used instead
-        // Stretch 699 samples at 32768Hz to approximately 1024 samples at 48000Hz
-        for (int i = 0; i < count; i++) {
-            uint32_t sample = original[i * 699 / 1024];
-            buffer[i * 2 + 0] = sample >>  0;
-            buffer[i * 2 + 1] = sample >> 16;
-        }
-        delete[] original;
-    }
-    else {
+    if (!playing) {
         // Play silence if the emulator isn't running
         memset(buffer, 0, count * sizeof(uint32_t));
     }
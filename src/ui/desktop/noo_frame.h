@@ -19,6 +19,8 @@
 
 #pragma once
 
+#include <condition_variable>
+
 #include <wx/wx.h>
 #include <wx/joystick.h>
 
@@ -160,12 +160,8 @@ void CoreBridge::getSamples(void *buffer, uint32_t count) {
     }
 
     // Fill an audio buffer with core data resampled to 44100Hz
-    uint32_t scale = (count & ~0x1) * 32768 / 44100; // Rounded for consistency
-    uint32_t *samples = core->spu.getSamples(scale);
+    core->spu.readSamples((int16_t*)buffer, count, 44100);
     mutex.unlock();
-    for (int i = 0; i < count; i++)
-        ((uint32_t*)buffer)[i] = samples[i * scale / count];
-    delete[] samples;
 }
 
 bool CoreBridge::getGbaMode() {